@@ -0,0 +1,229 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: act_ops.cpp
+ * Description: Implements the MALU activation functions.
+ *              FP32: exp(x) = 2^n * LUT[i] * poly(r) and 1/y = LUT[i] * poly(d),
+ *              with 64-entry segment tables; sigmoid/tanh/SiLU/GELU are built
+ *              from those two kernels. BF16: every activation is a 64K-entry
+ *              table (one FP32 result per BF16 input) filled from the FP32 kernel
+ *              on first use, then narrowed with fp32_round_to_bf16().
+ **********/
+#include "act_ops.hpp"
+#include "ops.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+static const int LUT_BITS = 6;
+static const int LUT_SIZE = 1 << LUT_BITS;
+
+// ---------------------- LUT ROM ----------------------
+struct act_luts {
+    float exp2_seg[LUT_SIZE];        // 2^(i/64)
+    float rcp_seg[LUT_SIZE];         // 1/m0 at the midpoint m0 of segment i of [1,2)
+    float rsqrt_even_seg[LUT_SIZE];  // 1/sqrt(m0), segment i of [1,2) (even exponent)
+    float rsqrt_odd_seg[LUT_SIZE];   // 1/sqrt(m0), segment i of [2,4) (odd exponent)
+
+    act_luts() {
+        for(int i=0; i<LUT_SIZE; i++) {
+            double mid = 1.0 + (i + 0.5) / LUT_SIZE;
+            exp2_seg[i]       = (float)std::exp2((double)i / LUT_SIZE);
+            rcp_seg[i]        = (float)(1.0 / mid);
+            rsqrt_even_seg[i] = (float)(1.0 / std::sqrt(mid));
+            rsqrt_odd_seg[i]  = (float)(1.0 / std::sqrt(2.0 * mid));
+        }
+    }
+};
+
+static const act_luts& luts()
+{
+    static const act_luts rom;
+    return rom;
+}
+
+static float bits_to_float(uint32_t u)
+{
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static uint32_t float_to_bits(float f)
+{
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+// ---------------------- FP32 KERNELS ----------------------
+
+/**
+ * lut_exp_f32: x = (n + i/64) * ln2 + r, 0 <= r < ln2/64.
+ * 2^(i/64) comes from the table, e^r from a cubic.
+ */
+float lut_exp_f32(float x)
+{
+    if(std::isnan(x))   return x;
+    if(x >  88.72f)     return INFINITY;
+    if(x < -87.33f)     return 0.0f;
+
+    const double LN2 = 0.69314718055994531;
+    double t = (double)x / LN2;
+    double n = std::floor(t);
+    int    i = (int)((t - n) * LUT_SIZE);
+    if(i >= LUT_SIZE) i = LUT_SIZE - 1;
+
+    float r = (float)((t - n - (double)i / LUT_SIZE) * LN2);
+    float p = 1.0f + r * (1.0f + r * (0.5f + r * (1.0f / 6.0f)));
+    return std::ldexp(luts().exp2_seg[i] * p, (int)n);
+}
+
+/**
+ * lut_rcp_f32: y = m * 2^e with m in [1,2). With m0 the segment midpoint and
+ * d = (m - m0)/m0, 1/m = (1/m0) * (1 - d + d^2 - d^3), |d| <= 1/128.
+ */
+float lut_rcp_f32(float y)
+{
+    if(std::isnan(y)) return y;
+    if(y == 0.0f)     return std::copysign(INFINITY, y);
+    if(std::isinf(y)) return std::copysign(0.0f, y);
+
+    int   e;
+    float m = std::frexp(std::fabs(y), &e) * 2.0f;   // [1,2)
+    e -= 1;
+    int i = (int)((m - 1.0f) * LUT_SIZE);
+    if(i >= LUT_SIZE) i = LUT_SIZE - 1;
+
+    float inv_m0 = luts().rcp_seg[i];
+    float m0     = 1.0f + (i + 0.5f) / LUT_SIZE;
+    float d      = (m - m0) * inv_m0;
+    float p      = inv_m0 * (1.0f - d * (1.0f - d * (1.0f - d)));
+    return std::copysign(std::ldexp(p, -e), y);
+}
+
+/**
+ * lut_rsqrt_f32: y = m * 2^(2k) with m in [1,4); the even/odd exponent
+ * tables cover [1,2) and [2,4). With d = (m - m0)/m0,
+ * 1/sqrt(m) = (1/sqrt(m0)) * (1 - d/2 + 3d^2/8 - 5d^3/16).
+ */
+float lut_rsqrt_f32(float y)
+{
+    if(std::isnan(y) || y < 0.0f) return NAN;
+    if(y == 0.0f)     return INFINITY;
+    if(std::isinf(y)) return 0.0f;
+
+    int   e;
+    float m = std::frexp(y, &e) * 2.0f;   // [1,2)
+    e -= 1;
+    bool odd = (e & 1) != 0;
+    int i = (int)((m - 1.0f) * LUT_SIZE);
+    if(i >= LUT_SIZE) i = LUT_SIZE - 1;
+
+    float m0 = 1.0f + (i + 0.5f) / LUT_SIZE;
+    float inv_sqrt_m0 = odd ? luts().rsqrt_odd_seg[i] : luts().rsqrt_even_seg[i];
+    float d  = (m - m0) / m0;
+    float p  = inv_sqrt_m0 * (1.0f - d * (0.5f - d * (0.375f - d * 0.3125f)));
+    // 2^-(e/2), with the odd bit already folded into the table
+    return std::ldexp(p, -((e - (odd ? 1 : 0)) / 2));
+}
+
+// sigmoid(|x|) = 1/(1+e^-|x|), sigmoid(-|x|) = e^-|x| * sigmoid(|x|)
+static float act_sigmoid(float x)
+{
+    if(std::isnan(x)) return x;
+    float e = lut_exp_f32(-std::fabs(x));
+    float s = lut_rcp_f32(1.0f + e);
+    return (x >= 0.0f) ? s : e * s;
+}
+
+static float act_tanh(float x)
+{
+    if(std::isnan(x)) return x;
+    float ax = std::fabs(x);
+    if(ax < 0.25f) {
+        // odd series, avoids the 1 - 2/(e+1) cancellation near zero
+        float x2 = x * x;
+        float p  = 62.0f / 2835.0f;
+        p = p * x2 - 17.0f / 315.0f;
+        p = p * x2 + 2.0f / 15.0f;
+        p = p * x2 - 1.0f / 3.0f;
+        return x + x * x2 * p;
+    }
+    if(ax > 9.0f)
+        return std::copysign(1.0f, x);
+    return std::copysign(1.0f - 2.0f * lut_rcp_f32(lut_exp_f32(2.0f * ax) + 1.0f), x);
+}
+
+// GELU (tanh form): 0.5*x*(1 + tanh(u)) == x * sigmoid(2u).
+// At -inf that product is -inf * 0; the limit is -0, as for SiLU.
+static float act_gelu(float x)
+{
+    if(std::isinf(x) && x < 0.0f) return -0.0f;
+    float u = 0.7978845608f * (x + 0.044715f * x * x * x);
+    return x * act_sigmoid(2.0f * u);
+}
+
+static float act_silu(float x)
+{
+    if(std::isinf(x) && x < 0.0f) return -0.0f;
+    return x * act_sigmoid(x);
+}
+
+static uint32_t fp32_act_bits(uint32_t bits, ActFunc f)
+{
+    float x = bits_to_float(bits);
+    switch(f) {
+        case ACT_RELU:
+            // keep NaN, zero every negative value (including -0)
+            if((bits >> 31) && !std::isnan(x)) return 0;
+            return bits;
+        case ACT_GELU:    return float_to_bits(act_gelu(x));
+        case ACT_SILU:    return float_to_bits(act_silu(x));
+        case ACT_SIGMOID: return float_to_bits(act_sigmoid(x));
+        case ACT_TANH:    return float_to_bits(act_tanh(x));
+        default:          return bits;
+    }
+}
+
+sc_uint<32> fp32_act_1c(sc_uint<32> x, ActFunc f)
+{
+    return fp32_act_bits(x.to_uint(), f);
+}
+
+// ---------------------- BF16 TABLE PATH ----------------------
+
+/**
+ * One table per activation, indexed by the 16 BF16 bits. Entries hold the
+ * unrounded FP32 result so the current rounding mode applies at lookup.
+ * All tables are built together on first use; the function-local static is
+ * initialized once even when fuzzer/bench threads race to it.
+ */
+struct bf16_act_tables {
+    std::vector<uint32_t> t[ACT_TANH + 1];
+
+    bf16_act_tables() {
+        for(int f=ACT_GELU; f<=ACT_TANH; f++) {
+            t[f].resize(1 << 16);
+            for(uint32_t h=0; h<(1u << 16); h++)
+                t[f][h] = fp32_act_bits(h << 16, (ActFunc)f);
+        }
+    }
+};
+
+static const uint32_t* bf16_table(ActFunc f)
+{
+    static const bf16_act_tables tables;
+    return tables.t[f].data();
+}
+
+sc_uint<32> bf16_act_1c(sc_uint<32> x, ActFunc f)
+{
+    uint32_t bits = x.to_uint() & 0xFFFF0000u;
+    if(f == ACT_NONE || f > ACT_TANH)
+        return bits;
+    if(f == ACT_RELU)
+        return fp32_act_bits(bits, f);
+    return fp32_round_to_bf16(bf16_table(f)[bits >> 16]);
+}
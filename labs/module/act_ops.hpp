@@ -0,0 +1,44 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: act_ops.hpp
+ * Description: Declares the single-cycle activation functions (ReLU, GELU, SiLU,
+ *              sigmoid, tanh) used by the MALU activation op and by the fused
+ *              activation stage after ADD/FMA.
+ *              FP32 uses LUT-plus-polynomial kernels, BF16 uses a full 64K-entry
+ *              table indexed by the BF16 bit pattern.
+ **********/
+#pragma once
+#include <systemc.h>
+
+/**
+ * Activation select, taken from immediate_value[2:0].
+ */
+enum ActFunc {
+    ACT_NONE    = 0,
+    ACT_RELU    = 1,
+    ACT_GELU    = 2,   // tanh approximation
+    ACT_SILU    = 3,
+    ACT_SIGMOID = 4,
+    ACT_TANH    = 5
+};
+
+/**
+ * FP32 activation: exp and reciprocal come from 64-entry LUTs refined by a
+ * short polynomial, everything else is composed from those two.
+ */
+sc_uint<32> fp32_act_1c(sc_uint<32> x, ActFunc f);
+
+/**
+ * BF16 activation (value in the upper 16 bits of the lane):
+ * one table lookup, then rounding to BF16 per the global context.
+ */
+sc_uint<32> bf16_act_1c(sc_uint<32> x, ActFunc f);
+
+/**
+ * The FP32 exp, reciprocal and reciprocal square root kernels on host floats,
+ * shared with the row macro-ops (softmax, normalization).
+ */
+float lut_exp_f32(float x);
+float lut_rcp_f32(float y);
+float lut_rsqrt_f32(float y);
@@ -0,0 +1,372 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: bench_main.cpp
+ * Description: Microbenchmarks for the MALU kernels and the whole MALU.
+ *              kernel rows: ns per element of each single-cycle kernel
+ *                (fp32/bf16 add, sub, mul and the typecasts), called
+ *                  kernel     on its own, one element at a time
+ *                  malu_line  through malu_datapath::execute_line, 64 lanes
+ *                             per call, as the MALU runs it
+ *              malu rows: full instructions (SFR + command + two MRF lines
+ *                in, one line out) through the SystemC FIFOs of one malu,
+ *                in instructions per host second and MALU cycles each.
+ *              One row per measurement, as CSV (default) or JSON, so runs
+ *              can be diffed or plotted over time.
+ *
+ *              Usage: bench_main [key=value ...]
+ *                elems=N        elements per kernel run (1048576)
+ *                reps=N         runs per kernel, the fastest is reported (5)
+ *                lines=N        instructions per malu row (16384)
+ *                format=csv|json
+ *                out=FILE       write the rows to FILE instead of stdout
+ *                               (the MALU's own log lines stay on stdout)
+ **********/
+
+ #include <systemc.h>
+ #include <algorithm>
+ #include <chrono>
+ #include <cstdint>
+ #include <cstdlib>
+ #include <cstring>
+ #include <fstream>
+ #include <iomanip>
+ #include <iostream>
+ #include <string>
+ #include <vector>
+ #include "malu.hpp"
+ #include "common_register.hpp"
+
+ struct bench_row {
+     std::string group;      // kernel or malu
+     std::string name;
+     std::string impl;
+     uint64_t    count;      // elements or instructions per run
+     double      ns_per_item;
+     double      cycles_per_item;   // MALU cycles, malu rows only
+ };
+
+ //---------------------------------------------------------------------
+ // Kernels under test
+ //---------------------------------------------------------------------
+ static sc_uint<32> k_fp32_to_bf16(sc_uint<32> a, sc_uint<32>) { return typecast_single_cycle(a, FP32, BF16); }
+ static sc_uint<32> k_fp32_to_int8(sc_uint<32> a, sc_uint<32>) { return typecast_single_cycle(a, FP32, INT8); }
+ static sc_uint<32> k_bf16_to_fp32(sc_uint<32> a, sc_uint<32>) { return typecast_single_cycle(a, BF16, FP32); }
+
+ struct bench_kernel {
+     const char*  name;
+     sc_uint<32>  (*fn)(sc_uint<32>, sc_uint<32>);
+     unsigned     operation;       // MALU op code for malu_line
+     unsigned     input_format;    // 0=FP32, 1=BF16
+     unsigned     output_format;
+ };
+
+ static const bench_kernel kernels[] = {
+     { "fp32_add_1c",  fp32_add_1c,    0,  0, 0 },
+     { "fp32_sub_1c",  fp32_sub_1c,    1,  0, 0 },
+     { "fp32_mul_1c",  fp32_mul_1c,    2,  0, 0 },
+     { "bf16_add_1c",  bf16_add_1c,    0,  1, 1 },
+     { "bf16_sub_1c",  bf16_sub_1c,    1,  1, 1 },
+     { "bf16_mul_1c",  bf16_mul_1c,    2,  1, 1 },
+     { "typecast_fp32_to_bf16", k_fp32_to_bf16, 12, 0, 1 },
+     { "typecast_fp32_to_int8", k_fp32_to_int8, 12, 0, 2 },
+     { "typecast_bf16_to_fp32", k_bf16_to_fp32, 12, 1, 0 },
+ };
+ static const int NUM_KERNELS = sizeof(kernels) / sizeof(kernels[0]);
+
+ //---------------------------------------------------------------------
+ // Inputs: finite values in +-[2^-7, 2^8), BF16 in the upper 16 bits
+ //---------------------------------------------------------------------
+ static inline uint64_t splitmix64(uint64_t& s)
+ {
+     uint64_t z = (s += 0x9E3779B97F4A7C15ull);
+     z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+     z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+     return z ^ (z >> 31);
+ }
+
+ static uint32_t random_value(uint64_t& s, bool bf16)
+ {
+     uint64_t r = splitmix64(s);
+     uint32_t u = (uint32_t)(r & 0x807FFFFFu) | (uint32_t)(120 + (r >> 32) % 15) << 23;
+     return bf16 ? (u & 0xFFFF0000u) : u;
+ }
+
+ static decoded_sfr_t kernel_cfg(const bench_kernel& k)
+ {
+     decoded_sfr_t cfg;
+     cfg.operation     = k.operation;
+     cfg.input_format  = k.input_format;
+     cfg.output_format = k.output_format;
+     return cfg;
+ }
+
+ static double now_s()
+ {
+     return std::chrono::duration<double>(
+         std::chrono::steady_clock::now().time_since_epoch()).count();
+ }
+
+ static volatile uint32_t sink;
+
+ static void bench_kernels(uint64_t elems, int reps, std::vector<bench_row>& rows)
+ {
+     uint64_t lines = (elems + MALU_LANES - 1) / MALU_LANES;
+     elems = lines * MALU_LANES;
+
+     for(int k=0; k<NUM_KERNELS; k++) {
+         const bench_kernel& kn = kernels[k];
+         decoded_sfr_t cfg = kernel_cfg(kn);
+         cfg.apply_ops_context();
+
+         uint64_t s = 1 + k;
+         std::vector<uint32_t> a(elems), b(elems);
+         for(uint64_t i=0; i<elems; i++) {
+             a[i] = random_value(s, kn.input_format==1);
+             b[i] = random_value(s, kn.input_format==1);
+         }
+
+         // kernel: one call per element
+         double best = 1e30;
+         for(int r=0; r<reps; r++) {
+             uint32_t acc = 0;
+             double t0 = now_s();
+             for(uint64_t i=0; i<elems; i++)
+                 acc ^= kn.fn(a[i], b[i]).to_uint();
+             best = std::min(best, now_s() - t0);
+             sink = acc;
+         }
+         rows.push_back({ "kernel", kn.name, "kernel", elems, best * 1e9 / elems, 0 });
+
+         // malu_line: 64 lanes per execute_line, lines packed up front
+         std::vector< sc_bv<2048> > la(lines), lb(lines);
+         uint32_t lanes[MALU_LANES];
+         for(uint64_t l=0; l<lines; l++) {
+             std::memcpy(lanes, &a[l*MALU_LANES], sizeof(lanes));
+             pack_line(lanes, la[l]);
+             std::memcpy(lanes, &b[l*MALU_LANES], sizeof(lanes));
+             pack_line(lanes, lb[l]);
+         }
+         malu_datapath dp;
+         sc_bv<2048>   out;
+         best = 1e30;
+         for(int r=0; r<reps; r++) {
+             double t0 = now_s();
+             for(uint64_t l=0; l<lines; l++)
+                 dp.execute_line(cfg, la[l], lb[l], out);
+             best = std::min(best, now_s() - t0);
+             sink = out.range(31, 0).to_uint();
+         }
+         rows.push_back({ "kernel", kn.name, "malu_line", elems, best * 1e9 / elems, 0 });
+     }
+ }
+
+ //---------------------------------------------------------------------
+ // End to end: one malu fed through its FIFOs, one phase per op
+ //---------------------------------------------------------------------
+ SC_MODULE(bench_tb) {
+     sc_in<bool> clk;
+
+     sc_fifo_out<sfr_PTR>       o_sfr;
+     sc_fifo_out<npuc2malu_PTR> o_cmd;
+     sc_vector< sc_fifo_out<mrf2malu_PTR> > o_mrf;
+     sc_fifo_in<malu2mrf_PTR>   i_res;
+     sc_fifo_in<malu2npuc_PTR>  i_done;
+
+     struct phase_t {
+         const bench_kernel* k;
+         double   host_s;
+         sc_time  sim;
+     };
+
+     int      num_lines;
+     std::vector<phase_t> phases;
+     std::vector< sc_bv<2048> > la, lb;     // operand lines, reused round robin
+     sc_event phase_done;
+
+     SC_HAS_PROCESS(bench_tb);
+     bench_tb(sc_module_name name, int lines)
+       : sc_module(name), o_mrf("o_mrf", 2), num_lines(lines)
+     {
+         for(int k=0; k<NUM_KERNELS; k++)
+             phases.push_back({ &kernels[k], 0, SC_ZERO_TIME });
+         SC_THREAD(producer);
+         SC_THREAD(consumer);
+     }
+
+     // The next SFR only goes out once the last phase has drained: a new
+     // configuration must not overtake staged lines
+     void producer() {
+         for(size_t p=0; p<phases.size(); p++) {
+             const bench_kernel& kn = *phases[p].k;
+             auto sfr_ptr = std::make_shared<_COMMON_REGISTERS>();
+             sfr_ptr->reg_parsed_mode_math.operation     = kn.operation;
+             sfr_ptr->reg_parsed_mode_math.input_format  = kn.input_format;
+             sfr_ptr->reg_parsed_mode_math.output_format = kn.output_format;
+             o_sfr.write(sfr_ptr);
+
+             uint64_t s = 1 + p;
+             uint32_t lanes[2][MALU_LANES];
+             la.assign(64, sc_bv<2048>());
+             lb.assign(64, sc_bv<2048>());
+             for(int l=0; l<64; l++) {
+                 for(int i=0; i<MALU_LANES; i++) {
+                     lanes[0][i] = random_value(s, kn.input_format==1);
+                     lanes[1][i] = random_value(s, kn.input_format==1);
+                 }
+                 pack_line(lanes[0], la[l]);
+                 pack_line(lanes[1], lb[l]);
+             }
+
+             phases[p].host_s = now_s();
+             phases[p].sim    = sc_time_stamp();
+             for(int i=0; i<num_lines; i++) {
+                 auto a = make_payload<mrf2malu_PTR>();
+                 auto b = make_payload<mrf2malu_PTR>();
+                 a->data = la[i % 64];
+                 b->data = lb[i % 64];
+                 a->done = 1;
+                 b->done = 1;
+                 auto cmd = make_payload<npuc2malu_PTR>();
+                 cmd->start = 1;
+                 o_mrf[0].write(a);
+                 o_mrf[1].write(b);
+                 o_cmd.write(cmd);
+             }
+             wait(phase_done);
+         }
+     }
+
+     void consumer() {
+         for(size_t p=0; p<phases.size(); p++) {
+             for(int i=0; i<num_lines; i++) {
+                 auto res = i_res.read();
+                 i_done.read();
+                 sink = res->data.range(31, 0).to_uint();
+             }
+             phases[p].host_s = now_s() - phases[p].host_s;
+             phases[p].sim    = sc_time_stamp() - phases[p].sim;
+             phase_done.notify(SC_ZERO_TIME);
+         }
+         sc_stop();
+     }
+ };
+
+ //---------------------------------------------------------------------
+ // Output
+ //---------------------------------------------------------------------
+ static double per_s(const bench_row& r)
+ {
+     return r.ns_per_item > 0 ? 1e9 / r.ns_per_item : 0.0;
+ }
+
+ static void write_csv(std::ostream& os, const std::vector<bench_row>& rows)
+ {
+     os << "group,name,impl,count,ns_per_item,items_per_s,cycles_per_item\n";
+     for(const bench_row& r : rows)
+         os << r.group << "," << r.name << "," << r.impl << "," << r.count << ","
+            << std::fixed << std::setprecision(3) << r.ns_per_item << ","
+            << std::setprecision(0) << per_s(r) << ","
+            << std::setprecision(3) << r.cycles_per_item << std::defaultfloat << "\n";
+ }
+
+ static void write_json(std::ostream& os, const std::vector<bench_row>& rows)
+ {
+     os << "[\n";
+     for(size_t i=0; i<rows.size(); i++) {
+         const bench_row& r = rows[i];
+         os << "  {\"group\": \"" << r.group << "\", \"name\": \"" << r.name
+            << "\", \"impl\": \"" << r.impl << "\", \"count\": " << r.count
+            << std::fixed << std::setprecision(3)
+            << ", \"ns_per_item\": " << r.ns_per_item
+            << std::setprecision(0) << ", \"items_per_s\": " << per_s(r)
+            << std::setprecision(3) << ", \"cycles_per_item\": " << r.cycles_per_item
+            << std::defaultfloat << "}" << (i + 1 < rows.size() ? "," : "") << "\n";
+     }
+     os << "]\n";
+ }
+
+ static bool arg(int argc, char* argv[], const char* key, std::string& val)
+ {
+     size_t n = std::strlen(key);
+     for(int i=1; i<argc; i++)
+         if(std::strncmp(argv[i], key, n) == 0 && argv[i][n] == '=') {
+             val = argv[i] + n + 1;
+             return true;
+         }
+     return false;
+ }
+
+ int sc_main(int argc, char* argv[])
+ {
+     std::string v, format = "csv", out;
+     uint64_t elems = 1ull << 20;
+     int      reps  = 5;
+     int      lines = 16384;
+     if(arg(argc, argv, "elems", v)) elems = std::strtoull(v.c_str(), nullptr, 0);
+     if(arg(argc, argv, "reps", v))  reps  = std::atoi(v.c_str());
+     if(arg(argc, argv, "lines", v)) lines = std::atoi(v.c_str());
+     arg(argc, argv, "format", format);
+     arg(argc, argv, "out", out);
+     if(elems < 1) elems = 1;
+     if(reps < 1)  reps  = 1;
+     if(lines < 1) lines = 1;
+
+     std::vector<bench_row> rows;
+     bench_kernels(elems, reps, rows);
+
+     sc_clock clk("clk", 10, SC_NS);
+     sc_signal<bool> rst("rst");
+
+     sc_fifo<npuc2malu_PTR>  fifo_npuc2malu("fifo_npuc2malu", 16);
+     sc_fifo<malu2npuc_PTR>  fifo_malu2npuc("fifo_malu2npuc", 16);
+     sc_vector<sc_fifo<mrf2malu_PTR>> fifo_mrf2malu("fifo_mrf2malu", 2);
+     sc_fifo<malu2mrf_PTR>   fifo_malu2mrf("fifo_malu2mrf", 16);
+     sc_fifo<sfr_PTR>        fifo_sfr("fifo_sfr", 8);
+     sc_fifo<malu2tcm_PTR>   fifo_malu2tcm("fifo_malu2tcm", 8);
+     sc_vector<sc_fifo<tcm2malu_PTR>> fifo_tcm2malu("fifo_tcm2malu", LUT_LINES_PER_BEAT);
+
+     malu dut("dut_malu", 0);
+     dut.clk(clk);
+     dut.reset(rst);
+     dut.i_npuc2malu(fifo_npuc2malu);
+     dut.o_malu2npuc(fifo_malu2npuc);
+     for (int i = 0; i < 2; ++i)
+         dut.i_mrf2malu[i](fifo_mrf2malu[i]);
+     dut.o_malu2mrf(fifo_malu2mrf);
+     dut.i_reg_map(fifo_sfr);
+     dut.o_malu2tcm(fifo_malu2tcm);
+     for (int j = 0; j < LUT_LINES_PER_BEAT; ++j)
+         dut.i_tcm2malu[j](fifo_tcm2malu[j]);
+
+     bench_tb tb("tb", lines);
+     tb.clk(clk);
+     tb.o_sfr(fifo_sfr);
+     tb.o_cmd(fifo_npuc2malu);
+     for (int i = 0; i < 2; ++i)
+         tb.o_mrf[i](fifo_mrf2malu[i]);
+     tb.i_res(fifo_malu2mrf);
+     tb.i_done(fifo_malu2npuc);
+
+     rst.write(true);
+     sc_start(40, SC_NS);
+     rst.write(false);
+     sc_start();
+
+     for(const bench_tb::phase_t& p : tb.phases)
+         rows.push_back({ "malu", p.k->name, "malu_fifo", (uint64_t)lines,
+                          p.host_s * 1e9 / lines, p.sim / clk.period() / lines });
+
+     std::ofstream file;
+     if(!out.empty()) {
+         file.open(out);
+         if(!file) {
+             std::cerr << "[BENCH] cannot open " << out << std::endl;
+             return 1;
+         }
+     }
+     std::ostream& os = out.empty() ? std::cout : file;
+     if(format == "json") write_json(os, rows);
+     else                 write_csv(os, rows);
+     return 0;
+ }
@@ -0,0 +1,285 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: dispatcher_main.cpp
+ * Description: SystemC testbench for the multi-MALU dispatcher. Streams a batch
+ *              of FP32 MUL lines (stochastically rounded to BF16) through N MALU
+ *              instances, then compare/SELECT/predicated lines and softmax rows,
+ *              and reports the MUL throughput, per-instance utilization, whether
+ *              results came back in order, and whether every line matches one
+ *              malu without a dispatcher bit for bit.
+ *              Usage: dispatcher_main [num_malu=4] [num_lines=1024]
+ **********/
+
+ #include <systemc.h>
+ #include <cstdlib>
+ #include <cstring>
+ #include <vector>
+ #include "malu_dispatcher.hpp"
+
+ // Streams the same commands into the dispatcher under test (N instances)
+ // and a reference malu without a dispatcher, as a list of batches with one
+ // SFR each:
+ // - FP32 MUL rounded to BF16 with stochastic rounding, with a new seed
+ //   halfway through, so a result only matches the reference bit for bit if
+ //   the SR step does not depend on the instance count
+ // - FP32 compares, then SELECT and a predicated ADD that read their mask
+ // - BF16 softmax rows, each with all its lines on MRF port 0, and MUL lines
+ //   after them on the same SR stream, so the rows must take their SR steps
+ //   as on one MALU
+ // A new SFR is only written once the previous batch has drained.
+ static const int MASK_LINES   = 8;
+ static const int SOFTMAX_ROWS = 3;
+ static const int ROW_LINES    = 4;
+
+ struct tb_batch {
+     int      operation;
+     int      input_format;
+     uint32_t immediate;
+     int      rounding_mode;
+     int      seed;
+     int      commands;
+     int      lines_out;   // result lines per command
+ };
+
+ SC_MODULE(dispatch_tb) {
+     sc_in<bool> clk;
+
+     // [0] => dispatcher under test, [1] => reference
+     sc_vector< sc_fifo_out<sfr_PTR> >       o_sfr;
+     sc_vector< sc_fifo_out<npuc2malu_PTR> > o_cmd;
+     sc_vector< sc_fifo_out<mrf2malu_PTR> >  o_mrf;   // [2*dut + port]
+     sc_vector< sc_fifo_in<malu2mrf_PTR> >   i_res;
+     sc_vector< sc_fifo_in<malu2npuc_PTR> >  i_done;
+
+     int      num_lines;   // lines of the two leading MUL batches
+     int      total_lines; // result lines over all batches
+     int      received[2]; // commands done
+     int      errors;      // out of order
+     int      mismatches;  // lines differing from the reference
+     sc_time  t_first, t_last;
+     std::vector<tb_batch> batches;
+     std::vector< sc_bv<2048> > results[2];
+     sc_event line_in;
+
+     SC_HAS_PROCESS(dispatch_tb);
+     dispatch_tb(sc_module_name name, int lines)
+       : sc_module(name), o_sfr("o_sfr", 2), o_cmd("o_cmd", 2), o_mrf("o_mrf", 4),
+         i_res("i_res", 2), i_done("i_done", 2),
+         num_lines(lines), total_lines(0), errors(0), mismatches(0)
+     {
+         int half = num_lines / 2;
+         uint32_t pred = 1u << 15;
+         uint32_t row  = (uint32_t)ROW_LINES << 16;
+         batches = {
+             {  2, 0, 0,                       2, 0x5A, half,             1 },
+             {  2, 0, 0,                       2, 0x5B, num_lines - half, 1 },
+             { 15, 0, EXT_CMP_LT << 8,         0, 0,    MASK_LINES,       1 },
+             { 15, 0, EXT_SELECT << 8,         0, 0,    MASK_LINES,       1 },
+             {  0, 0, pred,                    0, 0,    MASK_LINES,       1 },
+             { 15, 1, row | EXT_SOFTMAX << 8,  2, 0x5C, SOFTMAX_ROWS,     ROW_LINES },
+             {  2, 0, 0,                       2, 0x5C, MASK_LINES,       1 },
+         };
+         for (const tb_batch& b : batches)
+             total_lines += b.commands * b.lines_out;
+         received[0] = received[1] = 0;
+         results[0].resize(total_lines);
+         results[1].resize(total_lines);
+         SC_THREAD(producer_dut);
+         SC_THREAD(producer_ref);
+         SC_THREAD(consumer_dut);
+         SC_THREAD(consumer_ref);
+     }
+
+     // lane 0 of line i is (i % 256) + 1, exact in BF16, the other lanes
+     // pseudo-random FP32 in [1,2); B is 1.0f in lane 0 and random elsewhere
+     static uint32_t lane_value(int line, int lane, int port) {
+         if (lane == 0) {
+             float f = port ? 1.0f : (float)(line % 256 + 1);
+             uint32_t u;
+             std::memcpy(&u, &f, 4);
+             return u;
+         }
+         uint32_t h = (uint32_t)(line * 64 + lane) * 2654435761u ^ (uint32_t)port * 0x85EBCA6Bu;
+         h ^= h >> 15;
+         return 0x3F800000u | (h & 0x007FFFFFu);
+     }
+
+     static mrf2malu_PTR make_line(int line, int port) {
+         auto p = make_payload<mrf2malu_PTR>();
+         for (int lane = 0; lane < 64; ++lane)
+             p->data.range(lane*32+31, lane*32) = lane_value(line, lane, port);
+         return p;
+     }
+
+     // each side is fed on its own so the reference does not pace the DUT
+     void produce(int d) {
+         int done = 0, line = 0;
+         for (const tb_batch& b : batches) {
+             // a new SFR only once the previous batch has drained, so no
+             // command of it can pick up the new configuration
+             while (received[d] < done)
+                 wait(line_in);
+
+             auto sfr_ptr = std::make_shared<_COMMON_REGISTERS>();
+             sfr_ptr->reg_parsed_mode_math.operation     = b.operation;
+             sfr_ptr->reg_parsed_mode_math.input_format  = b.input_format;
+             sfr_ptr->reg_parsed_mode_math.output_format = (b.operation == 2) ? 1 : b.input_format;
+             sfr_ptr->reg_parsed_mode_math.rounding_mode = b.rounding_mode;
+             sfr_ptr->reg_parsed_option_math_scalar.scalar_index_output  = b.seed;
+             sfr_ptr->reg_parsed_option_math_scalar.scalar_index_input_1 = 0x3C;
+             sfr_ptr->reg_parsed_option_math_immediate.immediate_value   = b.immediate;
+             o_sfr[d].write(sfr_ptr);
+
+             for (int c = 0; c < b.commands; ++c, ++line) {
+                 auto cmd = make_payload<npuc2malu_PTR>();
+                 cmd->start = 1;
+                 o_cmd[d].write(cmd);
+                 if (b.lines_out > 1) {
+                     // a row: both softmax passes read it on port 0
+                     for (int pass = 0; pass < 2; ++pass)
+                         for (int l = 0; l < b.lines_out; ++l)
+                             o_mrf[2*d].write(make_line(line * b.lines_out + l, 0));
+                     continue;
+                 }
+                 o_mrf[2*d  ].write(make_line(line, 0));
+                 o_mrf[2*d+1].write(make_line(line, 1));
+             }
+             done += b.commands;
+         }
+     }
+
+     void producer_dut() { produce(0); }
+     void producer_ref() { produce(1); }
+
+     // results of one command into results[d] from line n on
+     void consume(int d, int n, int lines) {
+         for (int l = 0; l < lines; ++l)
+             results[d][n + l] = i_res[d].read()->data;
+         i_done[d].read();
+         received[d]++;
+         line_in.notify(SC_ZERO_TIME);
+     }
+
+     void consumer_dut() {
+         int n = 0;
+         for (const tb_batch& b : batches) {
+             for (int c = 0; c < b.commands; ++c) {
+                 consume(0, n, b.lines_out);
+                 if (n < num_lines) {
+                     if (n == 0) t_first = sc_time_stamp();
+                     t_last = sc_time_stamp();
+
+                     uint32_t u = results[0][n].range(31, 0).to_uint();
+                     float f;
+                     std::memcpy(&f, &u, 4);
+                     if (f != (float)(n % 256 + 1)) {
+                         if (errors == 0)
+                             std::cout << "[TB] out of order: line " << n << " got " << f << std::endl;
+                         errors++;
+                     }
+                 }
+                 n += b.lines_out;
+             }
+         }
+         finish();
+     }
+
+     void consumer_ref() {
+         int n = 0;
+         for (const tb_batch& b : batches)
+             for (int c = 0; c < b.commands; ++c, n += b.lines_out)
+                 consume(1, n, b.lines_out);
+         finish();
+     }
+
+     void finish() {
+         int commands = 0;
+         for (const tb_batch& b : batches)
+             commands += b.commands;
+         if (received[0] < commands || received[1] < commands)
+             return;
+         for (int i = 0; i < total_lines; ++i) {
+             if (results[0][i] == results[1][i])
+                 continue;
+             if (mismatches == 0)
+                 std::cout << "[TB] line " << i << " differs from the reference malu" << std::endl;
+             mismatches++;
+         }
+         sc_stop();
+     }
+ };
+
+ // The dispatcher has the ports of one malu; d selects the channel set
+ template <class M>
+ static void bind_ports(M& m, int d, sc_clock& clk, sc_signal<bool>& rst,
+                        sc_vector<sc_fifo<npuc2malu_PTR>>& npuc2malu,
+                        sc_vector<sc_fifo<malu2npuc_PTR>>& malu2npuc,
+                        sc_vector<sc_fifo<mrf2malu_PTR>>&  mrf2malu,
+                        sc_vector<sc_fifo<malu2mrf_PTR>>&  malu2mrf,
+                        sc_vector<sc_fifo<sfr_PTR>>&       sfr,
+                        sc_vector<sc_fifo<malu2tcm_PTR>>&  malu2tcm,
+                        sc_vector<sc_fifo<tcm2malu_PTR>>&  tcm2malu)
+ {
+     m.clk(clk);
+     m.reset(rst);
+     m.i_npuc2malu(npuc2malu[d]);
+     m.o_malu2npuc(malu2npuc[d]);
+     for (int i = 0; i < 2; ++i)
+         m.i_mrf2malu[i](mrf2malu[2*d+i]);
+     m.o_malu2mrf(malu2mrf[d]);
+     m.i_reg_map(sfr[d]);
+     m.o_malu2tcm(malu2tcm[d]);
+     for (int j = 0; j < LUT_LINES_PER_BEAT; ++j)
+         m.i_tcm2malu[j](tcm2malu[LUT_LINES_PER_BEAT*d+j]);
+ }
+
+ int sc_main(int argc, char* argv[])
+ {
+     int num_malu  = (argc > 1) ? std::atoi(argv[1]) : 4;
+     int num_lines = (argc > 2) ? std::atoi(argv[2]) : 1024;
+     if (num_malu < 1) num_malu = 1;
+
+     sc_clock clk("clk", 10, SC_NS);
+     sc_signal<bool> rst("rst");
+
+     // [0] => dispatcher under test, [1] => reference (one bare malu)
+     sc_vector<sc_fifo<npuc2malu_PTR>> fifo_npuc2malu("fifo_npuc2malu", 2);
+     sc_vector<sc_fifo<malu2npuc_PTR>> fifo_malu2npuc("fifo_malu2npuc", 2);
+     sc_vector<sc_fifo<mrf2malu_PTR>>  fifo_mrf2malu("fifo_mrf2malu", 4);
+     sc_vector<sc_fifo<malu2mrf_PTR>>  fifo_malu2mrf("fifo_malu2mrf", 2);
+     sc_vector<sc_fifo<sfr_PTR>>       fifo_sfr("fifo_sfr", 2);
+     sc_vector<sc_fifo<malu2tcm_PTR>>  fifo_malu2tcm("fifo_malu2tcm", 2);
+     sc_vector<sc_fifo<tcm2malu_PTR>>  fifo_tcm2malu("fifo_tcm2malu", 2*LUT_LINES_PER_BEAT);
+
+     malu_dispatcher dut("dut_dispatcher", num_malu);
+     malu            ref("ref_malu", 0);
+     bind_ports(dut, 0, clk, rst, fifo_npuc2malu, fifo_malu2npuc, fifo_mrf2malu,
+                fifo_malu2mrf, fifo_sfr, fifo_malu2tcm, fifo_tcm2malu);
+     bind_ports(ref, 1, clk, rst, fifo_npuc2malu, fifo_malu2npuc, fifo_mrf2malu,
+                fifo_malu2mrf, fifo_sfr, fifo_malu2tcm, fifo_tcm2malu);
+
+     dispatch_tb tb("tb", num_lines);
+     tb.clk(clk);
+     for (int d = 0; d < 2; ++d) {
+         tb.o_sfr[d](fifo_sfr[d]);
+         tb.o_cmd[d](fifo_npuc2malu[d]);
+         for (int i = 0; i < 2; ++i)
+             tb.o_mrf[2*d+i](fifo_mrf2malu[2*d+i]);
+         tb.i_res[d](fifo_malu2mrf[d]);
+         tb.i_done[d](fifo_malu2npuc[d]);
+     }
+
+     rst.write(true);
+     sc_start(40, SC_NS);
+     rst.write(false);
+     sc_start();
+
+     double cyc = (tb.t_last - tb.t_first) / clk.period() + 1;
+     std::cout << "[TB] " << num_malu << " MALU, " << tb.num_lines << " lines in "
+               << cyc << " cycles => " << tb.num_lines / cyc << " lines/cycle, "
+               << tb.errors << " order errors, "
+               << tb.mismatches << " lines differ from 1 malu" << std::endl;
+     payload_pool_base::report(std::cout);
+     return (tb.errors || tb.mismatches) ? 1 : 0;
+ }
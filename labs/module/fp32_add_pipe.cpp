@@ -0,0 +1,222 @@
+#include "fp32_add_pipe.hpp"
+#include <iomanip>
+#include <iostream>
+
+/**
+ * fp_add of ops.cpp, one register stage per step:
+ *   - DECODE: fp_unpack a,b; NaN, Inf and zero + zero resolve here and
+ *     ride down the pipe in word
+ *   - ALIGN: larger magnitude first, the smaller one shifted right by the
+ *     exponent difference with a sticky bit
+ *   - ADD: add on equal signs, else subtract; exact cancellation gives +0
+ *   - NORMALIZE: leading one to FP_W, keeping the sticky bit
+ *   - ROUND: fp_round_pack (rounding, subnormals, overflow)
+ *   - PACK: the output register, driving done/result/done_tag
+ *
+ * Every cycle each stage moves into the next one if that one is empty or
+ * moving too; the chain starts at PACK, which moves out when out_ready=1.
+ * A start taken while DECODE cannot move waits in a one-entry skid
+ * register, and ready drops until it has moved on. So ready does not
+ * depend on out_ready in the same cycle, and with out_ready=1 the unit
+ * takes one add per cycle with 6 cycles from start to done.
+ */
+
+fp32_add_pipe::fp32_add_pipe(sc_core::sc_module_name name)
+ : sc_module(name)
+ , clk("clk")
+ , reset("reset")
+ , start("start")
+ , a("a")
+ , b("b")
+ , tag("tag")
+ , ready("ready")
+ , done("done")
+ , result("result")
+ , done_tag("done_tag")
+ , out_ready("out_ready")
+{
+    SC_CTHREAD(pipe_thread, clk.pos());
+    reset_signal_is(reset, true);
+}
+
+fp32_add_pipe::stage_reg fp32_add_pipe::do_decode(sc_uint<32> av,
+                                                  sc_uint<32> bv,
+                                                  sc_uint<8> t) const
+{
+    const int MB = 23;
+    stage_reg r;
+    r.valid = true;
+    r.tag   = t;
+    r.x = fp_unpack(av.to_uint(), MB);
+    r.y = fp_unpack(bv.to_uint(), MB);
+
+    if(r.x.nan || r.y.nan) {
+        r.special = true;
+        r.word    = fp_qnan(MB);
+    } else if(r.x.inf || r.y.inf) {
+        r.special = true;
+        if(r.x.inf && r.y.inf && r.x.sign != r.y.sign)
+            r.word = fp_qnan(MB);                       // Inf - Inf
+        else
+            r.word = fp_pack(r.x.inf ? r.x.sign : r.y.sign, 255, 0, MB);
+    } else if(r.x.sig == 0 && r.y.sig == 0) {
+        r.special = true;
+        r.word    = fp_pack(r.x.sign & r.y.sign, 0, 0, MB);   // -0 only for -0 + -0
+    }
+    return r;
+}
+
+fp32_add_pipe::stage_reg fp32_add_pipe::do_align(stage_reg r) const
+{
+    const int MB = 23;
+    if(r.special)
+        return r;
+    // x gets the larger magnitude
+    if(r.x.exp < r.y.exp || (r.x.exp == r.y.exp && r.x.sig < r.y.sig)) {
+        fp_parts t = r.x; r.x = r.y; r.y = t;
+    }
+    r.sign = r.x.sign;
+    r.exp  = r.x.exp;
+    r.bx   = r.x.sig << (FP_W - MB);
+    r.by   = shr_sticky(r.y.sig << (FP_W - MB), r.x.exp - r.y.exp);
+    return r;
+}
+
+fp32_add_pipe::stage_reg fp32_add_pipe::do_add(stage_reg r) const
+{
+    if(r.special)
+        return r;
+    if(r.x.sign == r.y.sign) {
+        r.bx = r.bx + r.by;
+    } else {
+        r.bx = r.bx - r.by;
+        if(r.bx == 0) {
+            r.special = true;
+            r.word    = 0;                              // exact cancellation => +0
+        }
+    }
+    return r;
+}
+
+fp32_add_pipe::stage_reg fp32_add_pipe::do_normalize(stage_reg r) const
+{
+    if(r.special)
+        return r;
+    // a carry moves the leading one up by one, a cancellation down by many
+    int msb = 63 - __builtin_clzll(r.bx);
+    if(msb > FP_W) { r.bx = shr_sticky(r.bx, msb - FP_W); r.exp += msb - FP_W; }
+    else           { r.bx <<= (FP_W - msb);              r.exp -= FP_W - msb; }
+    return r;
+}
+
+fp32_add_pipe::stage_reg fp32_add_pipe::do_round(stage_reg r) const
+{
+    if(r.special)
+        return r;
+    r.word = fp_round_pack(r.sign, r.exp, r.bx, 23);
+    return r;
+}
+
+fp32_add_pipe::stage_reg fp32_add_pipe::do_pack(stage_reg r) const
+{
+    return r;
+}
+
+fp32_add_pipe::stage_reg fp32_add_pipe::advance(int k, const stage_reg& in) const
+{
+    if(!in.valid)
+        return stage_reg();
+    if(k == ST_ALIGN)     return do_align(in);
+    if(k == ST_ADD)       return do_add(in);
+    if(k == ST_NORMALIZE) return do_normalize(in);
+    if(k == ST_ROUND)     return do_round(in);
+    return do_pack(in);
+}
+
+void fp32_add_pipe::reset_pipe()
+{
+    for(int k=0; k<FP32_ADD_PIPE_DEPTH; k++)
+        pipe[k] = stage_reg();
+    skid  = stage_reg();
+    stats = fp32_add_pipe_stats();
+}
+
+void fp32_add_pipe::clock_edge(bool start_in, sc_uint<32> a_in, sc_uint<32> b_in,
+                               sc_uint<8> tag_in, bool out_ready_in)
+{
+    const int LAST = ST_PACK;
+    stats.cycles++;
+
+    // start is only looked at while ready was shown
+    bool take = start_in && !skid.valid;
+    if(take)
+        stats.issued++;
+
+    // PACK empties if nothing is there or downstream takes it
+    bool open = !pipe[LAST].valid || out_ready_in;
+    if(pipe[LAST].valid) {
+        if(out_ready_in) stats.retired++;
+        else             stats.stall_cycles++;
+    }
+
+    for(int k=LAST; k>ST_DECODE; k--) {
+        if(open) {
+            pipe[k] = advance(k, pipe[k-1]);
+        } else {
+            open = !pipe[k-1].valid;
+        }
+    }
+
+    // DECODE takes the skid entry first, then a new start
+    if(open) {
+        if(skid.valid) {
+            pipe[ST_DECODE] = skid;    // ready was low, take is false
+            skid = stage_reg();
+        } else {
+            pipe[ST_DECODE] = take ? do_decode(a_in, b_in, tag_in) : stage_reg();
+        }
+    } else if(take) {
+        skid = do_decode(a_in, b_in, tag_in);
+    }
+}
+
+void fp32_add_pipe::pipe_thread()
+{
+    // On reset
+    reset_pipe();
+    ready.write(true);
+    done.write(false);
+    result.write(0);
+    done_tag.write(0);
+    stage_valid.write(0);
+    wait();
+
+    while(true) {
+        clock_edge(start.read() && ready.read(), a.read(), b.read(),
+                   tag.read(), out_ready.read());
+
+        const stage_reg& o = out_reg();
+        done.write(o.valid);
+        result.write(o.word);
+        done_tag.write(o.tag);
+        ready.write(in_ready());
+
+        sc_uint<FP32_ADD_PIPE_DEPTH> v = 0;
+        for(int k=0; k<FP32_ADD_PIPE_DEPTH; k++)
+            v[k] = pipe[k].valid;
+        stage_valid.write(v);
+
+        wait();
+    }
+}
+
+void fp32_add_pipe::end_of_simulation()
+{
+    double rate = stats.cycles ? (double)stats.retired / stats.cycles : 0.0;
+    std::cout << "[" << name() << "] issued=" << stats.issued
+              << " retired=" << stats.retired
+              << " cycles=" << stats.cycles
+              << " stalls=" << stats.stall_cycles
+              << " adds/cycle=" << std::fixed << std::setprecision(3) << rate
+              << std::defaultfloat << std::endl;
+}
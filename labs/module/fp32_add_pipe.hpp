@@ -0,0 +1,104 @@
+#ifndef FP32_ADD_PIPE_HPP
+#define FP32_ADD_PIPE_HPP
+
+#include <systemc.h>
+#include <cstdint>
+#include "ops.hpp"
+
+/**
+ * Pipelined FP32 add unit: the fp32_add_1c datapath (fp_unpack, align
+ * with sticky bits, add or subtract, fp_round_pack) cut into register
+ * stages, so a new add can start every cycle and every result is bit for
+ * bit the kernel's. Rounding follows the current ops context; keep it
+ * unchanged while adds are in flight.
+ *
+ * Handshake:
+ *   - start/a/b/tag are taken on a clock edge where ready=1
+ *   - done=1 with result/done_tag for each result, in issue order
+ *   - out_ready=0 holds the result on done and stalls the pipeline;
+ *     tie it to 1 and done is a one-cycle pulse as in fp32_add_unit
+ */
+
+// DECODE, ALIGN, ADD, NORMALIZE, ROUND, PACK
+static const int FP32_ADD_PIPE_DEPTH = 6;
+
+struct fp32_add_pipe_stats {
+    uint64_t cycles       = 0;
+    uint64_t issued       = 0;
+    uint64_t retired      = 0;
+    uint64_t stall_cycles = 0;   // result held on done, out_ready=0
+};
+
+struct fp32_add_pipe : sc_core::sc_module {
+    // Ports
+    sc_in<bool> clk;
+    sc_in<bool> reset;
+
+    sc_in<bool> start;
+    sc_in< sc_uint<32> > a;
+    sc_in< sc_uint<32> > b;
+    sc_in< sc_uint<8> >  tag;        // returned with the result
+
+    sc_out<bool> ready;              // start is accepted next edge
+    sc_out<bool> done;
+    sc_out< sc_uint<32> > result;
+    sc_out< sc_uint<8> >  done_tag;
+    sc_in<bool> out_ready;           // downstream takes the result
+
+    enum PipeStage {
+        ST_DECODE,
+        ST_ALIGN,
+        ST_ADD,
+        ST_NORMALIZE,
+        ST_ROUND,
+        ST_PACK
+    };
+
+    // One pipeline register
+    struct stage_reg {
+        bool        valid   = false;
+        sc_uint<8>  tag     = 0;
+        fp_parts    x{}, y{};          // DECODE: the operands
+        bool        special = false;   // NaN/Inf/zero result, already in word
+        uint32_t    sign    = 0;       // ALIGN on: result sign, exponent
+        int         exp     = 0;
+        uint64_t    bx = 0, by = 0;    // ALIGN: aligned significands, ADD on: bx
+        sc_uint<32> word    = 0;
+    };
+
+    // Valid bit of each stage, bit k = stage k (for tracing)
+    sc_signal< sc_uint<FP32_ADD_PIPE_DEPTH> > stage_valid;
+
+    SC_HAS_PROCESS(fp32_add_pipe);
+    fp32_add_pipe(sc_core::sc_module_name name);
+
+    void pipe_thread();
+    void end_of_simulation();
+
+    // One clock edge with the sampled inputs; the outputs are read back
+    // from out_reg()/in_ready()
+    void clock_edge(bool start_in, sc_uint<32> a_in, sc_uint<32> b_in,
+                    sc_uint<8> tag_in, bool out_ready_in);
+    void reset_pipe();
+
+    const stage_reg& out_reg() const { return pipe[ST_PACK]; }
+    bool in_ready() const { return !skid.valid; }
+    const fp32_add_pipe_stats& get_stats() const { return stats; }
+
+private:
+    stage_reg pipe[FP32_ADD_PIPE_DEPTH];
+    stage_reg skid;     // one accepted op waiting for DECODE to free up
+    fp32_add_pipe_stats stats;
+
+    // stage k's register from stage k-1's
+    stage_reg advance(int k, const stage_reg& in) const;
+
+    stage_reg do_decode(sc_uint<32> av, sc_uint<32> bv, sc_uint<8> t) const;
+    stage_reg do_align(stage_reg r) const;
+    stage_reg do_add(stage_reg r) const;
+    stage_reg do_normalize(stage_reg r) const;
+    stage_reg do_round(stage_reg r) const;
+    stage_reg do_pack(stage_reg r) const;
+};
+
+#endif
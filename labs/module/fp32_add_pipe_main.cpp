@@ -0,0 +1,313 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: fp32_add_pipe_main.cpp
+ * Description: SystemC testbench for fp32_add_pipe. It
+ *              1) runs directed adds (hidden bit, carries, cancellation,
+ *                 opposite signs, rounding ties and sticky bits, NaN/Inf/
+ *                 zero, overflow, subnormals with and without enableSubnorm)
+ *                 against known results,
+ *              2) issues num_ops random adds back to back with out_ready=1
+ *                 and checks one result per cycle, ready never dropping and
+ *                 the same latency, FP32_ADD_PIPE_DEPTH, for every add,
+ *              3) issues them again with random start and random out_ready
+ *                 and checks that every add comes out once, in issue order,
+ *                 with its tag, that a held result stays on done until
+ *                 taken and that no more than the pipe and skid register
+ *                 are ever in flight,
+ *              4) resets the unit with adds in flight and checks that none
+ *                 of them completes,
+ *              comparing every result with fp32_add_1c.
+ *              Usage: fp32_add_pipe_main [num_ops=4096]
+ **********/
+
+ #include <systemc.h>
+ #include <cstdlib>
+ #include <deque>
+ #include <iostream>
+ #include "fp32_add_pipe.hpp"
+ #include "ops.hpp"
+
+ // FP32 bit pattern with a random sign, an exponent within +-24 of the bias
+ // and a random mantissa; 1 in 8 is near the negation of the other operand
+ // (cancellation), 1 in 64 a special (zero, subnormal, infinity or NaN)
+ static uint32_t rand_fp32(uint32_t other) {
+     uint32_t r = (uint32_t)std::rand() << 16 ^ (uint32_t)std::rand();
+     switch (std::rand() % 64) {
+         case 0:  return r & 0x80000000u;                  // +-0
+         case 1:  return r & 0x807FFFFFu;                  // subnormal
+         case 2:  return (r & 0x80000000u) | 0x7F800000u;  // +-inf
+         case 3:  return 0x7FC00000u;                      // NaN
+         case 4: case 5: case 6: case 7: case 8: case 9: case 10: case 11:
+             return (other ^ 0x80000000u) + (r % 5) - 2;
+         default: break;
+     }
+     uint32_t exp = 127 - 24 + std::rand() % 49;
+     return (r & 0x80000000u) | exp << 23 | (r & 0x7FFFFFu);
+ }
+
+ struct add_case {
+     uint32_t    a, b, sum;
+     const char* what;
+ };
+
+ // enableSubnorm off
+ static const add_case flush_cases[] = {
+     { 0x3F800000u, 0x3F800000u, 0x40000000u, "1 + 1, hidden bits carry" },
+     { 0x3FC00000u, 0x3FC00000u, 0x40400000u, "1.5 + 1.5" },
+     { 0x3F800000u, 0x40000000u, 0x40400000u, "1 + 2, hidden bit aligned" },
+     { 0x3F800000u, 0xBF800000u, 0x00000000u, "1 - 1 is +0" },
+     { 0xBF800000u, 0x3F800000u, 0x00000000u, "-1 + 1 is +0" },
+     { 0x40400000u, 0xBF800000u, 0x40000000u, "3 - 1" },
+     { 0x3F800000u, 0xBFC00000u, 0xBF000000u, "1 - 1.5, sign of the larger" },
+     { 0xBF800000u, 0x3E800000u, 0xBF400000u, "-1 + 0.25" },
+     { 0x3F800001u, 0xBF800000u, 0x34000000u, "cancellation to 2^-23" },
+     { 0x3F800000u, 0x33800000u, 0x3F800000u, "1 + 2^-24, tie to even (down)" },
+     { 0x3F800001u, 0x33800000u, 0x3F800002u, "tie to even (up)" },
+     { 0x3F800000u, 0x33800001u, 0x3F800001u, "just above the tie" },
+     { 0x3F800000u, 0xB3000001u, 0x3F7FFFFFu, "borrow with sticky bit" },
+     { 0x3F800000u, 0xB3000000u, 0x3F800000u, "1 - 2^-25, tie to even" },
+     { 0x4B800000u, 0x3F800000u, 0x4B800000u, "2^24 + 1, tie" },
+     { 0x4B800000u, 0x3F800001u, 0x4B800001u, "2^24 + 1+, sticky rounds up" },
+     { 0x7F7FFFFFu, 0x7F7FFFFFu, 0x7F800000u, "overflow to inf" },
+     { 0x7F800000u, 0x3F800000u, 0x7F800000u, "inf + 1" },
+     { 0xFF800000u, 0x7F7FFFFFu, 0xFF800000u, "-inf + max" },
+     { 0x7F800000u, 0xFF800000u, 0x7FC00000u, "inf - inf is NaN" },
+     { 0x7FC00000u, 0x3F800000u, 0x7FC00000u, "NaN + 1" },
+     { 0x3F800000u, 0x7F800001u, 0x7FC00000u, "1 + sNaN is the quiet NaN" },
+     { 0x80000000u, 0x80000000u, 0x80000000u, "-0 + -0" },
+     { 0x00000000u, 0x80000000u, 0x00000000u, "+0 + -0" },
+     { 0x80000000u, 0x3F800000u, 0x3F800000u, "-0 + 1" },
+     { 0x00000001u, 0x00000001u, 0x00000000u, "subnormals flushed" },
+     { 0x00800001u, 0x80800000u, 0x00000000u, "result below normal flushed" },
+ };
+
+ // enableSubnorm on
+ static const add_case subnorm_cases[] = {
+     { 0x00000001u, 0x00000001u, 0x00000002u, "smallest subnormals" },
+     { 0x00400000u, 0x00400000u, 0x00800000u, "subnormals carry to normal" },
+     { 0x00800000u, 0x80400000u, 0x00400000u, "normal minus subnormal" },
+     { 0x00800001u, 0x80800000u, 0x00000001u, "cancellation to a subnormal" },
+     { 0x3F800000u, 0x00000001u, 0x3F800000u, "1 + smallest subnormal" },
+ };
+
+ static const int DEPTH = FP32_ADD_PIPE_DEPTH;
+
+ struct fp32_add_pipe_tb : sc_core::sc_module {
+     sc_in<bool> clk;
+
+     sc_signal<bool>          reset, start, ready, done, out_ready;
+     sc_signal< sc_uint<32> > a, b, result;
+     sc_signal< sc_uint<8> >  tag, done_tag;
+     fp32_add_pipe            dut;
+
+     struct op { uint32_t a, b, sum; uint8_t tag; uint64_t taken; };
+
+     int             num_ops;
+     std::deque<op>  expect;      // taken, in issue order
+     op              next{};      // on a/b/tag while start=1
+     bool            offered;     // start=1 was written
+     uint8_t         next_tag;
+     uint64_t        cycle;
+     uint64_t        taken_n, done_n;
+     int             errors;
+     int             latency;     // edges from take to done seen, -1 until the first
+     bool            stalling;    // out_ready is being dropped
+     bool            held;        // done && !out_ready on the last edge
+     uint32_t        held_word;
+     uint8_t         held_tag;
+
+     SC_HAS_PROCESS(fp32_add_pipe_tb);
+     fp32_add_pipe_tb(sc_module_name name, int ops)
+       : sc_module(name), clk("clk"), dut("dut"), num_ops(ops), offered(false),
+         next_tag(0), cycle(0), taken_n(0), done_n(0), errors(0), latency(-1),
+         stalling(false), held(false), held_word(0), held_tag(0)
+     {
+         dut.clk(clk);
+         dut.reset(reset);
+         dut.start(start);
+         dut.a(a);
+         dut.b(b);
+         dut.tag(tag);
+         dut.ready(ready);
+         dut.done(done);
+         dut.result(result);
+         dut.done_tag(done_tag);
+         dut.out_ready(out_ready);
+         SC_CTHREAD(run, clk.pos());
+     }
+
+     void fail(const char* what) {
+         if (errors++ < 8)
+             std::cerr << "[FP32-ADD-PIPE] " << what << " at cycle " << cycle << std::endl;
+     }
+
+     // one edge: account for what the unit took and gave on it, then drive
+     // the next start (a new add if issue, or the one not yet taken) and
+     // out_ready
+     void step(bool issue, bool oready, uint32_t av, uint32_t bv) {
+         if (held && (!done.read() || result.read().to_uint() != held_word ||
+                      done_tag.read().to_uint() != held_tag))
+             fail("held result changed before it was taken");
+         held = done.read() && !out_ready.read();
+         held_word = result.read().to_uint();
+         held_tag  = done_tag.read().to_uint();
+
+         if (done.read() && out_ready.read()) {
+             done_n++;
+             if (expect.empty()) {
+                 fail("done with nothing in flight");
+             } else {
+                 const op& o = expect.front();
+                 if (done_tag.read().to_uint() != o.tag)
+                     fail("result out of order");
+                 if (result.read().to_uint() != o.sum) {
+                     fail("result differs from fp32_add_1c");
+                     if (errors <= 8)
+                         std::cerr << std::hex << "  a=0x" << o.a << " b=0x" << o.b
+                                   << " got=0x" << result.read().to_uint()
+                                   << " want=0x" << o.sum << std::dec << std::endl;
+                 }
+                 int lat = (int)(cycle - o.taken);
+                 if (latency < 0) latency = lat;
+                 else if (lat < latency) fail("result came out early");
+                 else if (lat != latency && !stalling) fail("latency changed");
+                 expect.pop_front();
+             }
+         }
+
+         bool took = start.read() && ready.read();
+         if (took) {
+             next.taken = cycle;
+             expect.push_back(next);
+             taken_n++;
+             offered = false;
+         }
+         if ((int)expect.size() > DEPTH + 1)
+             fail("more adds in flight than the pipe and skid register hold");
+
+         if (!offered && issue) {
+             next.a = av;
+             next.b = bv;
+             next.sum = fp32_add_1c(av, bv).to_uint();
+             next.tag = next_tag++;
+             offered = true;
+         }
+         start.write(offered);
+         a.write(next.a);
+         b.write(next.b);
+         tag.write(next.tag);
+         out_ready.write(oready);
+         wait();
+         cycle++;
+     }
+
+     void random_step(bool issue, bool oready) {
+         uint32_t av = rand_fp32(0x3F800000u);
+         step(issue, oready, av, rand_fp32(av));
+     }
+
+     void drain() {
+         for (int i = 0; i < 2 * DEPTH + 4 && (offered || !expect.empty()); i++)
+             step(false, true, 0, 0);
+         if (offered || !expect.empty()) fail("adds never completed");
+     }
+
+     void directed(const add_case* c, int n) {
+         for (int i = 0; i < n; i++) {
+             if (fp32_add_1c(c[i].a, c[i].b).to_uint() != c[i].sum) {
+                 std::cerr << "[FP32-ADD-PIPE] fp32_add_1c: " << c[i].what << std::endl;
+                 errors++;
+             }
+             step(true, true, c[i].a, c[i].b);
+         }
+         drain();
+     }
+
+     void run() {
+         reset.write(true);
+         start.write(false);
+         out_ready.write(true);
+         wait(2);
+         reset.write(false);
+         wait();
+
+         // 1) directed
+         setOpsContext(false, false, false, true);
+         directed(flush_cases, sizeof(flush_cases) / sizeof(flush_cases[0]));
+         setOpsContext(true, false, false, true);
+         directed(subnorm_cases, sizeof(subnorm_cases) / sizeof(subnorm_cases[0]));
+
+         // 2) back to back with out_ready=1
+         uint64_t first_done = 0, last_done = 0, seen = 0;
+         latency = -1;
+         for (int i = 0; i < num_ops + 2 * DEPTH; i++) {
+             if (done.read()) {
+                 if (seen++ == 0) first_done = cycle;
+                 last_done = cycle;
+             }
+             if (!ready.read())
+                 fail("ready dropped with out_ready=1");
+             random_step(i < num_ops, true);
+         }
+         if (seen != (uint64_t)num_ops || last_done - first_done + 1 != (uint64_t)num_ops)
+             fail("back-to-back adds did not complete one per cycle");
+         if (latency != DEPTH)
+             fail("latency is not FP32_ADD_PIPE_DEPTH");
+         double adds_per_cycle = seen ? (double)seen / (last_done - first_done + 1) : 0.0;
+         drain();
+
+         // 3) random start and out_ready
+         uint64_t stalls = 0, not_ready = 0;
+         stalling = true;
+         for (int i = 0; i < num_ops; i++) {
+             bool oready = std::rand() % 3 != 0;
+             if (!oready) stalls++;
+             if (!ready.read()) not_ready++;
+             random_step(std::rand() % 4 != 0, oready);
+         }
+         drain();
+         stalling = false;
+         if (!stalls || !not_ready)
+             fail("random phase never stalled the pipe");
+         if (taken_n != done_n)
+             fail("adds lost or duplicated");
+         if (dut.get_stats().issued != taken_n || dut.get_stats().retired != done_n)
+             fail("unit counters differ from the handshakes seen");
+
+         // 4) reset with adds in flight: none of them may finish
+         for (int i = 0; i < DEPTH; i++) random_step(true, false);
+         reset.write(true);
+         start.write(false);
+         wait(); cycle++;
+         reset.write(false);
+         out_ready.write(true);
+         expect.clear();
+         offered = false;
+         for (int i = 0; i < DEPTH + 4; i++) {
+             wait(); cycle++;
+             if (done.read()) fail("add survived reset");
+             if (!ready.read()) fail("not ready after reset");
+         }
+
+         std::cout << "[FP32-ADD-PIPE] adds/cycle=" << adds_per_cycle
+                   << " latency=" << latency
+                   << " taken=" << taken_n << " done=" << done_n
+                   << " stall cycles=" << stalls << " not ready=" << not_ready
+                   << " errors=" << errors << std::endl;
+         sc_stop();
+     }
+ };
+
+ int sc_main(int argc, char* argv[]) {
+     int num_ops = (argc > 1) ? std::atoi(argv[1]) : 4096;
+     std::srand(1);
+
+     sc_clock clk("clk", 10, SC_NS);
+     fp32_add_pipe_tb tb("tb", num_ops);
+     tb.clk(clk);
+
+     sc_start();
+     std::cout << "[FP32-ADD-PIPE] " << (tb.errors ? "FAIL" : "PASS") << std::endl;
+     return tb.errors ? 1 : 0;
+ }
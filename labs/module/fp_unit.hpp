@@ -0,0 +1,157 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: fp_unit.hpp
+ * Description: Multi-cycle FP arithmetic unit, one template for every format
+ *              and operation:
+ *                fp_unit<Format, Op, Stages>
+ *                fp_add_unit<Format, Stages>, fp_sub_unit, fp_mul_unit,
+ *                fp_fma_unit
+ *              The arithmetic is the single-cycle kernel of ops.cpp for the
+ *              format, so the unit gives the same bits as the MALU lanes;
+ *              Stages only sets the latency. The unit is fully pipelined:
+ *              a new operation every cycle, each one done Stages edges
+ *              after its start.
+ *
+ *              The unit is one clocked SC_METHOD with its state in plain
+ *              members: no coroutine stack and no signal latches, so
+ *              hundreds of instances elaborate and run cheaply.
+ **********/
+#pragma once
+#include <systemc.h>
+#include "ops.hpp"
+
+/**
+ * Formats: the kernels of ops.cpp plus where the value sits in the
+ * 32-bit port word (BF16 in the upper 16 bits, as in a MALU lane).
+ */
+struct fp32_format {
+    static const int EXP_BITS = 8;
+    static const int MAN_BITS = 23;
+    static sc_uint<32> add(sc_uint<32> a, sc_uint<32> b) { return fp32_add_1c(a,b); }
+    static sc_uint<32> sub(sc_uint<32> a, sc_uint<32> b) { return fp32_sub_1c(a,b); }
+    static sc_uint<32> mul(sc_uint<32> a, sc_uint<32> b) { return fp32_mul_1c(a,b); }
+    static sc_uint<32> fma(sc_uint<32> a, sc_uint<32> b, sc_uint<32> c) { return fp32_fma_1c(a,b,c); }
+};
+
+struct bf16_format {
+    static const int EXP_BITS = 8;
+    static const int MAN_BITS = 7;
+    static sc_uint<32> add(sc_uint<32> a, sc_uint<32> b) { return bf16_add_1c(a,b); }
+    static sc_uint<32> sub(sc_uint<32> a, sc_uint<32> b) { return bf16_sub_1c(a,b); }
+    static sc_uint<32> mul(sc_uint<32> a, sc_uint<32> b) { return bf16_mul_1c(a,b); }
+    static sc_uint<32> fma(sc_uint<32> a, sc_uint<32> b, sc_uint<32> c) { return bf16_fma_1c(a,b,c); }
+};
+
+enum fp_unit_op {
+    FP_UNIT_ADD,
+    FP_UNIT_SUB,
+    FP_UNIT_MUL,
+    FP_UNIT_FMA     // a*b + c, rounded once (as MALU op 14)
+};
+
+/**
+ * start=1 on an edge takes a, b (and c for FMA), on every edge if need be;
+ * done=1 with the result for one cycle, Stages edges later, in issue order.
+ * The operations in flight sit in a Stages-deep shift register. There is no
+ * stall: the consumer samples done/result on each edge.
+ */
+template<class Format, fp_unit_op Op, int Stages>
+struct fp_unit : sc_core::sc_module {
+    static_assert(Stages >= 1, "fp_unit needs at least one stage");
+
+    // Ports
+    sc_in<bool> clk;
+    sc_in<bool> reset;
+
+    sc_in<bool> start;
+    sc_in< sc_uint<32> > a;
+    sc_in< sc_uint<32> > b;
+    // addend, FMA only; may be left unbound otherwise
+    sc_port< sc_signal_in_if< sc_uint<32> >, 1, SC_ZERO_OR_MORE_BOUND > c;
+
+    sc_out<bool> done;
+    sc_out< sc_uint<32> > result;
+
+    SC_HAS_PROCESS(fp_unit);
+    fp_unit(sc_core::sc_module_name name)
+     : sc_module(name)
+     , clk("clk")
+     , reset("reset")
+     , start("start")
+     , a("a")
+     , b("b")
+     , c("c")
+     , done("done")
+     , result("result")
+     , in_flight(0)
+     , done_q(false)
+    {
+        for(int i=0; i<Stages; i++) valid[i] = false;
+        SC_METHOD(clock_method);
+        sensitive << clk.pos();
+        dont_initialize();
+    }
+
+    bool busy() const { return in_flight != 0; }
+
+    static sc_uint<32> compute(sc_uint<32> av, sc_uint<32> bv, sc_uint<32> cv) {
+        if(Op == FP_UNIT_ADD) return Format::add(av, bv);
+        if(Op == FP_UNIT_SUB) return Format::sub(av, bv);
+        if(Op == FP_UNIT_MUL) return Format::mul(av, bv);
+        return Format::fma(av, bv, cv);
+    }
+
+    // One clock edge: the last stage goes out, the rest shift by one and
+    // a new operation enters stage 0
+    void clock_method() {
+        if(reset.read()) {
+            for(int i=0; i<Stages; i++) valid[i] = false;
+            in_flight = 0;
+            set_done(false);
+            result.write(0);
+            return;
+        }
+
+        if(in_flight == 0 && !start.read()) {
+            set_done(false);    // idle: nothing to shift
+            return;
+        }
+
+        bool out = valid[Stages-1];
+        if(out) {
+            result.write(stage[Stages-1]);
+            in_flight--;
+        }
+        set_done(out);
+
+        for(int i=Stages-1; i>0; i--) {
+            valid[i] = valid[i-1];
+            stage[i] = stage[i-1];
+        }
+        valid[0] = start.read();
+        if(valid[0]) {
+            sc_uint<32> cv = (Op == FP_UNIT_FMA && c.size() > 0) ? c->read() : sc_uint<32>(0);
+            stage[0] = compute(a.read(), b.read(), cv);
+            in_flight++;
+        }
+    }
+
+private:
+    void set_done(bool v) {
+        if(done_q != v) {
+            done.write(v);
+            done_q = v;
+        }
+    }
+
+    bool        valid[Stages];  // stage i holds an operation i+1 edges after its start
+    sc_uint<32> stage[Stages];  // its result, computed on entry
+    int         in_flight;
+    bool        done_q;
+};
+
+template<class Format, int Stages> using fp_add_unit = fp_unit<Format, FP_UNIT_ADD, Stages>;
+template<class Format, int Stages> using fp_sub_unit = fp_unit<Format, FP_UNIT_SUB, Stages>;
+template<class Format, int Stages> using fp_mul_unit = fp_unit<Format, FP_UNIT_MUL, Stages>;
+template<class Format, int Stages> using fp_fma_unit = fp_unit<Format, FP_UNIT_FMA, Stages>;
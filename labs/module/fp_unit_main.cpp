@@ -0,0 +1,196 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: fp_unit_main.cpp
+ * Description: SystemC testbench for the pipelined fp_unit. For several
+ *              format/op/depth combinations it
+ *              1) issues num_ops operations back to back and checks that
+ *                 done comes on num_ops consecutive cycles (one per cycle)
+ *                 with the same latency, Stages, for every operation,
+ *              2) issues them again with random idle cycles in between,
+ *              3) resets the unit with operations in flight and checks that
+ *                 none of them completes,
+ *              comparing every result, in issue order, with the ops.cpp
+ *              kernel of the format.
+ *              Usage: fp_unit_main [num_ops=4096]
+ **********/
+
+ #include <systemc.h>
+ #include <cstdlib>
+ #include <deque>
+ #include <iostream>
+ #include "fp_unit.hpp"
+ #include "fp32_add_unit.hpp"
+ #include "bf16_add_unit.hpp"
+
+ static int tb_running  = 0;
+ static int tb_failures = 0;
+
+ // FP32 bit pattern with a random sign, an exponent within +-8 of the bias
+ // (so adds cancel and round) and a random mantissa; 1 in 64 is a special
+ // (zero, infinity or NaN)
+ static uint32_t rand_fp32() {
+     uint32_t r = (uint32_t)std::rand() << 16 ^ (uint32_t)std::rand();
+     switch (std::rand() % 64) {
+         case 0:  return r & 0x80000000u;                  // +-0
+         case 1:  return (r & 0x80000000u) | 0x7F800000u;  // +-inf
+         case 2:  return 0x7FC00000u;                      // NaN
+         default: break;
+     }
+     uint32_t exp = 127 - 8 + std::rand() % 17;
+     return (r & 0x80000000u) | exp << 23 | (r & 0x7FFFFFu);
+ }
+
+ template<class Unit, class Format, fp_unit_op Op, int Stages>
+ struct fp_unit_tb : sc_core::sc_module {
+     sc_in<bool> clk;
+
+     sc_signal<bool>          reset, start, done;
+     sc_signal< sc_uint<32> > a, b, c, result;
+     Unit                     dut;
+
+     const char* label;
+     int         num_ops;
+     std::deque<uint32_t> expect;   // results in issue order
+     std::deque<uint64_t> issued;   // cycle each one was issued
+     uint64_t    cycle;
+     int         errors;
+     int         latency;           // edges from issue to done seen, -1 until the first
+
+     SC_HAS_PROCESS(fp_unit_tb);
+     fp_unit_tb(sc_module_name name, const char* lbl, int ops)
+       : sc_module(name), clk("clk"), dut("dut"), label(lbl), num_ops(ops),
+         cycle(0), errors(0), latency(-1)
+     {
+         dut.clk(clk);
+         dut.reset(reset);
+         dut.start(start);
+         dut.a(a);
+         dut.b(b);
+         if (Op == FP_UNIT_FMA) dut.c(c);
+         dut.done(done);
+         dut.result(result);
+         tb_running++;
+         SC_CTHREAD(run, clk.pos());
+     }
+
+     static uint32_t reference(uint32_t av, uint32_t bv, uint32_t cv) {
+         if (Op == FP_UNIT_ADD) return Format::add(av, bv).to_uint();
+         if (Op == FP_UNIT_SUB) return Format::sub(av, bv).to_uint();
+         if (Op == FP_UNIT_MUL) return Format::mul(av, bv).to_uint();
+         return Format::fma(av, bv, cv).to_uint();
+     }
+
+     void fail(const char* what) {
+         if (errors++ < 8)
+             std::cerr << "[FP-UNIT] " << label << ": " << what << " at cycle " << cycle << std::endl;
+     }
+
+     // one edge: check what the unit finished, then drive the next input
+     void step(bool issue) {
+         if (done.read()) {
+             if (expect.empty()) {
+                 fail("done with nothing in flight");
+             } else {
+                 if (result.read().to_uint() != expect.front())
+                     fail("result differs from the kernel");
+                 int lat = (int)(cycle - issued.front());
+                 if (latency < 0) latency = lat;
+                 else if (lat != latency) fail("latency changed");
+                 expect.pop_front();
+                 issued.pop_front();
+             }
+         }
+
+         start.write(issue);
+         if (issue) {
+             uint32_t av = rand_fp32(), bv = rand_fp32(), cv = rand_fp32();
+             a.write(av); b.write(bv); c.write(cv);
+             expect.push_back(reference(av, bv, cv));
+             issued.push_back(cycle);
+         }
+         wait();
+         cycle++;
+     }
+
+     void drain() {
+         for (int i = 0; i < Stages + 4 && !expect.empty(); i++) step(false);
+         if (!expect.empty()) fail("operations never completed");
+         expect.clear();
+         issued.clear();
+     }
+
+     void run() {
+         reset.write(true);
+         start.write(false);
+         wait(2);
+         reset.write(false);
+         wait();
+
+         // 1) back to back: done must stay high for num_ops cycles
+         uint64_t first_done = 0, last_done = 0;
+         int      seen = 0;
+         for (int i = 0; i < num_ops + Stages + 4; i++) {
+             if (done.read()) {
+                 if (seen++ == 0) first_done = cycle;
+                 last_done = cycle;
+             }
+             step(i < num_ops);
+         }
+         if (seen != num_ops || last_done - first_done + 1 != (uint64_t)num_ops)
+             fail("back-to-back operations did not complete one per cycle");
+         // start written on edge k is taken on k+1, done is written Stages
+         // edges later and seen here on the edge after that
+         if (latency != Stages + 2)
+             fail("latency is not Stages");
+         double ops_per_cycle = seen ? (double)seen / (last_done - first_done + 1) : 0.0;
+         drain();
+
+         // 2) random bubbles
+         for (int i = 0; i < num_ops; i++) step(std::rand() % 4 != 0);
+         drain();
+
+         // 3) reset with operations in flight: none of them may finish
+         for (int i = 0; i < Stages; i++) step(true);
+         reset.write(true);
+         start.write(false);
+         wait(); cycle++;
+         reset.write(false);
+         expect.clear();
+         issued.clear();
+         for (int i = 0; i < Stages + 4; i++) {
+             wait(); cycle++;
+             if (done.read()) fail("operation survived reset");
+         }
+
+         std::cout << "[FP-UNIT] " << label << " stages=" << Stages
+                   << ": ops/cycle=" << ops_per_cycle << " latency=" << latency
+                   << " errors=" << errors << std::endl;
+         if (errors) tb_failures++;
+         if (--tb_running == 0) sc_stop();
+     }
+ };
+
+ int sc_main(int argc, char* argv[]) {
+     int num_ops = (argc > 1) ? std::atoi(argv[1]) : 4096;
+     std::srand(1);
+
+     sc_clock clk("clk", 10, SC_NS);
+     fp_unit_tb<fp32_add_unit, fp32_format, FP_UNIT_ADD, 6>
+         t0("fp32_add", "fp32 add", num_ops);
+     fp_unit_tb<bf16_add_unit, bf16_format, FP_UNIT_ADD, 6>
+         t1("bf16_add", "bf16 add", num_ops);
+     fp_unit_tb<fp_sub_unit<fp32_format, 1>, fp32_format, FP_UNIT_SUB, 1>
+         t2("fp32_sub", "fp32 sub", num_ops);
+     fp_unit_tb<fp_mul_unit<bf16_format, 3>, bf16_format, FP_UNIT_MUL, 3>
+         t3("bf16_mul", "bf16 mul", num_ops);
+     fp_unit_tb<fp_fma_unit<fp32_format, 4>, fp32_format, FP_UNIT_FMA, 4>
+         t4("fp32_fma", "fp32 fma", num_ops);
+     fp_unit_tb<fp_fma_unit<bf16_format, 2>, bf16_format, FP_UNIT_FMA, 2>
+         t5("bf16_fma", "bf16 fma", num_ops);
+     t0.clk(clk); t1.clk(clk); t2.clk(clk); t3.clk(clk); t4.clk(clk); t5.clk(clk);
+
+     sc_start();
+     std::cout << "[FP-UNIT] " << (tb_failures ? "FAIL" : "PASS") << std::endl;
+     return tb_failures ? 1 : 0;
+ }
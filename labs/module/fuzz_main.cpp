@@ -0,0 +1,1127 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: fuzz_main.cpp
+ * Description: Differential fuzzer for the MALU lane kernels (ops.cpp,
+ *              typecast_ops.cpp, logic_ops.cpp, act_ops.cpp, macro_ops.cpp)
+ *              against host IEEE 754 arithmetic, on all hardware threads.
+ *              For each setOpsContext mode it checks
+ *                fp32 add/sub/mul  random pairs, special values mixed in
+ *                bf16 add/sub/mul  all 2^32 pairs (or random pairs)
+ *                fp32->bf16, fp32->int8  all 2^32 inputs (or random)
+ *                bf16->fp32        all 2^16 inputs
+ *                fp32/int32 cmp    random pairs, eq/lt/le in one result
+ *                bf16 cmp          all 2^32 pairs (or random pairs)
+ *                fp32/bf16 select  random pairs, 64 per line through
+ *                                  malu_datapath: CMP_LT writes the lane
+ *                                  mask, SELECT reads it (A < B ? A : B)
+ *                fp32 activations  random inputs, mostly |x| < 128
+ *                bf16 activations  all 2^16 inputs
+ *                max/min (fp32, bf16, int32), abs/neg, and/or/xor,
+ *                shl/shr/sra       random pairs, shift count b[4:0]
+ *                fp32/bf16 fma, bf16x2 dot
+ *                                  random triples, 1 in 4 addends near -a*b
+ *                LUT ops 5..11 (rcp, rsqrt even/odd, log, exp, sin, cos;
+ *                fp32 random, bf16 all 2^16 inputs)
+ *                                  table size b[5:0] drawn at random
+ *                softmax, rmsnorm, layernorm (fp32, bf16)
+ *                                  random rows of 4 lines
+ *              and prints per op a ULP error histogram, the first failure as
+ *              a command line that reproduces it, and kernels/sec.
+ *
+ *              Usage: fuzz_main [key=value ...]
+ *                threads=N      worker threads (default: all cores)
+ *                fp32=N         random cases per op and mode (2^24): FP32
+ *                               pairs, select lanes, activation inputs
+ *                               and macro-op elements
+ *                exhaustive=0|1 sweep BF16 pairs and unary inputs fully (1),
+ *                               or draw fp32=N random ones (0)
+ *                modes=ieee|all ieee: subnorm, round to nearest, no clamp,
+ *                               except on; all: the 16 flag combinations
+ *                seed=S         random seed (1)
+ *              Reproduce one case (a macro-op case is a whole row):
+ *                fuzz_main op=fp32_add mode=0x9 a=0x3f800000 b=0x33800000
+ *                fuzz_main op=fp32_fma mode=0x9 a=0x3f800000 b=0x3f800000 c=0xbf800000
+ *                fuzz_main op=fp32_softmax mode=0x9 seed=1 row=42
+ *              mode bits: 0 subnorm, 1 trunc, 2 clamp, 3 except
+ *              Exit status 1 if any case fails.
+ *
+ *              Reference: BF16/FP32 operands are exact doubles; a product is
+ *              exact, a sum gets its rounding error from TwoSum. The exact
+ *              result is rounded to odd in double, then to FP32 by the host
+ *              (to nearest or toward zero), or to odd in FP32 and then to
+ *              BF16 by nearest-candidate compare, so no double rounding.
+ *              Flush-to-zero, clamp and except=0 are applied around that;
+ *              with except=0, NaN/Inf operands are skipped. Without the
+ *              subnorm flag the narrowing to BF16 reads a subnormal FP32
+ *              value as zero, like the kernels read their operands.
+ *              Compares, select and activations do not look at the mode
+ *              (bar BF16 rounding and flush), so they are checked on
+ *              NaN/Inf as well.
+ *
+ *              An FMA is one exact product plus the addend, rounded once
+ *              (std::fma, but through the same rounding path as add); the
+ *              dot is mul, mul, add, add composed from those references.
+ *              LUT ops sample the same tables at i/n; the FP32 steps the
+ *              kernel defines (x*log2(e), x/(2*pi), their fractions and
+ *              e*ln2 + entry) are rounded to FP32 in the reference too.
+ *
+ *              Everything but the activations and macro-ops must match bit
+ *              for bit. The LUT-based activations and macro-ops get a
+ *              tolerance, in ulps of the format taken
+ *              at max(|reference|, floor):
+ *                fp32 sigmoid 4, tanh 16, silu 16, gelu 256 (for x < -8
+ *                  the tanh argument's rounding is amplified by 2u)
+ *                softmax, rmsnorm 16, layernorm 256 (x - mean with
+ *                  |mean|/std up to 28); the norms take the row's largest
+ *                  |output| as floor
+ *                bf16 activations and macro-ops 1, from rounding the FP32
+ *                  result
+ *              floor is 2^-100 elsewhere, so flushing a result that small
+ *              to zero is not an error.
+ **********/
+
+ #include <systemc.h>
+ #include <atomic>
+ #include <chrono>
+ #include <cmath>
+ #include <cstdint>
+ #include <cstdlib>
+ #include <cstring>
+ #include <iomanip>
+ #include <iostream>
+ #include <mutex>
+ #include <sstream>
+ #include <string>
+ #include <thread>
+ #include <vector>
+ #include "ops.hpp"
+ #include "typecast_ops.hpp"
+ #include "logic_ops.hpp"
+ #include "act_ops.hpp"
+ #include "macro_ops.hpp"
+ #include "malu_funccore.hpp"
+
+ enum fuzz_op {
+     OP_FP32_ADD, OP_FP32_SUB, OP_FP32_MUL,
+     OP_BF16_ADD, OP_BF16_SUB, OP_BF16_MUL,
+     OP_FP32_TO_BF16, OP_FP32_TO_INT8, OP_BF16_TO_FP32,
+     OP_FP32_CMP, OP_BF16_CMP, OP_INT32_CMP,
+     OP_FP32_SELECT, OP_BF16_SELECT,
+     OP_FP32_RELU, OP_FP32_GELU, OP_FP32_SILU, OP_FP32_SIGMOID, OP_FP32_TANH,
+     OP_BF16_RELU, OP_BF16_GELU, OP_BF16_SILU, OP_BF16_SIGMOID, OP_BF16_TANH,
+     OP_FP32_MAX, OP_BF16_MAX, OP_INT32_MAX, OP_FP32_MIN, OP_BF16_MIN, OP_INT32_MIN,
+     OP_FP32_ABS, OP_FP32_NEG, OP_INT32_ABS, OP_INT32_NEG,
+     OP_INT32_AND, OP_INT32_OR, OP_INT32_XOR, OP_INT32_SHL, OP_INT32_SHR, OP_INT32_SRA,
+     OP_FP32_FMA, OP_BF16_FMA, OP_BF16X2_DOT,
+     OP_FP32_RCP, OP_FP32_RSQRT_EVEN, OP_FP32_RSQRT_ODD, OP_FP32_LOG, OP_FP32_EXP, OP_FP32_SIN, OP_FP32_COS,
+     OP_BF16_RCP, OP_BF16_RSQRT_EVEN, OP_BF16_RSQRT_ODD, OP_BF16_LOG, OP_BF16_EXP, OP_BF16_SIN, OP_BF16_COS,
+     OP_FP32_SOFTMAX, OP_FP32_RMSNORM, OP_FP32_LAYERNORM,
+     OP_BF16_SOFTMAX, OP_BF16_RMSNORM, OP_BF16_LAYERNORM,
+     OP_NUM
+ };
+
+ static const char* op_names[OP_NUM] = {
+     "fp32_add", "fp32_sub", "fp32_mul",
+     "bf16_add", "bf16_sub", "bf16_mul",
+     "fp32_to_bf16", "fp32_to_int8", "bf16_to_fp32",
+     "fp32_cmp", "bf16_cmp", "int32_cmp",
+     "fp32_select", "bf16_select",
+     "fp32_relu", "fp32_gelu", "fp32_silu", "fp32_sigmoid", "fp32_tanh",
+     "bf16_relu", "bf16_gelu", "bf16_silu", "bf16_sigmoid", "bf16_tanh",
+     "fp32_max", "bf16_max", "int32_max", "fp32_min", "bf16_min", "int32_min",
+     "fp32_abs", "fp32_neg", "int32_abs", "int32_neg",
+     "int32_and", "int32_or", "int32_xor", "int32_shl", "int32_shr", "int32_sra",
+     "fp32_fma", "bf16_fma", "bf16x2_dot",
+     "fp32_rcp", "fp32_rsqrt_even", "fp32_rsqrt_odd", "fp32_log", "fp32_exp", "fp32_sin", "fp32_cos",
+     "bf16_rcp", "bf16_rsqrt_even", "bf16_rsqrt_odd", "bf16_log", "bf16_exp", "bf16_sin", "bf16_cos",
+     "fp32_softmax", "fp32_rmsnorm", "fp32_layernorm",
+     "bf16_softmax", "bf16_rmsnorm", "bf16_layernorm"
+ };
+
+ enum { MODE_SUBNORM = 1, MODE_TRUNC = 2, MODE_CLAMP = 4, MODE_EXCEPT = 8 };
+
+ static bool is_cmp(int op)    { return op >= OP_FP32_CMP && op <= OP_INT32_CMP; }
+ static bool is_select(int op) { return op == OP_FP32_SELECT || op == OP_BF16_SELECT; }
+ static bool is_act(int op)    { return op >= OP_FP32_RELU && op <= OP_BF16_TANH; }
+ static bool is_macro(int op)  { return op >= OP_FP32_SOFTMAX; }
+ static bool is_raw(int op)    { return op >= OP_FP32_MAX && op <= OP_INT32_SRA; }   // whole lanes, no rounding
+ static bool is_fma(int op)    { return op == OP_FP32_FMA || op == OP_BF16_FMA || op == OP_BF16X2_DOT; }
+ static bool is_lut(int op)    { return op >= OP_FP32_RCP && op <= OP_BF16_COS; }
+ static bool is_binary(int op)
+ {
+     return op <= OP_BF16_MUL || is_cmp(op) || is_select(op) || is_fma(op) ||
+            (is_raw(op) && !(op >= OP_FP32_ABS && op <= OP_INT32_NEG));
+ }
+ static bool is_bf16_in(int op)
+ {
+     return (op >= OP_BF16_ADD && op <= OP_BF16_MUL) || op == OP_BF16_TO_FP32 ||
+            op == OP_BF16_CMP || op == OP_BF16_SELECT ||
+            (op >= OP_BF16_RELU && op <= OP_BF16_TANH) ||
+            op == OP_BF16_MAX || op == OP_BF16_MIN || op == OP_BF16_FMA ||
+            (op >= OP_BF16_RCP && op <= OP_BF16_COS) || op >= OP_BF16_SOFTMAX;
+ }
+ static ActFunc act_func(int op) { return (ActFunc)(ACT_RELU + (op - OP_FP32_RELU) % 5); }
+ static unsigned lut_op(int op)  { return 5 + (op - OP_FP32_RCP) % 7; }      // MALU operation 5..11
+ static LaneType lane_type(int op)
+ {
+     return (op == OP_BF16_MAX || op == OP_BF16_MIN) ? LANE_BF16 :
+            (op == OP_INT32_MAX || op == OP_INT32_MIN || op >= OP_INT32_ABS) ? LANE_INT32 : LANE_FP32;
+ }
+
+ // Largest ULP bin that still passes (ulp_names below)
+ static int tolerance(int op)
+ {
+     if(is_macro(op)) return is_bf16_in(op) ? 1 : ((op - OP_FP32_SOFTMAX) % 3 == 2) ? 5 : 4;
+     if(!is_act(op) || act_func(op) == ACT_RELU) return 0;
+     if(is_bf16_in(op)) return 1;
+     switch(act_func(op)) {
+         case ACT_SIGMOID: return 3;
+         case ACT_GELU:    return 5;
+         default:          return 4;
+     }
+ }
+
+ // Macro-op rows: ROW_LINES lines of MALU_LANES lanes, one case per lane
+ static const int ROW_LINES = 4;
+ static const int ROW       = ROW_LINES * MALU_LANES;
+ static const float NORM_EPS = 1e-5f;
+
+ //---------------------------------------------------------------------
+ // Bit helpers
+ //---------------------------------------------------------------------
+ static inline float    u2f(uint32_t u) { float f; std::memcpy(&f, &u, 4); return f; }
+ static inline uint32_t f2u(float f)    { uint32_t u; std::memcpy(&u, &f, 4); return u; }
+ static inline double   u2d(uint64_t u) { double d; std::memcpy(&d, &u, 8); return d; }
+ static inline uint64_t d2u(double d)   { uint64_t u; std::memcpy(&u, &d, 8); return u; }
+
+ static inline bool f32_nan(uint32_t u)  { return (u & 0x7F800000u) == 0x7F800000u && (u & 0x007FFFFFu); }
+ static inline bool f32_spec(uint32_t u) { return (u & 0x7F800000u) == 0x7F800000u; }
+ static inline bool f32_sub(uint32_t u)  { return (u & 0x7F800000u) == 0 && (u & 0x007FFFFFu); }
+
+ // Integer order of the FP32 values, -0 and +0 both 0
+ static int64_t ordered(uint32_t u) { return (u & 0x80000000u) ? -(int64_t)(u & 0x7FFFFFFFu) : (int64_t)u; }
+
+ //---------------------------------------------------------------------
+ // Reference
+ //---------------------------------------------------------------------
+
+ // Round-to-odd double of a+b (TwoSum gives the exact error)
+ static double sum_odd(double a, double b)
+ {
+     double s  = a + b;
+     double bb = s - a;
+     double e  = (a - (s - bb)) + (b - bb);
+     if(e == 0 || std::isinf(s))
+         return s;
+     if((s > 0) != (e > 0))
+         s = std::nextafter(s, 0.0);              // s was rounded away from zero
+     return u2d(d2u(s) | 1);
+ }
+
+ // Double (already rounded to odd) to FP32, to nearest even or toward zero
+ static float to_fp32(double d, bool trunc)
+ {
+     float f = (float)d;
+     if(trunc && std::fabs((double)f) > std::fabs(d))
+         f = std::nextafter(f, 0.0f);
+     return f;
+ }
+
+ // FP32 rounded to odd, from a double rounded to odd
+ static float to_fp32_odd(double d)
+ {
+     float f = to_fp32(d, true);
+     if((double)f != d && !std::isinf(d))
+         f = u2f(f2u(f) | 1);
+     return f;
+ }
+
+ // FP32 to BF16 (upper 16 bits), candidates compared as exact doubles
+ static uint32_t fp32_to_bf16_ref(float f, bool trunc)
+ {
+     uint32_t u = f2u(f);
+     if(f32_nan(u))
+         return 0x7FC00000u;
+     uint32_t lo = u & 0xFFFF0000u;
+     if(lo == u || trunc)
+         return lo;
+     uint32_t hi  = lo + 0x10000u;                 // next magnitude, may be Inf
+     double   dlo = std::fabs((double)u2f(lo));
+     double   dhi = ((hi & 0x7F800000u) == 0x7F800000u) ? std::ldexp(1.0, 128)
+                                                       : std::fabs((double)u2f(hi));
+     double   x   = std::fabs((double)f);
+     if(x - dlo < dhi - x) return lo;
+     if(x - dlo > dhi - x) return hi;
+     return ((lo >> 16) & 1) ? hi : lo;
+ }
+
+ static uint32_t daz(uint32_t u, int mode, bool bf16)
+ {
+     uint32_t v = bf16 ? (u & 0xFFFF0000u) : u;
+     if(!(mode & MODE_SUBNORM) && f32_sub(v))
+         return v & 0x80000000u;
+     return v;
+ }
+
+ static inline double lane_val(uint32_t u, bool bf16) { return u2f(bf16 ? (u & 0xFFFF0000u) : u); }
+
+ // Exact result in double, rounded to FP32 to nearest or to BF16 per trunc.
+ // The BF16 narrowing reads a subnormal FP32 as zero without the subnorm flag.
+ static uint32_t round_lane(double r, int mode, bool bf16)
+ {
+     if(!bf16)
+         return f2u((float)r);
+     uint32_t f = f2u(to_fp32_odd(r));
+     if(!(mode & MODE_SUBNORM) && f32_sub(f))
+         return f & 0x80000000u;
+     return fp32_to_bf16_ref(u2f(f), mode & MODE_TRUNC);
+ }
+
+ // eq | lt << 1 | le << 2; NaN compares false, -0 == +0
+ static uint32_t cmp_ref(int op, uint32_t a, uint32_t b)
+ {
+     int64_t x, y;
+     if(op == OP_INT32_CMP) {
+         x = (int32_t)a;
+         y = (int32_t)b;
+     } else {
+         if(op == OP_BF16_CMP || op == OP_BF16_SELECT) { a &= 0xFFFF0000u; b &= 0xFFFF0000u; }
+         if(f32_nan(a) || f32_nan(b))
+             return 0;
+         x = ordered(a);
+         y = ordered(b);
+     }
+     return (uint32_t)(x == y) | (uint32_t)(x < y) << 1 | (uint32_t)(x <= y) << 2;
+ }
+
+ // Activations in double; the -inf limits of GELU and SiLU are -0
+ static double act_exact(ActFunc f, double x)
+ {
+     switch(f) {
+         case ACT_GELU: {
+             if(std::isinf(x)) return x > 0 ? x : -0.0;
+             double u = 0.7978845608028654 * (x + 0.044715 * x * x * x);
+             return x / (1.0 + std::exp(-2.0 * u));     // 0.5*x*(1 + tanh(u)), no cancellation
+         }
+         case ACT_SILU:
+             if(std::isinf(x)) return x > 0 ? x : -0.0;
+             return x / (1.0 + std::exp(-x));
+         case ACT_SIGMOID: return 1.0 / (1.0 + std::exp(-x));
+         case ACT_TANH:    return std::tanh(x);
+         default:          return x;
+     }
+ }
+
+ static uint32_t act_ref(int op, int mode, uint32_t a)
+ {
+     bool     bf16 = is_bf16_in(op);
+     uint32_t v    = bf16 ? (a & 0xFFFF0000u) : a;
+     if(act_func(op) == ACT_RELU)
+         return (f32_nan(v) || !(v >> 31)) ? v : 0;   // -0 and negatives => +0
+     if(f32_nan(v))
+         return 0x7FC00000u;
+     return round_lane(act_exact(act_func(op), u2f(v)), mode, bf16);
+ }
+
+ // max/min as fmaxf/fminf, with the lane rules made explicit: one NaN
+ // operand gives the other, two give B, equal values (-0 == +0) give A, and
+ // the winner's whole lane moves (BF16 low half included)
+ static uint32_t minmax_ref(int op, uint32_t a, uint32_t b)
+ {
+     bool max = op <= OP_INT32_MAX;
+     if(lane_type(op) == LANE_INT32) {
+         int32_t x = (int32_t)a, y = (int32_t)b;
+         return (max ? x >= y : x <= y) ? a : b;
+     }
+     bool  bf16 = lane_type(op) == LANE_BF16;
+     float fa = (float)lane_val(a, bf16), fb = (float)lane_val(b, bf16);
+     if(std::isnan(fa)) return b;
+     if(std::isnan(fb)) return a;
+     if(fa == fb)       return a;
+     float m = max ? std::fmax(fa, fb) : std::fmin(fa, fb);
+     return (m == fa) ? a : b;
+ }
+
+ // min/max, abs/neg, bitwise and shifts on the uint32 lane; shift count b[4:0]
+ static uint32_t raw_ref(int op, uint32_t a, uint32_t b)
+ {
+     unsigned sh = b & 31;
+     switch(op) {
+         case OP_FP32_ABS:  return a & 0x7FFFFFFFu;
+         case OP_FP32_NEG:  return a ^ 0x80000000u;
+         case OP_INT32_ABS: return (a >> 31) ? 0u - a : a;               // INT32_MIN stays
+         case OP_INT32_NEG: return 0u - a;
+         case OP_INT32_AND: return a & b;
+         case OP_INT32_OR:  return a | b;
+         case OP_INT32_XOR: return a ^ b;
+         case OP_INT32_SHL: return a << sh;
+         case OP_INT32_SHR: return a >> sh;
+         case OP_INT32_SRA: return (a >> sh) | ((a >> 31) ? ~(0xFFFFFFFFu >> sh) : 0u);
+         default:           return minmax_ref(op, a, b);
+     }
+ }
+
+ // FP32 to BF16 as fp32_round_to_bf16: NaN stays NaN and Inf stays Inf,
+ // a subnormal is zero without the subnorm flag, clamp catches overflow
+ static uint32_t narrow_ref(uint32_t a, int mode)
+ {
+     if(f32_spec(a))
+         return f32_nan(a) ? 0x7FC00000u : (a & 0xFFFF0000u);
+     if(!(mode & MODE_SUBNORM) && f32_sub(a))
+         return a & 0x80000000u;
+     uint32_t out = fp32_to_bf16_ref(u2f(a), mode & MODE_TRUNC);
+     if((mode & MODE_CLAMP) && (out & 0x7F800000u) == 0x7F800000u)
+         out = (out & 0x80000000u) | 0x7F7F0000u;
+     return out;
+ }
+
+ // LUT ops 5..11: one table per op and size, sampled at the segment starts
+ // i/n like the TCM tables of the testbenches
+ struct lut_tables {
+     lut_slot t[7][LUT_MAX_ENTRIES];
+
+     lut_tables() {
+         const double PI = 3.14159265358979323846;
+         for(int k=0; k<7; k++)
+             for(unsigned sz=0; sz<LUT_MAX_ENTRIES; sz++) {
+                 lut_slot& sl = t[k][sz];
+                 unsigned  n  = lut_cache::entries(sz);
+                 sl.valid = true;
+                 sl.size  = sz;
+                 for(unsigned i=0; i<n; i++) {
+                     double f = (double)i / n, v;
+                     switch(k + 5) {
+                         case 5:  v = 1.0 / (1.0 + f); break;
+                         case 6:  v = 1.0 / std::sqrt(1.0 + f); break;
+                         case 7:  v = 1.0 / std::sqrt(2.0 * (1.0 + f)); break;
+                         case 8:  v = std::log1p(f); break;
+                         case 9:  v = std::exp2(f); break;
+                         case 10: v = std::sin(2.0 * PI * f); break;
+                         default: v = std::cos(2.0 * PI * f); break;
+                     }
+                     sl.entries[i] = f2u((float)v);
+                 }
+             }
+     }
+ };
+
+ static const lut_slot& lut_table(unsigned op, unsigned size)
+ {
+     static const lut_tables tables;
+     return tables.t[op - 5][size & (LUT_MAX_ENTRIES - 1)];
+ }
+
+ // Table evaluation per lut_cache.hpp, table size from b[5:0]. x = m*2^e and
+ // the entry index floor(f*n) are exact here; the steps the op defines in
+ // FP32 (x*log2(e) and x/(2*pi), their fractions, e*ln2 + entry) round to FP32.
+ static uint32_t lut_ref(int op, int mode, uint32_t a, uint32_t b)
+ {
+     bool            bf16 = is_bf16_in(op);
+     unsigned        lop  = lut_op(op);
+     const lut_slot& t    = lut_table(lop, b);
+     unsigned        n    = lut_cache::entries(t.size);
+     double          x    = lane_val(a, bf16);
+     auto at = [&](double f) {
+         double i = std::floor(f * n);
+         i = i < 0 ? 0 : (i > n - 1 ? n - 1 : i);
+         return (double)u2f(t.entries[(int)i]);
+     };
+     int    e = 0;
+     double m = std::isfinite(x) ? std::frexp(std::fabs(x), &e) * 2.0 : 0.0;
+     e -= 1;
+     double r;
+     switch(lop) {
+         case 5:
+             if(std::isnan(x))      r = NAN;
+             else if(x == 0)        r = std::copysign(INFINITY, x);
+             else if(std::isinf(x)) r = std::copysign(0.0, x);
+             else                   r = std::copysign(std::ldexp(at(m - 1.0), -e), x);
+             break;
+         case 6:
+         case 7:
+             if(x < 0 || std::isnan(x)) r = NAN;
+             else if(x == 0)            r = INFINITY;
+             else if(std::isinf(x))     r = 0.0;
+             else                       r = std::ldexp(at(m - 1.0), -(((lop == 6) ? e : e - 1) >> 1));
+             break;
+         case 8:
+             if(x < 0 || std::isnan(x)) r = NAN;
+             else if(x == 0)            r = -INFINITY;
+             else if(std::isinf(x))     r = INFINITY;
+             else                       r = (double)u2f(f2u((float)((double)e * (double)0.69314718f))) + at(m - 1.0);
+             break;
+         case 9: {
+             if(std::isnan(x)) { r = NAN; break; }
+             double y = (float)(x * (double)1.44269504f);
+             if(y >  128.0) { r = INFINITY; break; }
+             if(y < -150.0) { r = 0.0; break; }
+             double k = std::floor(y);
+             r = std::ldexp(at((float)(y - k)), (int)k);
+             break;
+         }
+         default: {
+             if(!std::isfinite(x)) { r = NAN; break; }
+             double turns = (float)(x * (double)0.15915494f);
+             r = at((float)(turns - std::floor(turns)));
+             break;
+         }
+     }
+     uint32_t out = std::isnan(r) ? 0x7FC00000u : f2u((float)r);
+     return bf16 ? narrow_ref(out, mode) : out;
+ }
+
+ // Expected result, false if the case is skipped in this mode; c is the
+ // FMA addend and the BF16x2 dot accumulator
+ static bool reference(int op, int mode, uint32_t a, uint32_t b, uint32_t c, uint32_t& out)
+ {
+     bool trunc = mode & MODE_TRUNC;
+     bool clamp = mode & MODE_CLAMP;
+
+     if(is_cmp(op)) {
+         out = cmp_ref(op, a, b);
+         return true;
+     }
+     if(is_select(op)) {
+         out = (cmp_ref(op, a, b) & 2) ? a : b;        // whole lanes move
+         return true;
+     }
+     if(is_act(op)) {
+         out = act_ref(op, mode, a);
+         return true;
+     }
+     if(is_raw(op)) {
+         out = raw_ref(op, a, b);
+         return true;
+     }
+     if(is_lut(op)) {
+         out = lut_ref(op, mode, a, b);
+         return true;
+     }
+     if(op == OP_BF16X2_DOT) {
+         // element 0 in [15:0], element 1 in [31:16]; two FP32 products, two FP32 adds
+         uint32_t p0, p1, s0;
+         return reference(OP_FP32_MUL, mode, a << 16, b << 16, 0, p0) &&
+                reference(OP_FP32_MUL, mode, a & 0xFFFF0000u, b & 0xFFFF0000u, 0, p1) &&
+                reference(OP_FP32_ADD, mode, c, p0, 0, s0) &&
+                reference(OP_FP32_ADD, mode, s0, p1, 0, out);
+     }
+
+     if(op == OP_FP32_TO_BF16) {
+         out = narrow_ref(a, mode);
+         return true;
+     }
+     if(op == OP_FP32_TO_INT8) {
+         if(f32_nan(a)) { out = 0; return true; }
+         double t = std::trunc((double)u2f(a));
+         int    i = t > 127 ? 127 : (t < -128 ? -128 : (int)t);
+         out = (uint32_t)i;
+         return true;
+     }
+     if(op == OP_BF16_TO_FP32) {
+         out = a & 0xFFFF0000u;
+         return true;
+     }
+
+     bool bf16 = is_bf16_in(op);
+     bool fma  = is_fma(op);
+     uint32_t x = daz(a, mode, bf16), y = daz(b, mode, bf16), z = fma ? daz(c, mode, bf16) : 0;
+     if(!(mode & MODE_EXCEPT) && (f32_spec(x) || f32_spec(y) || f32_spec(z)))
+         return false;
+     if(op == OP_FP32_SUB || op == OP_BF16_SUB)
+         y ^= 0x80000000u;
+
+     // x*y is exact in double, so std::fma(x, y, z) is the sum of the
+     // product and z; sum_odd rounds that same sum to odd
+     double dx = u2f(x), dy = u2f(y), dz = u2f(z), r;
+     if(op == OP_FP32_MUL || op == OP_BF16_MUL) r = dx * dy;            // exact
+     else if(fma)                                r = sum_odd(dx * dy, dz);
+     else                                        r = sum_odd(dx, dy);
+
+     if(std::isnan(r)) { out = bf16 ? 0x7FC00000u : 0x7FC00000u; return true; }
+
+     bool finite_in = !f32_spec(x) && !f32_spec(y) && !f32_spec(z);
+     if(!(mode & MODE_SUBNORM) && r != 0 && std::fabs(r) < std::ldexp(1.0, -126)) {
+         out = std::signbit(r) ? 0x80000000u : 0;
+         return true;
+     }
+     out = bf16 ? fp32_to_bf16_ref(to_fp32_odd(r), trunc)
+                : f2u(to_fp32(r, trunc));
+     if(finite_in && clamp && (out & 0x7FFFFFFFu) == 0x7F800000u)
+         out = (out & 0x80000000u) | (bf16 ? 0x7F7F0000u : 0x7F7FFFFFu);
+     return true;
+ }
+
+ // Expected row of a macro-op (x, gamma, beta; ROW lanes each) and the
+ // floor its errors are measured against
+ static void macro_reference(int op, int mode, const uint32_t* x, const uint32_t* g,
+                             const uint32_t* bt, uint32_t* out, double& floor)
+ {
+     bool   bf16 = is_bf16_in(op);
+     int    kind = (op - OP_FP32_SOFTMAX) % 3;     // softmax, rmsnorm, layernorm
+     double y[ROW];
+
+     if(kind == 0) {
+         double m = -INFINITY, sum = 0;
+         for(int i=0; i<ROW; i++) m = std::max(m, lane_val(x[i], bf16));
+         if(std::isinf(m)) {
+             // one-hot over the +inf lanes; an all -inf row is all zeros
+             int n = 0;
+             for(int i=0; i<ROW; i++) n += (lane_val(x[i], bf16) == m);
+             for(int i=0; i<ROW; i++) y[i] = (m > 0 && lane_val(x[i], bf16) == m) ? 1.0 / n : 0.0;
+         } else {
+             for(int i=0; i<ROW; i++) sum += std::exp(lane_val(x[i], bf16) - m);
+             for(int i=0; i<ROW; i++) y[i] = std::exp(lane_val(x[i], bf16) - m) / sum;
+         }
+         floor = std::ldexp(1.0, -100);
+     } else {
+         double sum = 0, sq = 0, var = 0;
+         for(int i=0; i<ROW; i++) {
+             double v = lane_val(x[i], bf16);
+             sum += v;
+             sq  += v * v;
+         }
+         double mean = sum / ROW;
+         for(int i=0; i<ROW; i++) {
+             double d = lane_val(x[i], bf16) - mean;
+             var += d * d;
+         }
+         double shift = (kind == 1) ? 0.0 : mean;
+         double rstd  = 1.0 / std::sqrt(((kind == 1) ? sq : var) / ROW + (double)NORM_EPS);
+         floor = 0;
+         for(int i=0; i<ROW; i++) {
+             y[i] = (lane_val(x[i], bf16) - shift) * rstd * lane_val(g[i], bf16);
+             if(kind == 2) y[i] += lane_val(bt[i], bf16);
+             floor = std::max(floor, std::fabs(y[i]));
+         }
+     }
+     for(int i=0; i<ROW; i++)
+         out[i] = round_lane(y[i], mode, bf16);
+ }
+
+ //---------------------------------------------------------------------
+ // Kernel under test
+ //---------------------------------------------------------------------
+ static void set_mode(int mode)
+ {
+     setOpsContext(mode & MODE_SUBNORM, mode & MODE_TRUNC, mode & MODE_CLAMP, mode & MODE_EXCEPT);
+     setOpsStochastic(false, 0);
+ }
+
+ static uint32_t kernel(int op, uint32_t a, uint32_t b, uint32_t c)
+ {
+     if(is_cmp(op)) {
+         LaneType t = (op == OP_FP32_CMP) ? LANE_FP32 : (op == OP_BF16_CMP) ? LANE_BF16 : LANE_INT32;
+         return (uint32_t)lane_cmp_eq_1c(a, b, t) | (uint32_t)lane_cmp_lt_1c(a, b, t) << 1 |
+                (uint32_t)lane_cmp_le_1c(a, b, t) << 2;
+     }
+     if(is_act(op))
+         return (is_bf16_in(op) ? bf16_act_1c(a, act_func(op)) : fp32_act_1c(a, act_func(op))).to_uint();
+     if(is_lut(op))
+         return lut_eval_1c(lut_op(op), a, lut_table(lut_op(op), b), is_bf16_in(op)).to_uint();
+     switch(op) {
+         case OP_FP32_MAX:
+         case OP_BF16_MAX:
+         case OP_INT32_MAX:    return lane_max_1c(a, b, lane_type(op)).to_uint();
+         case OP_FP32_MIN:
+         case OP_BF16_MIN:
+         case OP_INT32_MIN:    return lane_min_1c(a, b, lane_type(op)).to_uint();
+         case OP_FP32_ABS:
+         case OP_INT32_ABS:    return lane_abs_1c(a, lane_type(op)).to_uint();
+         case OP_FP32_NEG:
+         case OP_INT32_NEG:    return lane_neg_1c(a, lane_type(op)).to_uint();
+         case OP_INT32_AND:    return int_and_1c(a, b).to_uint();
+         case OP_INT32_OR:     return int_or_1c(a, b).to_uint();
+         case OP_INT32_XOR:    return int_xor_1c(a, b).to_uint();
+         case OP_INT32_SHL:    return int_shl_1c(a, b & 31).to_uint();
+         case OP_INT32_SHR:    return int_shr_1c(a, b & 31).to_uint();
+         case OP_INT32_SRA:    return int_sra_1c(a, b & 31).to_uint();
+         case OP_FP32_FMA:     return fp32_fma_1c(a, b, c).to_uint();
+         case OP_BF16_FMA:     return bf16_fma_1c(a, b, c).to_uint();
+         case OP_BF16X2_DOT:   return bf16_dot2_fp32_1c(a << 16, a & 0xFFFF0000u,
+                                                        b << 16, b & 0xFFFF0000u, c).to_uint();
+         case OP_FP32_ADD:     return fp32_add_1c(a, b).to_uint();
+         case OP_FP32_SUB:     return fp32_sub_1c(a, b).to_uint();
+         case OP_FP32_MUL:     return fp32_mul_1c(a, b).to_uint();
+         case OP_BF16_ADD:     return bf16_add_1c(a, b).to_uint();
+         case OP_BF16_SUB:     return bf16_sub_1c(a, b).to_uint();
+         case OP_BF16_MUL:     return bf16_mul_1c(a, b).to_uint();
+         case OP_FP32_TO_BF16: return typecast_single_cycle(a, FP32, BF16).to_uint();
+         case OP_FP32_TO_INT8: return typecast_single_cycle(a, FP32, INT8).to_uint();
+         case OP_BF16_TO_FP32: return typecast_single_cycle(a, BF16, FP32).to_uint();
+         default:              return 0;
+     }
+ }
+
+ static const uint32_t (&line_in(const uint32_t* p))[MALU_LANES]
+ {
+     return *reinterpret_cast<const uint32_t (*)[MALU_LANES]>(p);
+ }
+
+ static uint32_t (&line_out(uint32_t* p))[MALU_LANES]
+ {
+     return *reinterpret_cast<uint32_t (*)[MALU_LANES]>(p);
+ }
+
+ // One line through the datapath: CMP_LT writes the lane mask, SELECT reads it
+ static void select_kernel(int op, malu_datapath& dp, const uint32_t* a, const uint32_t* b, uint32_t* out)
+ {
+     decoded_sfr_t cfg;
+     cfg.operation    = 15;
+     cfg.input_format = (op == OP_BF16_SELECT) ? 1 : 0;
+     sc_bv<2048> la, lb, mask, res;
+     pack_line(line_in(a), la);
+     pack_line(line_in(b), lb);
+     cfg.immediate_value = (uint32_t)EXT_CMP_LT << 8;
+     dp.execute_line(cfg, la, lb, mask);
+     cfg.immediate_value = (uint32_t)EXT_SELECT << 8;
+     dp.execute_line(cfg, la, lb, res);
+     unpack_line(res, line_out(out));
+ }
+
+ // One row through the streaming state, line by line as run_ext_op feeds it
+ static void macro_kernel(int op, const uint32_t* x, const uint32_t* g, const uint32_t* bt, uint32_t* out)
+ {
+     bool bf16 = is_bf16_in(op);
+     int  kind = (op - OP_FP32_SOFTMAX) % 3;
+     if(kind == 0) {
+         softmax_state st;
+         st.reset();
+         for(int l=0; l<ROW_LINES; l++) st.accumulate(line_in(x + l*MALU_LANES), bf16);
+         for(int l=0; l<ROW_LINES; l++) st.normalize(line_in(x + l*MALU_LANES), line_out(out + l*MALU_LANES), bf16);
+     } else {
+         norm_state st;
+         st.reset();
+         for(int l=0; l<ROW_LINES; l++) st.accumulate(line_in(x + l*MALU_LANES), bf16);
+         st.finalize(kind == 1, NORM_EPS);
+         for(int l=0; l<ROW_LINES; l++)
+             st.apply(line_in(x + l*MALU_LANES), line_in(g + l*MALU_LANES),
+                      (kind == 2) ? bt + l*MALU_LANES : nullptr, line_out(out + l*MALU_LANES), bf16);
+     }
+ }
+
+ //---------------------------------------------------------------------
+ // Error measure
+ //---------------------------------------------------------------------
+ static const int ULP_BINS = 8;
+ static const char* ulp_names[ULP_BINS] = { "0", "1", "2", "3-4", "5-16", "17-256", ">256", "nan" };
+
+ static int bin_of(double d)
+ {
+     return d == 0 ? 0 : d <= 1 ? 1 : d <= 2 ? 2 : d <= 4 ? 3 : d <= 16 ? 4 : d <= 256 ? 5 : 6;
+ }
+
+ static int ulp_bin(int op, uint32_t got, uint32_t exp)
+ {
+     if(is_cmp(op) || is_select(op) || is_raw(op))
+         return got == exp ? 0 : 6;
+     if(op == OP_FP32_TO_INT8) {
+         int64_t d = std::llabs((int64_t)(int32_t)got - (int64_t)(int32_t)exp);
+         return bin_of((double)d);
+     }
+     if(f32_nan(got) || f32_nan(exp))
+         return (f32_nan(got) && f32_nan(exp)) ? 0 : 7;
+     int64_t d = std::llabs(ordered(got) - ordered(exp));
+     if(is_bf16_in(op) || op == OP_FP32_TO_BF16)
+         d >>= 16;
+     if(op == OP_BF16_TO_FP32)
+         d = std::llabs(ordered(got) - ordered(exp));
+     return bin_of((double)d);
+ }
+
+ // Approximate ops: |got - exp| in ulps of the format at max(|exp|, floor)
+ static int approx_bin(int op, uint32_t got, uint32_t exp, double floor)
+ {
+     if(f32_nan(got) || f32_nan(exp))
+         return (f32_nan(got) && f32_nan(exp)) ? 0 : 7;
+     double g = u2f(got), e = u2f(exp);
+     if(g == e)
+         return 0;
+     if(std::isinf(g) || std::isinf(e))
+         return 6;
+     int mb = is_bf16_in(op) ? 7 : 23;
+     return bin_of(std::fabs(g - e) / std::ldexp(std::max(std::fabs(e), floor), -mb));
+ }
+
+ //---------------------------------------------------------------------
+ // Inputs
+ //---------------------------------------------------------------------
+ static inline uint64_t splitmix64(uint64_t& s)
+ {
+     uint64_t z = (s += 0x9E3779B97F4A7C15ull);
+     z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+     z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+     return z ^ (z >> 31);
+ }
+
+ static const uint32_t specials[] = {
+     0x00000000u, 0x80000000u, 0x7F800000u, 0xFF800000u, 0x7FC00000u, 0x7F800001u,
+     0x00000001u, 0x80000001u, 0x007FFFFFu, 0x807FFFFFu, 0x00800000u, 0x80800000u,
+     0x7F7FFFFFu, 0xFF7FFFFFu, 0x3F800000u, 0xBF800000u, 0x3F7FFFFFu, 0x33800000u,
+     0x00010000u, 0x7F7F0000u, 0x3F808000u, 0x4B000000u
+ };
+ static const int NUM_SPECIALS = sizeof(specials) / sizeof(specials[0]);
+
+ // Random FP32 word: mostly random bits, some specials and subnormals
+ static uint32_t random_word(uint64_t& s)
+ {
+     uint64_t r = splitmix64(s);
+     switch(r & 7) {
+         case 0:  return specials[(r >> 8) % NUM_SPECIALS] ^ (uint32_t)((r >> 40) & 0x80000000u);
+         case 1:  return (uint32_t)((r >> 8) & 0x807FFFFFu);                    // subnormal
+         default: return (uint32_t)(r >> 32);
+     }
+ }
+
+ // Pair: independent, or b close to a so subtraction cancels
+ static void random_pair(uint64_t& s, uint32_t& a, uint32_t& b)
+ {
+     a = random_word(s);
+     uint64_t r = splitmix64(s);
+     if((r & 3) == 0) b = a ^ (uint32_t)((r >> 8) & 0x800003FFu);
+     else             b = random_word(s);
+ }
+
+ // FMA addend / dot accumulator: random, or (1 in 4) close to -a*b so the
+ // sum cancels
+ static uint32_t random_addend(uint64_t& s, int op, uint32_t a, uint32_t b)
+ {
+     uint64_t r = splitmix64(s);
+     if((r & 3) != 0 || op == OP_BF16X2_DOT)
+         return random_word(s);
+     uint32_t m = (op == OP_BF16_FMA) ? 0xFFFF0000u : 0xFFFFFFFFu;
+     float    p = u2f(a & m) * u2f(b & m);
+     return (f2u(-p) & m) ^ (uint32_t)((r >> 8) & 0x3FFu) << (op == OP_BF16_FMA ? 16 : 0);
+ }
+
+ // Activation input: a random word, or (3 in 4) |x| in [2^-10, 128)
+ static uint32_t random_act(uint64_t& s)
+ {
+     uint64_t r = splitmix64(s);
+     if((r & 3) == 0) return random_word(s);
+     return (uint32_t)((r >> 8) & 0x807FFFFFu) | (uint32_t)(127 - 10 + (r >> 40) % 17) << 23;
+ }
+
+ // Row `row` of a macro-op sweep, from the seed alone so one row can be
+ // rerun: x = c + w*u, u in [-1,1), gamma in [-2,2), beta in [-1,1);
+ // softmax masks 1 in 64 lanes with -inf; 1 in 16 softmax rows is special:
+ // all -inf, a first line of -inf only, or one to three +inf lanes
+ static void macro_row(uint64_t seed, int mode, int op, uint64_t row,
+                       uint32_t* x, uint32_t* g, uint32_t* bt)
+ {
+     uint64_t s       = seed ^ ((uint64_t)mode << 56) ^ ((uint64_t)op << 48) ^ (row * 0x9E3779B97F4A7C15ull);
+     uint64_t r       = splitmix64(s);
+     bool     softmax = (op - OP_FP32_SOFTMAX) % 3 == 0;
+     uint32_t mask    = is_bf16_in(op) ? 0xFFFF0000u : 0xFFFFFFFFu;
+     double   c       = ((double)(r & 0xFFFF) / 32768.0 - 1.0) * (softmax ? 8.0 : 4.0);
+     double   w       = std::ldexp(1.0, (int)((r >> 16) % 6) - 2);
+     for(int i=0; i<ROW; i++) {
+         uint64_t q = splitmix64(s);
+         x[i]  = f2u((float)(c + w * ((double)(q & 0xFFFFFF) / 8388608.0 - 1.0))) & mask;
+         g[i]  = f2u((float)((double)((q >> 24) & 0xFFFF) / 16384.0 - 2.0)) & mask;
+         bt[i] = f2u((float)((double)((q >> 40) & 0xFFFF) / 32768.0 - 1.0)) & mask;
+         if(softmax && (q >> 58) == 0)
+             x[i] = 0xFF800000u;
+     }
+     int special = softmax ? (int)((r >> 24) & 15) : 15;
+     for(int i=0; i<ROW; i++)
+         if(special == 0 || (special == 1 && i < MALU_LANES))
+             x[i] = 0xFF800000u;
+     if(special == 2)
+         for(int k=0, n=1 + (int)((r >> 28) % 3); k<n; k++)
+             x[(r >> (32 + 8*k)) % ROW] = 0x7F800000u;
+ }
+
+ //---------------------------------------------------------------------
+ // Jobs and results
+ //---------------------------------------------------------------------
+ struct fuzz_result {
+     uint64_t checked = 0;
+     uint64_t skipped = 0;
+     uint64_t failed  = 0;
+     uint64_t bins[ULP_BINS] = {};
+     double   seconds = 0;              // kernel time, summed over threads
+     bool     have_fail = false;
+     uint64_t fail_idx  = 0;
+     uint32_t fail_a = 0, fail_b = 0, fail_c = 0, fail_got = 0, fail_exp = 0;
+
+     void merge(const fuzz_result& o) {
+         checked += o.checked; skipped += o.skipped; failed += o.failed;
+         for(int i=0; i<ULP_BINS; i++) bins[i] += o.bins[i];
+         seconds += o.seconds;
+         if(o.have_fail && (!have_fail || o.fail_idx < fail_idx)) {
+             have_fail = true; fail_idx = o.fail_idx;
+             fail_a = o.fail_a; fail_b = o.fail_b; fail_c = o.fail_c;
+             fail_got = o.fail_got; fail_exp = o.fail_exp;
+         }
+     }
+ };
+
+ // One chunk of one (mode, op) sweep
+ struct fuzz_job {
+     int      mode;
+     int      op;
+     bool     exhaustive;
+     uint64_t begin, end;       // case indices
+ };
+
+ static const uint64_t CHUNK = 1ull << 22;
+ static const int      BLOCK = 1024;      // cases per timed block: whole lines and rows
+
+ static void run_job(const fuzz_job& j, uint64_t seed, fuzz_result& res)
+ {
+     set_mode(j.mode);
+     uint64_t s = seed ^ ((uint64_t)j.mode << 56) ^ ((uint64_t)j.op << 48) ^ j.begin;
+     uint32_t av[BLOCK], bv[BLOCK], cv[BLOCK], got[BLOCK], expv[BLOCK];
+     double   floor[BLOCK];
+     malu_datapath dp;          // select: its lane mask carries CMP_LT to SELECT
+
+     for(uint64_t base = j.begin; base < j.end; base += BLOCK) {
+         int n = (int)std::min<uint64_t>(BLOCK, j.end - base);
+         for(int i=0; i<n; i++) {
+             uint64_t idx = base + i;
+             if(is_macro(j.op)) {
+                 if(i % ROW == 0) macro_row(seed, j.mode, j.op, idx / ROW, av + i, bv + i, cv + i);
+             } else if(j.exhaustive) {
+                 if(is_binary(j.op)) { av[i] = (uint32_t)(idx >> 16) << 16; bv[i] = (uint32_t)idx << 16; }
+                 else if(is_bf16_in(j.op)) { av[i] = (uint32_t)idx << 16; bv[i] = 0; }
+                 else { av[i] = (uint32_t)idx; bv[i] = 0; }
+             } else if(is_act(j.op) || is_lut(j.op)) {
+                 av[i] = random_act(s); bv[i] = 0;
+             } else {
+                 random_pair(s, av[i], bv[i]);
+             }
+             if(!is_macro(j.op)) {
+                 cv[i] = is_fma(j.op) ? random_addend(s, j.op, av[i], bv[i]) : 0;
+                 if(is_lut(j.op)) bv[i] = (uint32_t)splitmix64(s);    // table size
+             }
+         }
+
+         auto t0 = std::chrono::steady_clock::now();
+         if(is_macro(j.op))
+             for(int i=0; i<n; i+=ROW) macro_kernel(j.op, av + i, bv + i, cv + i, got + i);
+         else if(is_select(j.op))
+             for(int i=0; i<n; i+=MALU_LANES) select_kernel(j.op, dp, av + i, bv + i, got + i);
+         else
+             for(int i=0; i<n; i++) got[i] = kernel(j.op, av[i], bv[i], cv[i]);
+         res.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+         if(is_macro(j.op))
+             for(int i=0; i<n; i+=ROW) {
+                 macro_reference(j.op, j.mode, av + i, bv + i, cv + i, expv + i, floor[i]);
+                 for(int k=1; k<ROW; k++) floor[i + k] = floor[i];
+             }
+         for(int i=0; i<n; i++) {
+             uint32_t exp;
+             if(is_macro(j.op)) exp = expv[i];
+             else if(!reference(j.op, j.mode, av[i], bv[i], cv[i], exp)) { res.skipped++; continue; }
+             res.checked++;
+             int bin = is_macro(j.op) ? approx_bin(j.op, got[i], exp, floor[i])
+                     : is_act(j.op)   ? approx_bin(j.op, got[i], exp, std::ldexp(1.0, -100))
+                                      : ulp_bin(j.op, got[i], exp);
+             res.bins[bin]++;
+             if(bin > tolerance(j.op)) {
+                 res.failed++;
+                 if(!res.have_fail) {
+                     res.have_fail = true; res.fail_idx = base + i;
+                     res.fail_a = av[i]; res.fail_b = bv[i]; res.fail_c = cv[i];
+                     res.fail_got = got[i]; res.fail_exp = exp;
+                 }
+             }
+         }
+     }
+ }
+
+ static std::string mode_name(int mode)
+ {
+     std::ostringstream os;
+     os << "subnorm=" << !!(mode & MODE_SUBNORM) << " trunc=" << !!(mode & MODE_TRUNC)
+        << " clamp=" << !!(mode & MODE_CLAMP) << " except=" << !!(mode & MODE_EXCEPT);
+     return os.str();
+ }
+
+ static std::string hex(uint32_t v)
+ {
+     std::ostringstream os;
+     os << "0x" << std::hex << std::setw(8) << std::setfill('0') << v;
+     return os.str();
+ }
+
+ //---------------------------------------------------------------------
+ // Command line
+ //---------------------------------------------------------------------
+ static bool arg(int argc, char* argv[], const char* key, std::string& val)
+ {
+     size_t n = std::strlen(key);
+     for(int i=1; i<argc; i++)
+         if(std::strncmp(argv[i], key, n) == 0 && argv[i][n] == '=') {
+             val = argv[i] + n + 1;
+             return true;
+         }
+     return false;
+ }
+
+ // A macro-op row: its worst lane against the reference
+ static int repro_row(int op, int mode, uint64_t seed, uint64_t row)
+ {
+     uint32_t x[ROW], g[ROW], bt[ROW], got[ROW], exp[ROW];
+     double   floor;
+     set_mode(mode);
+     macro_row(seed, mode, op, row, x, g, bt);
+     macro_kernel(op, x, g, bt, got);
+     macro_reference(op, mode, x, g, bt, exp, floor);
+     int worst = 0;
+     for(int i=1; i<ROW; i++)
+         if(approx_bin(op, got[i], exp[i], floor) > approx_bin(op, got[worst], exp[worst], floor))
+             worst = i;
+     int bin = approx_bin(op, got[worst], exp[worst], floor);
+     std::cout << op_names[op] << " [" << mode_name(mode) << "] seed=" << seed << " row=" << row
+               << "\n  worst lane " << worst << ": x=" << hex(x[worst]) << " (" << u2f(x[worst]) << ")"
+               << "\n  kernel:    " << hex(got[worst]) << " (" << u2f(got[worst]) << ")"
+               << "\n  reference: " << hex(exp[worst]) << " (" << u2f(exp[worst]) << ")"
+               << "  ulp bin " << ulp_names[bin] << (bin > tolerance(op) ? "  MISMATCH" : "  OK")
+               << std::endl;
+     return bin > tolerance(op) ? 1 : 0;
+ }
+
+ static int repro(int argc, char* argv[])
+ {
+     std::string opn, v;
+     arg(argc, argv, "op", opn);
+     int op = -1;
+     for(int i=0; i<OP_NUM; i++) if(opn == op_names[i]) op = i;
+     if(op < 0) { std::cerr << "unknown op " << opn << std::endl; return 2; }
+     int      mode = arg(argc, argv, "mode", v) ? (int)std::strtoul(v.c_str(), nullptr, 0) : MODE_SUBNORM | MODE_EXCEPT;
+     uint32_t a    = arg(argc, argv, "a", v) ? (uint32_t)std::strtoul(v.c_str(), nullptr, 0) : 0;
+     uint32_t b    = arg(argc, argv, "b", v) ? (uint32_t)std::strtoul(v.c_str(), nullptr, 0) : 0;
+     uint32_t c    = arg(argc, argv, "c", v) ? (uint32_t)std::strtoul(v.c_str(), nullptr, 0) : 0;
+     if(is_macro(op)) {
+         uint64_t seed = arg(argc, argv, "seed", v) ? std::strtoull(v.c_str(), nullptr, 0) : 1;
+         uint64_t row  = arg(argc, argv, "row", v) ? std::strtoull(v.c_str(), nullptr, 0) : 0;
+         return repro_row(op, mode, seed, row);
+     }
+
+     set_mode(mode);
+     uint32_t got = kernel(op, a, b, c), exp = 0;
+     if(is_select(op)) {                       // a and b in every lane
+         uint32_t la[MALU_LANES], lb[MALU_LANES], out[MALU_LANES];
+         for(int i=0; i<MALU_LANES; i++) { la[i] = a; lb[i] = b; }
+         malu_datapath dp;
+         select_kernel(op, dp, la, lb, out);
+         got = out[0];
+     }
+     bool     chk = reference(op, mode, a, b, c, exp);
+     std::cout << op_names[op] << " [" << mode_name(mode) << "] a=" << hex(a) << " (" << u2f(a) << ")";
+     if(is_binary(op)) std::cout << " b=" << hex(b) << " (" << u2f(b) << ")";
+     if(is_lut(op))    std::cout << " b=" << hex(b) << " (" << lut_cache::entries(b & 63) << " entries)";
+     if(is_fma(op))    std::cout << " c=" << hex(c) << " (" << u2f(c) << ")";
+     std::cout << "\n  kernel:    " << hex(got) << " (" << u2f(got) << ")";
+     int bin = is_act(op) ? approx_bin(op, got, exp, std::ldexp(1.0, -100)) : ulp_bin(op, got, exp);
+     if(chk) std::cout << "\n  reference: " << hex(exp) << " (" << u2f(exp) << ")"
+                       << (bin <= tolerance(op) ? "  OK" : "  MISMATCH");
+     else    std::cout << "\n  reference: skipped in this mode";
+     std::cout << std::endl;
+     return (chk && bin > tolerance(op)) ? 1 : 0;
+ }
+
+ // Cases of a full sweep of the op, 0 if it is only fuzzed at random
+ static uint64_t sweep_cases(int op)
+ {
+     if(op == OP_BF16_TO_FP32 || ((is_act(op) || is_lut(op)) && is_bf16_in(op)))
+         return 1ull << 16;
+     if((op >= OP_BF16_ADD && op <= OP_BF16_MUL) || op == OP_BF16_CMP ||
+        op == OP_FP32_TO_BF16 || op == OP_FP32_TO_INT8)
+         return 1ull << 32;
+     return 0;
+ }
+
+ int sc_main(int argc, char* argv[])
+ {
+     std::string v;
+     if(arg(argc, argv, "op", v))
+         return repro(argc, argv);
+
+     unsigned threads    = std::thread::hardware_concurrency();
+     uint64_t fp32_pairs = 1ull << 24;
+     bool     exhaustive = true;
+     bool     all_modes  = false;
+     uint64_t seed       = 1;
+     if(arg(argc, argv, "threads", v))    threads    = (unsigned)std::strtoul(v.c_str(), nullptr, 0);
+     if(arg(argc, argv, "fp32", v))       fp32_pairs = std::strtoull(v.c_str(), nullptr, 0);
+     if(arg(argc, argv, "exhaustive", v)) exhaustive = (v != "0");
+     if(arg(argc, argv, "modes", v))      all_modes  = (v == "all");
+     if(arg(argc, argv, "seed", v))       seed       = std::strtoull(v.c_str(), nullptr, 0);
+     if(threads == 0) threads = 1;
+
+     std::vector<int> modes;
+     if(all_modes) for(int m=0; m<16; m++) modes.push_back(m);
+     else          modes.push_back(MODE_SUBNORM | MODE_EXCEPT);
+
+     std::vector<fuzz_job> jobs;
+     for(int mode : modes)
+         for(int op=0; op<OP_NUM; op++) {
+             uint64_t sweep = sweep_cases(op);
+             bool     ex    = sweep && (exhaustive || sweep <= (1ull << 16));
+             uint64_t cases = ex ? sweep : fp32_pairs;
+             if(is_select(op) || is_macro(op))
+                 cases = (cases + BLOCK - 1) / BLOCK * BLOCK;
+             for(uint64_t b=0; b<cases; b+=CHUNK)
+                 jobs.push_back({ mode, op, ex, b, std::min(cases, b + CHUNK) });
+         }
+
+     std::vector<fuzz_result> results(modes.size() * OP_NUM);
+     std::atomic<size_t> next(0);
+     std::mutex mtx;
+
+     auto t0 = std::chrono::steady_clock::now();
+     std::vector<std::thread> pool;
+     for(unsigned t=0; t<threads; t++)
+         pool.emplace_back([&]() {
+             size_t k;
+             while((k = next.fetch_add(1)) < jobs.size()) {
+                 const fuzz_job& j = jobs[k];
+                 fuzz_result r;
+                 run_job(j, seed, r);
+                 size_t mi = 0;
+                 while(modes[mi] != j.mode) mi++;
+                 std::lock_guard<std::mutex> lock(mtx);
+                 results[mi * OP_NUM + j.op].merge(r);
+             }
+         });
+     for(auto& th : pool) th.join();
+     double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+     uint64_t total = 0, failed = 0;
+     for(size_t mi=0; mi<modes.size(); mi++) {
+         std::cout << "[fuzz] mode " << hex(modes[mi]).substr(8) << " (" << mode_name(modes[mi]) << ")\n";
+         for(int op=0; op<OP_NUM; op++) {
+             const fuzz_result& r = results[mi * OP_NUM + op];
+             total  += r.checked + r.skipped;
+             failed += r.failed;
+             std::cout << "  " << std::left << std::setw(13) << op_names[op] << std::right
+                       << " checked=" << r.checked << " skipped=" << r.skipped
+                       << " failed=" << r.failed << " tol=" << ulp_names[tolerance(op)]
+                       << " kernels/s=" << std::fixed << std::setprecision(0)
+                       << (r.seconds > 0 ? (r.checked + r.skipped) / r.seconds : 0.0)
+                       << std::defaultfloat << "\n    ulp:";
+             for(int i=0; i<ULP_BINS; i++)
+                 std::cout << " " << ulp_names[i] << "=" << r.bins[i];
+             std::cout << "\n";
+             if(r.have_fail) {
+                 std::cout << "    first failure: got " << hex(r.fail_got) << " expected " << hex(r.fail_exp)
+                           << "\n    repro: fuzz_main op=" << op_names[op] << " mode=" << modes[mi];
+                 if(is_macro(op)) std::cout << " seed=" << seed << " row=" << r.fail_idx / ROW << "\n";
+                 else {
+                     std::cout << " a=" << hex(r.fail_a) << " b=" << hex(r.fail_b);
+                     if(is_fma(op)) std::cout << " c=" << hex(r.fail_c);
+                     std::cout << "\n";
+                 }
+             }
+         }
+     }
+     std::cout << "[fuzz] " << total << " cases on " << threads << " threads in "
+               << std::fixed << std::setprecision(2) << wall << " s => "
+               << std::setprecision(0) << total / wall << std::defaultfloat
+               << " cases/s, " << failed << " failures" << std::endl;
+     return failed ? 1 : 0;
+ }
@@ -0,0 +1,107 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: logic_ops.cpp
+ * Description: Implements the compare, min/max/abs/neg and integer bitwise lane ops.
+ *              FP compares work on the host float of the lane (BF16 widened by
+ *              zero-filling the low 16 bits), integer ops on the raw 32 bits.
+ **********/
+#include "logic_ops.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+static float lane_float(uint32_t bits, LaneType t)
+{
+    if(t == LANE_BF16) bits &= 0xFFFF0000u;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// ---------------------- COMPARE ----------------------
+bool lane_cmp_eq_1c(sc_uint<32> a, sc_uint<32> b, LaneType t)
+{
+    if(t == LANE_INT32)
+        return a.to_uint() == b.to_uint();
+    return lane_float(a.to_uint(), t) == lane_float(b.to_uint(), t);
+}
+
+bool lane_cmp_lt_1c(sc_uint<32> a, sc_uint<32> b, LaneType t)
+{
+    if(t == LANE_INT32)
+        return (int32_t)a.to_uint() < (int32_t)b.to_uint();
+    return lane_float(a.to_uint(), t) < lane_float(b.to_uint(), t);
+}
+
+bool lane_cmp_le_1c(sc_uint<32> a, sc_uint<32> b, LaneType t)
+{
+    if(t == LANE_INT32)
+        return (int32_t)a.to_uint() <= (int32_t)b.to_uint();
+    return lane_float(a.to_uint(), t) <= lane_float(b.to_uint(), t);
+}
+
+// ---------------------- MIN / MAX / ABS / NEG ----------------------
+sc_uint<32> lane_min_1c(sc_uint<32> a, sc_uint<32> b, LaneType t)
+{
+    if(t == LANE_INT32)
+        return ((int32_t)a.to_uint() <= (int32_t)b.to_uint()) ? a : b;
+
+    float fa = lane_float(a.to_uint(), t);
+    float fb = lane_float(b.to_uint(), t);
+    if(std::isnan(fa)) return b;
+    if(std::isnan(fb)) return a;
+    return (fa <= fb) ? a : b;
+}
+
+sc_uint<32> lane_max_1c(sc_uint<32> a, sc_uint<32> b, LaneType t)
+{
+    if(t == LANE_INT32)
+        return ((int32_t)a.to_uint() >= (int32_t)b.to_uint()) ? a : b;
+
+    float fa = lane_float(a.to_uint(), t);
+    float fb = lane_float(b.to_uint(), t);
+    if(std::isnan(fa)) return b;
+    if(std::isnan(fb)) return a;
+    return (fa >= fb) ? a : b;
+}
+
+sc_uint<32> lane_abs_1c(sc_uint<32> a, LaneType t)
+{
+    if(t == LANE_INT32) {
+        int32_t v = (int32_t)a.to_uint();
+        return (uint32_t)(v < 0 ? -(int64_t)v : v);   // INT32_MIN wraps to itself
+    }
+    sc_uint<32> out = a;
+    out[31] = 0;
+    return out;
+}
+
+sc_uint<32> lane_neg_1c(sc_uint<32> a, LaneType t)
+{
+    if(t == LANE_INT32)
+        return (uint32_t)(0u - a.to_uint());
+    sc_uint<32> out = a;
+    out[31] = !a[31];
+    return out;
+}
+
+// ---------------------- BITWISE ----------------------
+sc_uint<32> int_and_1c(sc_uint<32> a, sc_uint<32> b) { return a.to_uint() & b.to_uint(); }
+sc_uint<32> int_or_1c (sc_uint<32> a, sc_uint<32> b) { return a.to_uint() | b.to_uint(); }
+sc_uint<32> int_xor_1c(sc_uint<32> a, sc_uint<32> b) { return a.to_uint() ^ b.to_uint(); }
+
+sc_uint<32> int_shl_1c(sc_uint<32> a, unsigned sh)
+{
+    return a.to_uint() << (sh & 31);
+}
+
+sc_uint<32> int_shr_1c(sc_uint<32> a, unsigned sh)
+{
+    return a.to_uint() >> (sh & 31);
+}
+
+sc_uint<32> int_sra_1c(sc_uint<32> a, unsigned sh)
+{
+    return (uint32_t)((int32_t)a.to_uint() >> (sh & 31));
+}
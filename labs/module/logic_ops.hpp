@@ -0,0 +1,44 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: logic_ops.hpp
+ * Description: Declares the single-cycle compare, min/max/abs/neg and integer
+ *              bitwise/shift lane operations of the MALU extended op group.
+ *              Compares return one bit per lane; the pipeline packs them into
+ *              a 64-bit lane mask used by select and predicated instructions.
+ **********/
+#pragma once
+#include <systemc.h>
+
+/**
+ * How a 32-bit lane is interpreted: FP32, BF16 (upper 16 bits) or a
+ * signed 32-bit integer.
+ */
+enum LaneType { LANE_FP32, LANE_BF16, LANE_INT32 };
+
+/**
+ * Lane compares. IEEE rules for FP: NaN compares false, -0 == +0.
+ */
+bool lane_cmp_eq_1c(sc_uint<32> a, sc_uint<32> b, LaneType t);
+bool lane_cmp_lt_1c(sc_uint<32> a, sc_uint<32> b, LaneType t);
+bool lane_cmp_le_1c(sc_uint<32> a, sc_uint<32> b, LaneType t);
+
+/**
+ * min, max, abs and neg on the same lane types. min/max return the non-NaN
+ * operand if only one is NaN, and A if the two compare equal (-0 == +0);
+ * abs/neg only touch the sign bit for FP.
+ */
+sc_uint<32> lane_min_1c(sc_uint<32> a, sc_uint<32> b, LaneType t);
+sc_uint<32> lane_max_1c(sc_uint<32> a, sc_uint<32> b, LaneType t);
+sc_uint<32> lane_abs_1c(sc_uint<32> a, LaneType t);
+sc_uint<32> lane_neg_1c(sc_uint<32> a, LaneType t);
+
+/**
+ * Integer bitwise ops on the raw 32-bit lane; shift count 0..31.
+ */
+sc_uint<32> int_and_1c(sc_uint<32> a, sc_uint<32> b);
+sc_uint<32> int_or_1c (sc_uint<32> a, sc_uint<32> b);
+sc_uint<32> int_xor_1c(sc_uint<32> a, sc_uint<32> b);
+sc_uint<32> int_shl_1c(sc_uint<32> a, unsigned sh);
+sc_uint<32> int_shr_1c(sc_uint<32> a, unsigned sh);   // logical
+sc_uint<32> int_sra_1c(sc_uint<32> a, unsigned sh);   // arithmetic
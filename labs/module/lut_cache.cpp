@@ -0,0 +1,157 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: lut_cache.cpp
+ * Description: Implements the LUT residency cache (LRU over LUT_SLOTS tables)
+ *              and the table-driven ops 5..11.
+ **********/
+#include "lut_cache.hpp"
+#include "ops.hpp"
+#include <cmath>
+#include <cstring>
+
+// ---------------------- RESIDENCY ----------------------
+void lut_cache::reset()
+{
+    for(int s=0; s<LUT_SLOTS; s++)
+        slots[s] = lut_slot();
+    use_clock = 0;
+    st = lut_stats();
+}
+
+int lut_cache::find(uint32_t base, unsigned size)
+{
+    for(int s=0; s<LUT_SLOTS; s++) {
+        if(slots[s].valid && slots[s].base==base && slots[s].size==size) {
+            slots[s].last_use = ++use_clock;
+            st.hits++;
+            return s;
+        }
+    }
+    st.misses++;
+    return -1;
+}
+
+int lut_cache::allocate(uint32_t base, unsigned size)
+{
+    int victim = 0;
+    for(int s=0; s<LUT_SLOTS; s++) {
+        if(!slots[s].valid) { victim = s; break; }
+        if(slots[s].last_use < slots[victim].last_use) victim = s;
+    }
+    if(slots[victim].valid)
+        st.evictions++;
+
+    slots[victim].valid    = false;
+    slots[victim].base     = base;
+    slots[victim].size     = size;
+    slots[victim].last_use = ++use_clock;
+    return victim;
+}
+
+void lut_cache::fill(int slot, int beat, int line, const sc_bv<512>& data)
+{
+    lut_slot& ls = slots[slot];
+    unsigned  n  = entries(ls.size);
+    for(int e=0; e<LUT_ENTRIES_PER_LINE; e++) {
+        unsigned idx = beat*LUT_ENTRIES_PER_BEAT + line*LUT_ENTRIES_PER_LINE + e;
+        if(idx < n)
+            ls.entries[idx] = data.range(e*32+31, e*32).to_uint();
+    }
+    if(line == LUT_LINES_PER_BEAT-1)
+        st.beats++;
+}
+
+void lut_cache::commit(int slot)
+{
+    slots[slot].valid = true;
+}
+
+// ---------------------- TABLE-DRIVEN OPS ----------------------
+static float bits_to_float(uint32_t u)
+{
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static uint32_t float_to_bits(float f)
+{
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+// floor(frac*n); the product is exact in double (24 x 7 bits), an FP32
+// product can round up onto the next entry when n is not a power of two
+static float lut_at(const lut_slot& t, float frac)
+{
+    unsigned n   = lut_cache::entries(t.size);
+    int      idx = (int)((double)frac * n);
+    if(idx < 0)       idx = 0;
+    if(idx >= (int)n) idx = n-1;
+    return bits_to_float(t.entries[idx]);
+}
+
+sc_uint<32> lut_eval_1c(unsigned op, sc_uint<32> x, const lut_slot& table, bool bf16)
+{
+    uint32_t xb = x.to_uint();
+    if(bf16) xb &= 0xFFFF0000u;
+    float xf = bits_to_float(xb);
+    float r;
+
+    // x = m * 2^e with m in [1,2): f = m-1
+    int   e;
+    float m = std::frexp(std::fabs(xf), &e) * 2.0f;
+    e -= 1;
+
+    switch(op) {
+        case 5: // reciprocal
+            if(std::isnan(xf))       r = NAN;
+            else if(xf == 0.0f)      r = std::copysign(INFINITY, xf);
+            else if(std::isinf(xf))  r = std::copysign(0.0f, xf);
+            else                     r = std::copysign(std::ldexp(lut_at(table, m-1.0f), -e), xf);
+            break;
+        case 6: // inv sqrt, even exponent
+        case 7: // inv sqrt, odd exponent
+            if(xf < 0.0f || std::isnan(xf)) r = NAN;
+            else if(xf == 0.0f)             r = INFINITY;
+            else if(std::isinf(xf))         r = 0.0f;
+            else {
+                int k = (op==6) ? e : e-1;   // even by construction of the op
+                r = std::ldexp(lut_at(table, m-1.0f), -(k >> 1));
+            }
+            break;
+        case 8: // log
+            if(xf < 0.0f || std::isnan(xf)) r = NAN;
+            else if(xf == 0.0f)             r = -INFINITY;
+            else if(std::isinf(xf))         r = INFINITY;
+            else                            r = (float)e * 0.69314718f + lut_at(table, m-1.0f);
+            break;
+        case 9: // exp
+        {
+            if(std::isnan(xf)) { r = NAN; break; }
+            float y = xf * 1.44269504f;
+            if(y >  128.0f) { r = INFINITY; break; }
+            if(y < -150.0f) { r = 0.0f; break; }
+            float k = std::floor(y);
+            r = std::ldexp(lut_at(table, y-k), (int)k);
+        }
+            break;
+        case 10: // sin
+        case 11: // cos
+        {
+            if(std::isnan(xf) || std::isinf(xf)) { r = NAN; break; }
+            float turns = xf * 0.15915494f;
+            r = lut_at(table, turns - std::floor(turns));
+        }
+            break;
+        default:
+            r = 0.0f;
+            break;
+    }
+
+    uint32_t out = float_to_bits(r);
+    if(bf16) return fp32_round_to_bf16(out);
+    return out;
+}
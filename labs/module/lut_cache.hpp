@@ -0,0 +1,74 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: lut_cache.hpp
+ * Description: Declares the MALU LUT residency cache and the table-driven
+ *              single-cycle ops (reciprocal, inverse sqrt, log, exp, sin, cos).
+ *              Several tables stay resident, keyed by (lut_base_addr, lut_size);
+ *              a repeated request is a hit and costs no TCM traffic, a miss
+ *              evicts the least recently used table.
+ **********/
+#pragma once
+#include <systemc.h>
+#include <cstdint>
+
+static const int LUT_MAX_ENTRIES      = 64;  // lut_size is 6 bits, 0 => 64
+static const int LUT_SLOTS            = 4;   // tables resident at once
+static const int LUT_LINES_PER_BEAT   = 4;   // i_tcm2malu[0..3]
+static const int LUT_ENTRIES_PER_LINE = 16;  // FP32 entries in a 512-bit line
+static const int LUT_ENTRIES_PER_BEAT = LUT_LINES_PER_BEAT * LUT_ENTRIES_PER_LINE;
+
+struct lut_slot {
+    bool     valid    = false;
+    uint32_t base     = 0;
+    unsigned size     = 0;
+    uint64_t last_use = 0;
+    uint32_t entries[LUT_MAX_ENTRIES] = {};
+};
+
+struct lut_stats {
+    uint64_t hits      = 0;
+    uint64_t misses    = 0;
+    uint64_t evictions = 0;
+    uint64_t beats     = 0;   // TCM beats actually transferred
+};
+
+class lut_cache {
+public:
+    void reset();
+
+    // Slot holding (base, size), refreshed as most recently used; -1 on miss
+    int  find(uint32_t base, unsigned size);
+    // Slot for a new table: a free one, else the LRU one (counted as eviction).
+    // The slot stays invalid until commit().
+    int  allocate(uint32_t base, unsigned size);
+    // Store one 512-bit line of beat `beat`, line `line` (0..3)
+    void fill(int slot, int beat, int line, const sc_bv<512>& data);
+    void commit(int slot);
+
+    const lut_slot&  get(int slot) const { return slots[slot]; }
+    const lut_stats& stats() const { return st; }
+
+    static unsigned entries(unsigned lut_size) { return lut_size ? lut_size : LUT_MAX_ENTRIES; }
+    static unsigned beats(unsigned n) { return (n + LUT_ENTRIES_PER_BEAT - 1) / LUT_ENTRIES_PER_BEAT; }
+
+private:
+    lut_slot  slots[LUT_SLOTS];
+    uint64_t  use_clock = 0;
+    lut_stats st;
+};
+
+/**
+ * Table-driven op on one lane, MALU operation 5..11. The table holds n FP32
+ * samples over one reduced interval, looked up nearest-entry:
+ *   5  reciprocal       1/(1+f)            x = (1+f)*2^e
+ *   6  inv sqrt even    1/sqrt(1+f)        e even
+ *   7  inv sqrt odd     1/sqrt(2*(1+f))    e odd
+ *   8  log              ln(1+f)            + e*ln2
+ *   9  exp              2^f                x*log2(e) = k+f, * 2^k
+ *   10 sin              sin(2*pi*f)        f = frac(x / 2*pi)
+ *   11 cos              cos(2*pi*f)
+ * f is in [0,1) and indexes entry floor(f*n). BF16 lanes are widened and
+ * the result narrowed with fp32_round_to_bf16().
+ */
+sc_uint<32> lut_eval_1c(unsigned op, sc_uint<32> x, const lut_slot& table, bool bf16);
@@ -0,0 +1,157 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: macro_ops.cpp
+ * Description: Implements the row macro-op kernels on one 64-lane line at a time.
+ *              Lanes are FP32, or BF16 in the upper 16 bits of the lane; math is
+ *              done in FP32 with the LUT kernels from act_ops, BF16 outputs are
+ *              narrowed with fp32_round_to_bf16().
+ **********/
+#include "macro_ops.hpp"
+#include "act_ops.hpp"
+#include "ops.hpp"
+#include <cmath>
+#include <cstring>
+
+static float lane_to_float(uint32_t bits, bool bf16)
+{
+    if(bf16) bits &= 0xFFFF0000u;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static uint32_t float_to_lane(float f, bool bf16)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    if(bf16) return fp32_round_to_bf16(bits).to_uint();
+    return bits;
+}
+
+// ---------------------- SOFTMAX ----------------------
+void softmax_state::reset()
+{
+    max       = -INFINITY;
+    sum       = 0.0f;
+    inf_count = 0.0f;
+}
+
+void softmax_state::accumulate(const uint32_t (&in)[MALU_LANES], bool bf16)
+{
+    float x[MALU_LANES];
+    float line_max = -INFINITY;
+    for(int lane=0; lane<MALU_LANES; lane++) {
+        x[lane]  = lane_to_float(in[lane], bf16);
+        line_max = std::fmax(line_max, x[lane]);
+    }
+    if(line_max == -INFINITY)
+        return;    // all lanes masked with -inf, nothing to add
+
+    // +inf swamps every finite lane: only the +inf lanes are counted,
+    // exp(inf - inf) would turn the whole row into NaN
+    if(line_max == INFINITY) {
+        for(int lane=0; lane<MALU_LANES; lane++)
+            if(x[lane] == INFINITY)
+                inf_count += 1.0f;
+        max = INFINITY;
+        return;
+    }
+    if(max == INFINITY)
+        return;
+
+    float new_max = std::fmax(max, line_max);
+    float line_sum = 0.0f;
+    for(int lane=0; lane<MALU_LANES; lane++)
+        line_sum += lut_exp_f32(x[lane] - new_max);
+
+    // rescale what was summed against the old max
+    if(sum != 0.0f)
+        sum *= lut_exp_f32(max - new_max);
+    sum += line_sum;
+    max  = new_max;
+}
+
+void softmax_state::normalize(const uint32_t (&in)[MALU_LANES],
+                              uint32_t (&out)[MALU_LANES], bool bf16) const
+{
+    float inv_sum = lut_rcp_f32(sum);
+    float inv_inf = 1.0f / inf_count;        // exact 1 for a single +inf lane
+    for(int lane=0; lane<MALU_LANES; lane++) {
+        float x = lane_to_float(in[lane], bf16);
+        float y;
+        if(max == INFINITY)
+            y = (x == INFINITY) ? inv_inf : 0.0f;   // one-hot, split over the +inf lanes
+        else if(max == -INFINITY)
+            y = 0.0f;                               // row fully masked with -inf
+        else
+            y = lut_exp_f32(x - max) * inv_sum;
+        setOpsLane(lane);
+        out[lane] = float_to_lane(y, bf16);
+    }
+    advanceOpsStep();
+}
+
+// ---------------------- LAYERNORM / RMSNORM ----------------------
+void norm_state::reset()
+{
+    count   = 0.0f;
+    mean    = 0.0f;
+    m2      = 0.0f;
+    mean_sq = 0.0f;
+    shift   = 0.0f;
+    rstd    = 1.0f;
+}
+
+void norm_state::accumulate(const uint32_t (&in)[MALU_LANES], bool bf16)
+{
+    float x[MALU_LANES];
+    float line_sum = 0.0f, line_sq = 0.0f;
+    for(int lane=0; lane<MALU_LANES; lane++) {
+        x[lane]   = lane_to_float(in[lane], bf16);
+        line_sum += x[lane];
+        line_sq  += x[lane] * x[lane];
+    }
+    float n_b    = (float)MALU_LANES;
+    float mean_b = line_sum / n_b;
+    float m2_b   = 0.0f;
+    for(int lane=0; lane<MALU_LANES; lane++) {
+        float d = x[lane] - mean_b;
+        m2_b += d * d;
+    }
+
+    // merge (count, mean, m2) with the line's (n_b, mean_b, m2_b)
+    float n     = count + n_b;
+    float delta = mean_b - mean;
+    mean    += delta * (n_b / n);
+    m2      += m2_b + delta * delta * (count * n_b / n);
+    mean_sq += (line_sq / n_b - mean_sq) * (n_b / n);
+    count    = n;
+}
+
+void norm_state::finalize(bool rms, float eps)
+{
+    if(rms) {
+        shift = 0.0f;
+        rstd  = lut_rsqrt_f32(mean_sq + eps);
+    } else {
+        shift = mean;
+        rstd  = lut_rsqrt_f32(m2 / count + eps);
+    }
+}
+
+void norm_state::apply(const uint32_t (&in)[MALU_LANES],
+                       const uint32_t (&gamma)[MALU_LANES],
+                       const uint32_t* beta,
+                       uint32_t (&out)[MALU_LANES], bool bf16) const
+{
+    for(int lane=0; lane<MALU_LANES; lane++) {
+        float y = (lane_to_float(in[lane], bf16) - shift) * rstd
+                * lane_to_float(gamma[lane], bf16);
+        if(beta)
+            y += lane_to_float(beta[lane], bf16);
+        setOpsLane(lane);
+        out[lane] = float_to_lane(y, bf16);
+    }
+    advanceOpsStep();
+}
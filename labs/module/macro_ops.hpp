@@ -0,0 +1,54 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: macro_ops.hpp
+ * Description: Declares the streaming state of the MALU row macro-ops (softmax,
+ *              RMSNorm, LayerNorm). A row spans several MRF lines (64 lanes each);
+ *              the pipeline feeds it line by line, so the state never holds more
+ *              than one line.
+ **********/
+#pragma once
+#include <cstdint>
+
+static const int MALU_LANES = 64;
+
+/**
+ * Online softmax: pass 1 keeps the running max m and the running
+ * sum s = sum(exp(x - m)), rescaling s whenever m grows.
+ * Pass 2 re-reads the row and writes exp(x - m) * (1/s).
+ * A row with +inf lanes is one-hot over them (1/count each); a row that
+ * is all -inf comes out as zeros instead of NaN.
+ */
+struct softmax_state {
+    float max;
+    float sum;
+    float inf_count;   // lanes equal to +inf
+
+    void reset();
+    void accumulate(const uint32_t (&in)[MALU_LANES], bool bf16);
+    void normalize(const uint32_t (&in)[MALU_LANES],
+                   uint32_t (&out)[MALU_LANES], bool bf16) const;
+};
+
+/**
+ * Streaming normalization statistics. Each line is reduced to
+ * (count, mean, M2) and merged into the running Welford accumulator
+ * (Chan's pairwise update), so pass 1 needs one line of storage.
+ * RMSNorm only uses the running mean of x^2.
+ */
+struct norm_state {
+    float count;
+    float mean;
+    float m2;
+    float mean_sq;
+    float shift;   // mean subtracted in pass 2 (0 for RMSNorm)
+    float rstd;    // 1/sqrt(var + eps) or 1/sqrt(mean(x^2) + eps)
+
+    void reset();
+    void accumulate(const uint32_t (&in)[MALU_LANES], bool bf16);
+    void finalize(bool rms, float eps);
+    void apply(const uint32_t (&in)[MALU_LANES],
+               const uint32_t (&gamma)[MALU_LANES],
+               const uint32_t* beta,                 // nullptr => no shift
+               uint32_t (&out)[MALU_LANES], bool bf16) const;
+};
@@ -2,8 +2,8 @@
  * Author: Abcd at abcd
  * Project: Project name
  * File: main.cpp
- * Description: SystemC testbench for the MALU design. This testbench runs three separate test 
- *              cases (FP32 ADD, FP32 SUB, FP32 MUL) by setting SFR configurations, sending instructions,
+ * Description: SystemC testbench for the MALU design. This testbench runs separate test 
+ *              cases (FP32 ADD, SUB, MUL, ReLU, sigmoid, compare, min, max, FMA, LUT reciprocal, softmax specials) by setting SFR configurations, sending instructions,
  *              supplying MRF input data (64 lanes per line), and printing the outputs in hex and float.
  **********/
 
@@ -14,6 +14,8 @@
  #include "malu2npuc.hpp"
  #include "mrf2malu.hpp"
  #include "malu2mrf.hpp"
+ #include "tcm2malu.hpp"
+ #include "malu2tcm.hpp"
  #include "common_register.hpp"      // Defines _COMMON_REGISTERS and sfr_PTR
  #include "common_register_addr.hpp" // Defines register addresses
  
@@ -27,12 +29,19 @@
  /// - opCode: the operation code (0 = add, 1 = sub, 2 = mul)
  /// - a, b: the 32-bit FP32 input values (in hex) for each lane (all lanes are set identically)
  /// - expected: the expected 32-bit result (in hex) for debugging
+ /// - imm: immediate_value (activation select, FMA scalar)
+ /// - load_lut: request the 64-entry LUT at TCM address 0 before the op
+ /// - expect_lanes: lanes 0..expect_lanes-1 must hold expected, the others
+ ///   zero (compares pack their 64-bit mask into lanes 0-1)
  void runTest(sc_uint<4> opCode, sc_uint<32> a, sc_uint<32> b, sc_uint<32> expected,
               const std::string& testName,
               sc_fifo<sfr_PTR>& sfr_fifo,
               sc_fifo<npuc2malu_PTR>& npuc2malu_fifo,
               sc_vector< sc_fifo<mrf2malu_PTR> >& mrf2malu_fifo,
-              sc_fifo<malu2mrf_PTR>& malu2mrf_fifo)
+              sc_fifo<malu2mrf_PTR>& malu2mrf_fifo,
+              sc_uint<32> imm = 0,
+              bool load_lut = false,
+              int expect_lanes = 64)
  {
      std::cout << "\n===== Running Test: " << testName << " =====\n";
  
@@ -52,6 +61,10 @@
          sfr_ptr->reg_parsed_mode_math.fused_operation      = 0;
          sfr_ptr->reg_parsed_mode_math.rounding             = 0;
          sfr_ptr->reg_parsed_mode_math.saturation           = 0;
+         sfr_ptr->reg_parsed_option_math_immediate.immediate_value = imm;
+         sfr_ptr->reg_parsed_option_math_lut.load_lut_enable = load_lut;
+         sfr_ptr->reg_parsed_option_math_lut.lut_size        = 0;
+         sfr_ptr->reg_parsed_option_math_lut.lut_base_addr   = 0;
          // Also set some default load/store options
          sfr_ptr->reg_parsed_option_math_load_store.load_input_0 = 1;
          sfr_ptr->reg_parsed_option_math_load_store.load_input_1 = 1;
@@ -64,7 +77,7 @@
      // 2. Push an npuc2malu instruction (start = 1)
      // -------------------------------------------------------------
      {
-         auto inst_ptr = std::make_shared<npuc2malu>();
+         auto inst_ptr = make_payload<npuc2malu_PTR>();
          inst_ptr->start = 1;
          npuc2malu_fifo.write(inst_ptr);
      }
@@ -74,8 +87,8 @@
      // Create two 2048-bit lines representing 64 lanes.
      // For each lane, fill with the same a and b values.
      // -------------------------------------------------------------
-     auto mrfA = std::make_shared<mrf2malu>();
-     auto mrfB = std::make_shared<mrf2malu>();
+     auto mrfA = make_payload<mrf2malu_PTR>();
+     auto mrfB = make_payload<mrf2malu_PTR>();
      sc_bv<2048> lineA = 0, lineB = 0;
  
      // For every lane (0 to 63), set all 32 bits with input value a and b.
@@ -122,7 +135,8 @@
              std::cout << "Lane " << std::setw(2) << lane << " : 0x"
                        << std::hex << std::setw(8) << resWord.to_uint() << std::dec
                        << " => " << conv.f << "f";
-             if(resWord == expected)
+             sc_uint<32> want = (lane < expect_lanes) ? expected : sc_uint<32>(0);
+             if(resWord == want)
                  std::cout << "  [PASS]";
              else
                  std::cout << "  [FAIL]";
@@ -137,6 +151,58 @@
      sc_start(50, SC_NS);
  }
  
+ /// runSoftmaxRow() runs a one-line FP32 softmax (op 15, ext op 0, row_lines 1)
+ /// on the lanes x: the line goes twice on port 0, once per pass, and every
+ /// output lane must match expected bit for bit
+ void runSoftmaxRow(const uint32_t (&x)[64], const uint32_t (&expected)[64],
+                    const std::string& testName,
+                    sc_fifo<sfr_PTR>& sfr_fifo,
+                    sc_fifo<npuc2malu_PTR>& npuc2malu_fifo,
+                    sc_vector< sc_fifo<mrf2malu_PTR> >& mrf2malu_fifo,
+                    sc_fifo<malu2mrf_PTR>& malu2mrf_fifo)
+ {
+     std::cout << "\n===== Running Test: " << testName << " =====\n";
+
+     auto sfr_ptr = std::make_shared<_COMMON_REGISTERS>();
+     sfr_ptr->reg_parsed_mode_math.operation            = 15;
+     sfr_ptr->reg_parsed_mode_math.input_number_format  = 0;
+     sfr_ptr->reg_parsed_mode_math.output_number_format = 0;
+     sfr_ptr->reg_parsed_option_math_immediate.immediate_value = 0;
+     sfr_ptr->reg_parsed_option_math_load_store.load_input_0 = 1;
+     sfr_ptr->reg_parsed_option_math_load_store.store_output = 1;
+     sfr_fifo.write(sfr_ptr);
+
+     auto inst_ptr = make_payload<npuc2malu_PTR>();
+     inst_ptr->start = 1;
+     npuc2malu_fifo.write(inst_ptr);
+
+     for (int pass = 0; pass < 2; ++pass) {
+         auto mrf = make_payload<mrf2malu_PTR>();
+         for (int lane = 0; lane < 64; ++lane)
+             mrf->data.range(lane*32+31, lane*32) = x[lane];
+         mrf->done = 1;
+         mrf2malu_fifo[0].write(mrf);
+     }
+
+     sc_start(100, SC_NS);
+
+     if (malu2mrf_fifo.num_available() > 0) {
+         sc_bv<2048> resLine = malu2mrf_fifo.read()->data;
+         std::cout << "Test " << testName << " Results:\n";
+         for (int lane = 0; lane < 64; ++lane) {
+             uint32_t resWord = resLine.range(lane*32+31, lane*32).to_uint();
+             std::cout << "Lane " << std::setw(2) << lane << " : 0x"
+                       << std::hex << std::setw(8) << resWord << std::dec
+                       << ((resWord == expected[lane]) ? "  [PASS]" : "  [FAIL]") << std::endl;
+         }
+     }
+     else {
+         std::cout << "No result available for test " << testName << "!\n";
+     }
+
+     sc_start(50, SC_NS);
+ }
+ 
  int sc_main(int argc, char* argv[])
  {
      // -------------------------------------------------------------
@@ -147,10 +213,12 @@
  
      // FIFOs for communication
      sc_fifo<npuc2malu_PTR>  fifo_npuc2malu("fifo_npuc2malu", 8);
-     sc_fifo<malu2npuc_PTR>  fifo_malu2npuc("fifo_malu2npuc", 8);
+     sc_fifo<malu2npuc_PTR>  fifo_malu2npuc("fifo_malu2npuc", 16);   // one done per test, not read
      sc_vector<sc_fifo<mrf2malu_PTR>> fifo_mrf2malu("fifo_mrf2malu", 2);
      sc_fifo<malu2mrf_PTR>   fifo_malu2mrf("fifo_malu2mrf", 8);
      sc_fifo<sfr_PTR>        fifo_sfr("fifo_sfr", 8);
+     sc_fifo<malu2tcm_PTR>   fifo_malu2tcm("fifo_malu2tcm", 8);
+     sc_vector<sc_fifo<tcm2malu_PTR>> fifo_tcm2malu("fifo_tcm2malu", LUT_LINES_PER_BEAT);
  
      // -------------------------------------------------------------
      // 2. Instantiate the MALU device.
@@ -164,6 +232,9 @@
          dut.i_mrf2malu[i](fifo_mrf2malu[i]);
      dut.o_malu2mrf(fifo_malu2mrf);
      dut.i_reg_map(fifo_sfr);
+     dut.o_malu2tcm(fifo_malu2tcm);
+     for (int j = 0; j < LUT_LINES_PER_BEAT; ++j)
+         dut.i_tcm2malu[j](fifo_tcm2malu[j]);
  
      // -------------------------------------------------------------
      // 3. Reset Sequence.
@@ -187,9 +258,66 @@
      // Test 3: FP32 MUL (2.0f * 3.0f = 6.0f)
      //    a = 0x40000000, b = 0x40400000, expected = 0x40C00000 
      runTest(2, 0x40000000, 0x40400000, 0x40C00000, "FP32 MUL", fifo_sfr, fifo_npuc2malu, fifo_mrf2malu, fifo_malu2mrf);
+
+     // Test 4: FP32 ReLU (op 13, immediate[2:0] = 1): relu(-1.0f) = 0.0f
+     runTest(13, 0xBF800000, 0x00000000, 0x00000000, "FP32 RELU", fifo_sfr, fifo_npuc2malu, fifo_mrf2malu, fifo_malu2mrf, 1);
+ 
+     // Test 5: FP32 SIGMOID (op 13, immediate[2:0] = 4): sigmoid(0.0f) = 0.5f
+     runTest(13, 0x00000000, 0x00000000, 0x3F000000, "FP32 SIGMOID", fifo_sfr, fifo_npuc2malu, fifo_mrf2malu, fifo_malu2mrf, 4);
+
+     // Test 6: FP32 CMP_LT (op 15, immediate[14:8] = 4): -1.0f < 1.0f in every lane,
+     //    the packed mask in lanes 0-1 is all ones, the other lanes are zero
+     runTest(15, 0xBF800000, 0x3F800000, 0xFFFFFFFF, "FP32 CMP_LT", fifo_sfr, fifo_npuc2malu, fifo_mrf2malu, fifo_malu2mrf, 4 << 8, false, 2);
+
+     // Test 7: FP32 MIN (op 15, immediate[14:8] = 7): min(-1.0f, 1.0f) = -1.0f
+     runTest(15, 0xBF800000, 0x3F800000, 0xBF800000, "FP32 MIN", fifo_sfr, fifo_npuc2malu, fifo_mrf2malu, fifo_malu2mrf, 7 << 8);
+
+     // Test 8: FP32 MAX (op 3) on negatives: max(-1.0f, -2.0f) = -1.0f,
+     //    although -2.0f has the larger raw bits
+     runTest(3, 0xBF800000, 0xC0000000, 0xBF800000, "FP32 MAX", fifo_sfr, fifo_npuc2malu, fifo_mrf2malu, fifo_malu2mrf);
+
+     // Test 9: FP32 FMA (op 14, scalar -1.0f in immediate[31:16]), rounded once:
+     //    (1+2^-12)^2 - 1 = 2^-11 + 2^-24; rounding the product first would give 2^-11
+     runTest(14, 0x3F800800, 0x3F800800, 0x3A000400, "FP32 FMA", fifo_sfr, fifo_npuc2malu, fifo_mrf2malu, fifo_malu2mrf, 0xBF800000);
+
+     // Test 10: FP32 RECIPROCAL from a TCM LUT (op 5): the TCM beat holding
+     //    1/(1+i/64) is queued up front, 1/4.0f = 0.25f hits entry 0
+     for (int l = 0; l < LUT_LINES_PER_BEAT; ++l) {
+         auto beat = make_payload<tcm2malu_PTR>();
+         for (int e = 0; e < LUT_ENTRIES_PER_LINE; ++e) {
+             FloatConverter c;
+             c.f = 1.0f / (1.0f + (l*LUT_ENTRIES_PER_LINE + e) / 64.0f);
+             beat->data.range(e*32+31, e*32) = c.u;
+         }
+         beat->last = true;
+         fifo_tcm2malu[l].write(beat);
+     }
+     runTest(5, 0x40800000, 0x00000000, 0x3E800000, "FP32 RCP (LUT)", fifo_sfr, fifo_npuc2malu, fifo_mrf2malu, fifo_malu2mrf, 0, true);
+     // Test 11: FP32 SOFTMAX with +inf in lanes 3 and 40 among 1.0f lanes:
+     //    one-hot split over the +inf lanes (0.5f each), not a row of NaN
+     {
+         uint32_t x[64], want[64];
+         for (int lane = 0; lane < 64; ++lane) {
+             x[lane]    = (lane == 3 || lane == 40) ? 0x7F800000 : 0x3F800000;
+             want[lane] = (lane == 3 || lane == 40) ? 0x3F000000 : 0x00000000;
+         }
+         runSoftmaxRow(x, want, "FP32 SOFTMAX +INF", fifo_sfr, fifo_npuc2malu, fifo_mrf2malu, fifo_malu2mrf);
+     }
+
+     // Test 12: FP32 SOFTMAX on a row masked with -inf everywhere: the running
+     //    max stays -inf and exp(-inf - -inf) must not leak NaN, all lanes 0
+     {
+         uint32_t x[64], want[64];
+         for (int lane = 0; lane < 64; ++lane) {
+             x[lane]    = 0xFF800000;
+             want[lane] = 0x00000000;
+         }
+         runSoftmaxRow(x, want, "FP32 SOFTMAX -INF", fifo_sfr, fifo_npuc2malu, fifo_mrf2malu, fifo_malu2mrf);
+     }
  
      sc_start(200, SC_NS);
      sc_stop();
+     payload_pool_base::report(std::cout);
      return 0;
  }
  
\ No newline at end of file
@@ -8,17 +8,19 @@
 
 malu::malu(sc_core::sc_module_name name, int id)
     : sc_module(name)
+    , clk("clk")
     , reset("reset")
     , i_npuc2malu("i_npuc2malu")
     , o_malu2npuc("o_malu2npuc")
     , i_mrf2malu("i_mrf2malu", 2)
     , o_malu2mrf("o_malu2mrf")
     , i_reg_map("i_reg_map")
+    , o_malu2tcm("o_malu2tcm")
+    , i_tcm2malu("i_tcm2malu", LUT_LINES_PER_BEAT)
     , funccore("funccore")
     , id(id)
 {
-    // Create a local clock
-    funccore.clk.bind(*new sc_clock("clk", 10, SC_NS));
+    funccore.clk(clk);
     funccore.reset(reset);
 
     funccore.i_npuc2malu(i_npuc2malu);
@@ -31,6 +33,11 @@ malu::malu(sc_core::sc_module_name name, int id)
 
     funccore.i_reg_map(i_reg_map);
 
+    funccore.o_malu2tcm(o_malu2tcm);
+    for(int j=0; j<LUT_LINES_PER_BEAT; j++){
+        funccore.i_tcm2malu[j]( i_tcm2malu[j] );
+    }
+
     funccore.set_Id(id);
 }
 
@@ -39,3 +46,8 @@ void malu::set_id(int set_id)
     id=set_id;
     funccore.set_Id(set_id);
 }
+
+void malu::tag_sr_step(uint32_t step)
+{
+    funccore.tag_sr_step(step);
+}
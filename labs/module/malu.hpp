@@ -14,14 +14,18 @@ public:
     SC_HAS_PROCESS(malu);
     malu(sc_core::sc_module_name name, int id);
 
+    sc_in<bool> clk;
     sc_in<bool> reset;
     sc_fifo_in<npuc2malu_PTR>  i_npuc2malu;
     sc_fifo_out<malu2npuc_PTR> o_malu2npuc;
     sc_vector< sc_fifo_in<mrf2malu_PTR> > i_mrf2malu;
     sc_fifo_out<malu2mrf_PTR>  o_malu2mrf;
     sc_fifo_in<sfr_PTR>        i_reg_map;
+    sc_fifo_out<malu2tcm_PTR>  o_malu2tcm;
+    sc_vector< sc_fifo_in<tcm2malu_PTR> > i_tcm2malu;
 
     void set_id(int set_id);
+    void tag_sr_step(uint32_t step);
 
 private:
     malu_funccore funccore;
@@ -0,0 +1,28 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: malu2tcm.hpp
+ * Description: MALU -> TCM read request for a LUT load: start address (the
+ *              SFR lut_base_addr, in 512-bit TCM lines) and the number of
+ *              beats of four lines each to return on i_tcm2malu.
+ **********/
+#pragma once
+#include <systemc.h>
+#include "payload_pool.hpp"
+
+struct malu2tcm {
+    sc_uint<15> addr  = 0;
+    sc_uint<8>  beats = 0;
+
+    void reset() { addr = 0; beats = 0; }
+};
+
+typedef pool_ptr<malu2tcm> malu2tcm_PTR;
+
+inline std::ostream& operator<<(std::ostream& os, const malu2tcm_PTR& p)
+{
+    if(p) os << "malu2tcm{addr=0x" << std::hex << p->addr.to_uint() << std::dec
+             << " beats=" << p->beats.to_uint() << "}";
+    else  os << "malu2tcm{null}";
+    return os;
+}
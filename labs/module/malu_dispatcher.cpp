@@ -0,0 +1,274 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: malu_dispatcher.cpp
+ * Description: Implements the multi-MALU dispatcher. It has three threads:
+ *              1) dispatch_thread => up to one command per instance per cycle,
+ *                 least commands in flight first, mask readers to the mask's
+ *                 instance, row macro-ops with their lines to an idle one
+ *              2) retire_thread => forwards results to the MRF in dispatch order
+ *              3) tcm_thread => serves the instances' LUT loads one at a time
+ **********/
+#include "malu_dispatcher.hpp"
+#include <iomanip>
+#include <iostream>
+
+malu_dispatcher::malu_dispatcher(sc_core::sc_module_name name, int num_malu)
+  : sc_module(name)
+  , clk("clk")
+  , reset("reset")
+  , i_npuc2malu("i_npuc2malu")
+  , o_malu2npuc("o_malu2npuc")
+  , i_mrf2malu("i_mrf2malu", 2)
+  , o_malu2mrf("o_malu2mrf")
+  , i_reg_map("i_reg_map")
+  , o_malu2tcm("o_malu2tcm")
+  , i_tcm2malu("i_tcm2malu", LUT_LINES_PER_BEAT)
+  , num_malu(num_malu)
+  , malus("malu", num_malu,
+          [](const char* nm, size_t i) { return new malu(nm, (int)i); })
+  , npuc2malu_f("npuc2malu_f", num_malu)
+  , malu2npuc_f("malu2npuc_f", num_malu)
+  , mrf2malu_f("mrf2malu_f", 2*num_malu)
+  , malu2mrf_f("malu2mrf_f", num_malu)
+  , sfr_f("sfr_f", num_malu)
+  , malu2tcm_f("malu2tcm_f", num_malu)
+  , tcm2malu_f("tcm2malu_f", LUT_LINES_PER_BEAT*num_malu)
+  , sent_sfr(num_malu)
+  , inflight(num_malu, 0)
+  , util(num_malu)
+  , cycles(0)
+{
+    for(int i=0; i<num_malu; i++){
+        malus[i].clk(clk);
+        malus[i].reset(reset);
+        malus[i].i_npuc2malu(npuc2malu_f[i]);
+        malus[i].o_malu2npuc(malu2npuc_f[i]);
+        for(int p=0; p<2; p++)
+            malus[i].i_mrf2malu[p](mrf2malu_f[2*i+p]);
+        malus[i].o_malu2mrf(malu2mrf_f[i]);
+        malus[i].i_reg_map(sfr_f[i]);
+        malus[i].o_malu2tcm(malu2tcm_f[i]);
+        for(int l=0; l<LUT_LINES_PER_BEAT; l++)
+            malus[i].i_tcm2malu[l](tcm2malu_f[LUT_LINES_PER_BEAT*i+l]);
+    }
+
+    SC_CTHREAD(dispatch_thread, clk.pos());
+    reset_signal_is(reset,true);
+
+    SC_CTHREAD(retire_thread, clk.pos());
+    reset_signal_is(reset,true);
+
+    SC_CTHREAD(tcm_thread, clk.pos());
+    reset_signal_is(reset,true);
+}
+
+// Instance with the fewest commands in flight that is not used this cycle
+// and has room; ties go to the lowest id. -1 if none.
+int malu_dispatcher::pick_instance(const std::vector<bool>& used) const
+{
+    int best = -1;
+    for(int i=0; i<num_malu; i++){
+        if(used[i] || inflight[i] >= MALU_MAX_INFLIGHT)
+            continue;
+        // a new configuration only goes to an idle instance
+        if(sent_sfr[i] != cur_sfr && inflight[i] != 0)
+            continue;
+        // the mask a SELECT or predicated op reads is in one instance only
+        if(cur_reads_mask && mask_malu >= 0 && i != mask_malu)
+            continue;
+        // a row macro-op takes an instance to itself
+        if(cur_macro && inflight[i] != 0)
+            continue;
+        if(best < 0 || inflight[i] < inflight[best])
+            best = i;
+    }
+    return best;
+}
+
+// What the dispatcher needs to know about cur_sfr's operation
+void malu_dispatcher::decode_sfr()
+{
+    decoded_sfr_t cfg;
+    cfg.load(*cur_sfr);
+    cfg.apply_ops_context(stream_ops);
+
+    bool     ext = (cfg.operation==15);
+    unsigned op  = cfg.ext_op();
+    bool     cmp = ext && (op==EXT_CMP_EQ || op==EXT_CMP_LT || op==EXT_CMP_LE);
+
+    cur_macro       = ext && op < EXT_NUM_MACRO;
+    cur_row_lines   = cfg.row_lines();
+    // softmax reads x twice on port 0, the norms also gamma (and beta) on port 1
+    cur_row_in[0]   = 2*cur_row_lines;
+    cur_row_in[1]   = (op==EXT_SOFTMAX)   ? 0
+                    : (op==EXT_LAYERNORM) ? 2*cur_row_lines : cur_row_lines;
+    cur_reads_mask  = !cur_macro && (cfg.predicated() || (ext && op==EXT_SELECT));
+    // packed BF16x2 compares are rejected and leave the mask alone
+    cur_writes_mask = cmp && cfg.input_format!=3;
+}
+
+// Forwards the next line on each MRF port to the instance running a row
+// macro-op; true once the whole row has gone out.
+bool malu_dispatcher::forward_row()
+{
+    for(int p=0; p<2; p++){
+        sc_fifo<mrf2malu_PTR>& dst = mrf2malu_f[2*row_malu+p];
+        if(row_left[p] > 0 && i_mrf2malu[p].num_available() > 0 && dst.num_free() > 0) {
+            dst.write(i_mrf2malu[p].read());
+            row_left[p]--;
+        }
+    }
+    return row_left[0]==0 && row_left[1]==0;
+}
+
+// The dispatch thread
+// An instance that needs the current configuration gets it first and takes
+// the command one cycle later, so its sfr_decoder has run by then.
+// The lines of a row macro-op follow its command on the MRF ports, so the
+// next command is only taken once they have all been forwarded.
+void malu_dispatcher::dispatch_thread()
+{
+    cur_sfr    = nullptr;
+    stream_ops = ops_context();
+    cur_macro       = false;
+    cur_reads_mask  = false;
+    cur_writes_mask = false;
+    mask_malu  = -1;
+    row_malu   = -1;
+    order.clear();
+    for(int i=0; i<num_malu; i++){
+        sent_sfr[i] = nullptr;
+        inflight[i] = 0;
+        util[i]     = malu_util();
+    }
+    cycles = 0;
+    wait();
+    while(true){
+        if(row_malu >= 0 && forward_row())
+            row_malu = -1;
+
+        if(row_malu < 0 && i_reg_map.num_available() > 0) {
+            cur_sfr = i_reg_map.read();
+            decode_sfr();
+        }
+
+        std::vector<bool> used(num_malu, false);
+        while(cur_sfr && row_malu < 0 &&
+              i_npuc2malu.num_available() > 0 &&
+              (cur_macro || (i_mrf2malu[0].num_available() > 0 &&
+                             i_mrf2malu[1].num_available() > 0)))
+        {
+            int pick = pick_instance(used);
+            if(pick < 0)
+                break;
+            used[pick] = true;
+
+            if(sent_sfr[pick] != cur_sfr) {
+                sfr_f[pick].write(cur_sfr);
+                sent_sfr[pick] = cur_sfr;
+                continue;
+            }
+
+            auto cmd_ptr = i_npuc2malu.read();
+            if(cmd_ptr->start != 1)
+                continue;   // the MALU ignores it too, nothing comes back
+
+            malus[pick].tag_sr_step(stream_ops.sr_step);
+            npuc2malu_f[pick].write(cmd_ptr);
+            inflight[pick]++;
+            util[pick].commands++;
+
+            if(cur_macro) {
+                // one SR step per output line, as the row runs on one MALU
+                stream_ops.sr_step += cur_row_lines;
+                order.push_back({pick, cur_row_lines});
+                row_malu    = pick;
+                row_left[0] = cur_row_in[0];
+                row_left[1] = cur_row_in[1];
+                break;
+            }
+
+            stream_ops.sr_step++;
+            mrf2malu_f[2*pick  ].write(i_mrf2malu[0].read());
+            mrf2malu_f[2*pick+1].write(i_mrf2malu[1].read());
+            order.push_back({pick, 1});
+            if(cur_writes_mask)
+                mask_malu = pick;
+        }
+
+        for(int i=0; i<num_malu; i++)
+            if(inflight[i] > 0) util[i].busy_cycles++;
+        cycles++;
+        wait();
+    }
+}
+
+// The retire thread
+// Takes results from the instance at the head of the dispatch order only,
+// so the MRF sees them in command order, up to one per instance per cycle.
+// A row macro-op's lines go out one per cycle, its done with the last one.
+void malu_dispatcher::retire_thread()
+{
+    wait();
+    while(true){
+        for(int k=0; k<num_malu && !order.empty(); k++){
+            retire_entry& head = order.front();
+            if(malu2mrf_f[head.malu].num_available() == 0)
+                break;
+            if(head.lines == 1 && malu2npuc_f[head.malu].num_available() == 0)
+                break;
+            o_malu2mrf.write(malu2mrf_f[head.malu].read());
+            if(--head.lines > 0)
+                break;
+            o_malu2npuc.write(malu2npuc_f[head.malu].read());
+            inflight[head.malu]--;
+            order.pop_front();
+        }
+        wait();
+    }
+}
+
+// The TCM thread
+// Round-robin over the instances' LUT requests; the beats of one request
+// are routed back to the instance that issued it before the next starts.
+void malu_dispatcher::tcm_thread()
+{
+    int next = 0;
+    wait();
+    while(true){
+        for(int k=0; k<num_malu; k++){
+            int i = (next + k) % num_malu;
+            if(malu2tcm_f[i].num_available() == 0)
+                continue;
+
+            auto req = malu2tcm_f[i].read();
+            o_malu2tcm.write(req);
+            for(unsigned b=0; b<req->beats.to_uint(); b++){
+                for(int l=0; l<LUT_LINES_PER_BEAT; l++){
+                    while(i_tcm2malu[l].num_available() == 0)
+                        wait();
+                    tcm2malu_f[LUT_LINES_PER_BEAT*i+l].write(i_tcm2malu[l].read());
+                }
+                wait();
+            }
+            next = (i + 1) % num_malu;
+            break;
+        }
+        wait();
+    }
+}
+
+// Utilization summary
+void malu_dispatcher::end_of_simulation()
+{
+    std::cout << "[MALU dispatcher] " << num_malu << " instances, "
+              << cycles << " cycles" << std::endl;
+    for(int i=0; i<num_malu; i++){
+        double busy = cycles ? 100.0 * util[i].busy_cycles / cycles : 0.0;
+        std::cout << "  malu " << i
+                  << ": commands=" << util[i].commands
+                  << " busy=" << std::fixed << std::setprecision(1) << busy << "%"
+                  << std::defaultfloat << std::endl;
+    }
+}
@@ -0,0 +1,99 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: malu_dispatcher.hpp
+ * Description: Fans MALU commands out over N malu instances.
+ *              Same ports as one malu toward NPUC, MRF and TCM. Each command
+ *              goes to the instance with the fewest commands in flight, results
+ *              go back to the MRF in dispatch order, and per-instance utilization
+ *              is reported at the end of simulation.
+ *              Each instance rounds with its own ops context. The stochastic
+ *              rounding step is counted over the whole command stream here and
+ *              tagged onto each command, so the result bits do not depend on
+ *              the number of instances or on which one took a line.
+ *              The lane mask lives in the instance that ran the compare, so
+ *              SELECT and predicated commands go to the instance that ran the
+ *              last compare. A row macro-op (operation 15, sub-op < EXT_NUM_MACRO)
+ *              goes to an idle instance with all the lines of its row; nothing
+ *              else is dispatched until the row has been forwarded.
+ **********/
+#pragma once
+#include <systemc.h>
+#include <deque>
+#include <vector>
+#include "malu.hpp"
+
+static const int MALU_MAX_INFLIGHT = 4;   // commands queued per instance
+
+class malu_dispatcher: public sc_core::sc_module {
+public:
+    SC_HAS_PROCESS(malu_dispatcher);
+    malu_dispatcher(sc_core::sc_module_name name, int num_malu);
+
+    sc_in<bool> clk;
+    sc_in<bool> reset;
+
+    sc_fifo_in<npuc2malu_PTR>  i_npuc2malu;
+    sc_fifo_out<malu2npuc_PTR> o_malu2npuc;
+    sc_vector< sc_fifo_in<mrf2malu_PTR> > i_mrf2malu;
+    sc_fifo_out<malu2mrf_PTR>  o_malu2mrf;
+    sc_fifo_in<sfr_PTR>        i_reg_map;
+    sc_fifo_out<malu2tcm_PTR>  o_malu2tcm;
+    sc_vector< sc_fifo_in<tcm2malu_PTR> > i_tcm2malu;
+
+    struct malu_util {
+        uint64_t commands    = 0;
+        uint64_t busy_cycles = 0;   // cycles with at least one command in flight
+    };
+
+    int              get_num_malu() const { return num_malu; }
+    const malu_util& get_util(int i) const { return util[i]; }
+    uint64_t         get_cycles() const { return cycles; }
+
+private:
+    int num_malu;
+
+    sc_vector<malu> malus;
+
+    // per-instance channels; MRF inputs at [2*i + port], TCM lines at [4*i + line]
+    sc_vector< sc_fifo<npuc2malu_PTR> > npuc2malu_f;
+    sc_vector< sc_fifo<malu2npuc_PTR> > malu2npuc_f;
+    sc_vector< sc_fifo<mrf2malu_PTR> >  mrf2malu_f;
+    sc_vector< sc_fifo<malu2mrf_PTR> >  malu2mrf_f;
+    sc_vector< sc_fifo<sfr_PTR> >       sfr_f;
+    sc_vector< sc_fifo<malu2tcm_PTR> >  malu2tcm_f;
+    sc_vector< sc_fifo<tcm2malu_PTR> >  tcm2malu_f;
+
+    // a command in dispatch order and the result lines it still owes the MRF
+    struct retire_entry {
+        int      malu;
+        unsigned lines;
+    };
+
+    sfr_PTR              cur_sfr;     // latest configuration from i_reg_map
+    ops_context          stream_ops;  // cur_sfr's context, SR step of the next command
+    bool                 cur_macro;       // cur_sfr is a row macro-op
+    unsigned             cur_row_lines;   // its row length in MRF lines
+    unsigned             cur_row_in[2];   // lines it reads per row on each MRF port
+    bool                 cur_reads_mask;  // SELECT or predicated
+    bool                 cur_writes_mask; // compare
+    int                  mask_malu;   // instance that ran the last compare, -1 if none
+    int                  row_malu;    // instance taking the lines of a row, -1 if none
+    unsigned             row_left[2]; // lines of that row still to forward per port
+    std::vector<sfr_PTR> sent_sfr;    // configuration each instance runs with
+    std::vector<int>     inflight;
+    std::deque<retire_entry> order;   // commands in dispatch order
+    std::vector<malu_util> util;
+    uint64_t             cycles;
+
+    // threads
+    void dispatch_thread();
+    void retire_thread();
+    void tcm_thread();
+
+    void decode_sfr();
+    bool forward_row();
+    int  pick_instance(const std::vector<bool>& used) const;
+
+    void end_of_simulation();
+};
@@ -3,9 +3,16 @@
  * Project: Project name
  * File: malu_funccore.cpp
  * Description: Implements the MALU functional core. It has three threads:
- *              1) pipeline_thread => single-cycle 64-lane math ops
+ *              1) pipeline_thread => two-deep operand staging in front of the
+ *                 single-cycle 64-lane math ops, incl. activations
+ *                 (op 13), FMA (op 14) and the fused activation after ADD/FMA;
+ *                 op 15 runs the multi-line row macro-ops (softmax, RMSNorm,
+ *                 LayerNorm) and counts their cycles against the unfused sequence,
+ *                 and the single-line compare/select/min/abs/neg/bitwise ops, where
+ *                 compares write the 64-bit lane mask used by select and predication
  *              2) sfr_decoder => reads from i_reg_map (COMMON_REGISTERS) subfields
- *              3) lut_load_thread => dummy
+ *              3) lut_load_thread => serves LUT load requests from the resident
+ *                 tables (LRU) or from TCM, used by the table-driven ops 5..11
  **********/
 #include "malu_funccore.hpp"
 #include <iostream>
@@ -35,6 +42,76 @@ void decoded_sfr_t::printHumanReadable() const
               << "  saturation_enable=" << saturation_enable << std::endl;
 }
 
+// Copy the MALU sub-structs of _COMMON_REGISTERS into the decoded fields
+void decoded_sfr_t::load(const _COMMON_REGISTERS& regs)
+{
+    // 1) For 0x64 => reg_parsed_option_math_load_store
+    store_output      = regs.reg_parsed_option_math_load_store.store_output;
+    reg_index_output  = regs.reg_parsed_option_math_load_store.reg_index_output;
+    load_input_1      = regs.reg_parsed_option_math_load_store.load_input_1;
+    reg_index_input_1 = regs.reg_parsed_option_math_load_store.reg_index_input_1;
+    load_input_0      = regs.reg_parsed_option_math_load_store.load_input_0;
+    reg_index_input_0 = regs.reg_parsed_option_math_load_store.reg_index_input_0;
+
+    // 2) Also from 0x64 => reg_parsed_option_math_lut
+    load_lut_enable   = regs.reg_parsed_option_math_lut.load_lut_enable;
+    lut_size          = regs.reg_parsed_option_math_lut.lut_size;
+    lut_base_addr     = regs.reg_parsed_option_math_lut.lut_base_addr;
+
+    // 3) 0x68 => reg_parsed_option_math_scalar
+    scalar_index_output  = regs.reg_parsed_option_math_scalar.scalar_index_output;
+    scalar_index_input_1 = regs.reg_parsed_option_math_scalar.scalar_index_input_1;
+
+    // 4) 0x6A => reg_parsed_option_math_immediate
+    immediate_value = regs.reg_parsed_option_math_immediate.immediate_value;
+
+    // 5) 0xA0 => reg_parsed_mode_math
+    operation         = regs.reg_parsed_mode_math.operation;
+    input_format      = regs.reg_parsed_mode_math.input_format;
+    output_format     = regs.reg_parsed_mode_math.output_format;
+    operand_type      = regs.reg_parsed_mode_math.operand_type;
+    fused_op          = regs.reg_parsed_mode_math.fused_op;
+    rounding_mode     = regs.reg_parsed_mode_math.rounding_mode;
+    saturation_enable = regs.reg_parsed_mode_math.saturation_enable;
+}
+
+void decoded_sfr_t::apply_ops_context(ops_context& ctx) const
+{
+    ops_context_scope scope(ctx);
+    apply_ops_context();
+}
+
+void decoded_sfr_t::apply_ops_context() const
+{
+    bool excpt   = (operation[0]==1);
+    bool clamp   = (saturation_enable==1);
+    bool trunc   = (rounding_mode[0]==1);
+    bool subnorm = true;
+    setOpsContext(subnorm, trunc, clamp, excpt);
+
+    // rounding_mode[1] => stochastic rounding on narrowing outputs.
+    // The scalar index fields are not used by this model, they carry the seed.
+    bool     stoch = (rounding_mode[1]==1);
+    uint32_t seed  = (scalar_index_output.to_uint() << 8)
+                   |  scalar_index_input_1.to_uint();
+    updateOpsStochastic(stoch, seed);
+}
+
+malu_datapath::malu_datapath()
+  : active_lut(-1)
+  , lane_mask(~0ull)
+  , rejected_lines(0)
+{
+}
+
+void malu_datapath::reset()
+{
+    luts.reset();
+    active_lut = -1;
+    lane_mask  = ~0ull;
+    ops        = ops_context();
+}
+
 // Constructor
 malu_funccore::malu_funccore(sc_core::sc_module_name name)
   : sc_module(name)
@@ -44,8 +121,13 @@ malu_funccore::malu_funccore(sc_core::sc_module_name name)
   , o_malu2npuc("o_malu2npuc")
   , i_mrf2malu("i_mrf2malu", 2)
   , o_malu2mrf("o_malu2mrf")
+  , o_malu2tcm("o_malu2tcm")
+  , i_tcm2malu("i_tcm2malu", LUT_LINES_PER_BEAT)
   , i_reg_map("i_reg_map")
   , id(-1)
+  , macro_cycles(0)
+  , stage_head(0)
+  , stage_count(0)
 {
     SC_CTHREAD(pipeline_thread, clk.pos());
     reset_signal_is(reset,true);
@@ -62,12 +144,47 @@ void malu_funccore::set_Id(int set_id)
     id= set_id;
 }
 
-// The dummy LUT load thread
+// The LUT load thread
+// A request for (lut_base_addr, lut_size) that is already resident only
+// becomes the active table. Otherwise the LRU slot is refilled: one read
+// request to TCM, then one beat of four 512-bit lines per cycle.
 void malu_funccore::lut_load_thread()
 {
+    dp.reset();
+    lut_reqs.clear();
     wait();
     while(true){
-        // For future LUT usage
+        if(!lut_reqs.empty()) {
+            uint32_t base = lut_reqs.front().base;
+            unsigned size = lut_reqs.front().size;
+            int slot = dp.luts.find(base, size);
+            if(slot < 0) {
+                unsigned beats = lut_cache::beats(lut_cache::entries(size));
+                slot = dp.luts.allocate(base, size);
+
+                auto req = make_payload<malu2tcm_PTR>();
+                req->addr  = base;
+                req->beats = beats;
+                o_malu2tcm.write(req);
+
+                for(unsigned b=0; b<beats; b++){
+                    for(int l=0; l<LUT_LINES_PER_BEAT; l++){
+                        while(i_tcm2malu[l].num_available()==0)
+                            wait();
+                        dp.luts.fill(slot, b, l, i_tcm2malu[l].read()->data);
+                    }
+                    wait();
+                }
+                dp.luts.commit(slot);
+#if DEBUG_LOG_SEVERITY>0
+                std::cout << "[MALU " << id << "] LUT 0x" << std::hex << base << std::dec
+                          << " (" << lut_cache::entries(size) << " entries) loaded into slot "
+                          << slot << "\n";
+#endif
+            }
+            dp.active_lut = slot;
+            lut_reqs.pop_front();   // only now: later requests stay queued
+        }
         wait();
     }
 }
@@ -84,163 +201,513 @@ void malu_funccore::sfr_decoder()
         if(i_reg_map.num_available() > 0) {
             auto sfr_ptr = i_reg_map.read();
 
-            // We'll do a switch on *addresses* if you wish. 
-            // But user code says each sub-struct in _COMMON_REGISTERS 
-            // is already splitted. So let's do direct copying:
-
-            // 1) For 0x64 => reg_parsed_option_math_load_store
-            sfr_config.store_output      = sfr_ptr->reg_parsed_option_math_load_store.store_output;
-            sfr_config.reg_index_output  = sfr_ptr->reg_parsed_option_math_load_store.reg_index_output;
-            sfr_config.load_input_1      = sfr_ptr->reg_parsed_option_math_load_store.load_input_1;
-            sfr_config.reg_index_input_1 = sfr_ptr->reg_parsed_option_math_load_store.reg_index_input_1;
-            sfr_config.load_input_0      = sfr_ptr->reg_parsed_option_math_load_store.load_input_0;
-            sfr_config.reg_index_input_0 = sfr_ptr->reg_parsed_option_math_load_store.reg_index_input_0;
-
-            // 2) Also from 0x64 => reg_parsed_option_math_lut
-            sfr_config.load_lut_enable   = sfr_ptr->reg_parsed_option_math_lut.load_lut_enable;
-            sfr_config.lut_size          = sfr_ptr->reg_parsed_option_math_lut.lut_size;
-            sfr_config.lut_base_addr     = sfr_ptr->reg_parsed_option_math_lut.lut_base_addr;
-
-            // 3) 0x68 => reg_parsed_option_math_scalar
-            sfr_config.scalar_index_output  = sfr_ptr->reg_parsed_option_math_scalar.scalar_index_output;
-            sfr_config.scalar_index_input_1 = sfr_ptr->reg_parsed_option_math_scalar.scalar_index_input_1;
-
-            // 4) 0x6A => reg_parsed_option_math_immediate
-            sfr_config.immediate_value = sfr_ptr->reg_parsed_option_math_immediate.immediate_value;
-
-            // 5) 0xA0 => reg_parsed_mode_math
-            sfr_config.operation         = sfr_ptr->reg_parsed_mode_math.operation;
-            sfr_config.input_format      = sfr_ptr->reg_parsed_mode_math.input_format;
-            sfr_config.output_format     = sfr_ptr->reg_parsed_mode_math.output_format;
-            sfr_config.operand_type      = sfr_ptr->reg_parsed_mode_math.operand_type;
-            sfr_config.fused_op          = sfr_ptr->reg_parsed_mode_math.fused_op;
-            sfr_config.rounding_mode     = sfr_ptr->reg_parsed_mode_math.rounding_mode;
-            sfr_config.saturation_enable = sfr_ptr->reg_parsed_mode_math.saturation_enable;
+            sfr_config.load(*sfr_ptr);
 
 #if DEBUG_LOG_SEVERITY>0
             std::cout << "[SFR Decoder] Copied sub-struct fields into sfr_config.\n";
             sfr_config.printHumanReadable();
 #endif
-            // Possibly set the global ops context from the mode fields
-            bool excpt   = (sfr_config.operation[0]==1);
-            bool clamp   = (sfr_config.saturation_enable==1);
-            bool trunc   = (sfr_config.rounding_mode[0]==1);
-            bool subnorm = true;
-            setOpsContext(subnorm, trunc, clamp, excpt);
+            if(sfr_config.load_lut_enable==1)
+                lut_reqs.push_back({ sfr_config.lut_base_addr.to_uint(),
+                                     sfr_config.lut_size.to_uint() });
         }
     }
 }
 
-// The pipeline thread
-// Reads instructions from i_npuc2malu and two lines from MRF, 
-// uses sfr_config.operation to pick the math op, 
-// does a 64-lane single-cycle pass, writes out results.
-void malu_funccore::pipeline_thread()
+// Line <-> lane helpers, one 32-bit range per lane
+void unpack_line(const sc_bv<2048>& bits, uint32_t (&lanes)[MALU_LANES])
+{
+    for(int lane=0; lane<MALU_LANES; lane++)
+        lanes[lane] = bits.range(lane*32+31, lane*32).to_uint();
+}
+
+void pack_line(const uint32_t (&lanes)[MALU_LANES], sc_bv<2048>& bits)
+{
+    for(int lane=0; lane<MALU_LANES; lane++)
+        bits.range(lane*32+31, lane*32) = lanes[lane];
+}
+
+// BF16x2 lanes => two BF16 lanes each, value moved to the upper 16 bits.
+// Plain shifts and masks over the whole line, no per-element branching.
+static void split_bf16x2(const uint32_t (&in)[MALU_LANES],
+                         uint32_t (&lo)[MALU_LANES], uint32_t (&hi)[MALU_LANES])
+{
+    for(int lane=0; lane<MALU_LANES; lane++) {
+        lo[lane] = in[lane] << 16;
+        hi[lane] = in[lane] & 0xFFFF0000u;
+    }
+}
+
+// One clock of a macro-op, counted for macro_op_stats
+void malu_funccore::tick()
 {
+    macro_cycles++;
     wait();
-    while(true){
-        if(i_npuc2malu.num_available()>0 &&
-           i_mrf2malu[0].num_available()>0 &&
-           i_mrf2malu[1].num_available()>0)
+}
+
+// Poll one MRF port until a line arrives (no blocking reads in a CTHREAD)
+mrf2malu_PTR malu_funccore::wait_mrf_line(int port)
+{
+    while(i_mrf2malu[port].num_available()==0)
+        tick();
+    return i_mrf2malu[port].read();
+}
+
+// Single-line extended op on one lane. Compares return the input A lane
+// unchanged and report their outcome in cmp_bit; the caller packs the mask.
+sc_uint<32> malu_datapath::ext_lane_op(const decoded_sfr_t& cfg, unsigned op,
+                                       sc_uint<32> a, sc_uint<32> b, int lane,
+                                       LaneType t, bool& cmp_bit) const
+{
+    cmp_bit = false;
+    switch(op) {
+        case EXT_CMP_EQ: cmp_bit = lane_cmp_eq_1c(a, b, t); return a;
+        case EXT_CMP_LT: cmp_bit = lane_cmp_lt_1c(a, b, t); return a;
+        case EXT_CMP_LE: cmp_bit = lane_cmp_le_1c(a, b, t); return a;
+        case EXT_SELECT: return ((lane_mask >> lane) & 1) ? a : b;
+        case EXT_MIN:    return lane_min_1c(a, b, t);
+        case EXT_ABS:    return lane_abs_1c(a, t);
+        case EXT_NEG:    return lane_neg_1c(a, t);
+        case EXT_AND:    return int_and_1c(a, b);
+        case EXT_OR:     return int_or_1c(a, b);
+        case EXT_XOR:    return int_xor_1c(a, b);
+        case EXT_SHL:    return int_shl_1c(a, cfg.shift_amt());
+        case EXT_SHR:    return int_shr_1c(a, cfg.shift_amt());
+        case EXT_SRA:    return int_sra_1c(a, cfg.shift_amt());
+        default:         return 0;
+    }
+}
+
+// Extended op dispatch (operation 15)
+void malu_funccore::run_ext_op()
+{
+    unsigned op    = sfr_config.ext_op();
+    uint64_t lines = sfr_config.row_lines();
+    macro_cycles = 0;
+    sfr_config.apply_ops_context(issue_ops);
+
+    switch(op) {
+        case EXT_SOFTMAX:
+            softmax_row();
+            // max-reduce, sub, exp, sum-reduce, rcp, mul
+            macro_stats[op].unfused_cycles += 5*lines + 2*6 + 1;
+            break;
+        case EXT_RMSNORM:
+            norm_row(true);
+            // square, sum-reduce, rsqrt, mul rstd, mul gamma
+            macro_stats[op].unfused_cycles += 4*lines + 6 + 1;
+            break;
+        case EXT_LAYERNORM:
+            norm_row(false);
+            // sum-reduce, sub mean, square, sum-reduce, rsqrt, mul rstd, mul gamma, add beta
+            macro_stats[op].unfused_cycles += 7*lines + 2*6 + 1;
+            break;
+        default:
+            break;
+    }
+    if(op < EXT_NUM_MACRO) {
+        macro_stats[op].calls++;
+        macro_stats[op].lines  += lines;
+        macro_stats[op].cycles += macro_cycles;
+#if DEBUG_LOG_SEVERITY>0
+        std::cout << "[MALU " << id << "] ext op " << op << ": " << lines
+                  << " lines in " << macro_cycles << " cycles\n";
+#endif
+    }
+
+    auto out_npu= make_payload<malu2npuc_PTR>();
+    out_npu->done=1;
+    o_malu2npuc.write(out_npu);
+}
+
+// Softmax over one row of row_lines() lines.
+// Pass 1 streams the row on port 0 and keeps only the running max/sum,
+// pass 2 streams it again on port 0 and writes the normalized lines.
+// One line per cycle in each pass, so 2*row_lines() cycles in total.
+void malu_funccore::softmax_row()
+{
+    unsigned lines = sfr_config.row_lines();
+    bool     bf16  = (sfr_config.input_format==1);
+    uint32_t in[MALU_LANES], out[MALU_LANES];
+
+    softmax_state st;
+    st.reset();
+    for(unsigned l=0; l<lines; l++){
+        unpack_line(wait_mrf_line(0)->data, in);
         {
-            auto cmd_ptr = i_npuc2malu.read();
+            ops_context_scope scope(issue_ops);
+            st.accumulate(in, bf16);
+        }
+        tick();
+    }
 
-            if(cmd_ptr->start==1) {
-                // read MRF lines
-                auto inA_ptr= i_mrf2malu[0].read();
-                auto inB_ptr= i_mrf2malu[1].read();
-
-                sc_bv<2048> outBits=0;
-                sc_bv<2048> aBits = inA_ptr->data;
-                sc_bv<2048> bBits = inB_ptr->data;
-
-                // interpret input_format => 0=FP32, 1=BF16, 2=INT8?
-                bool use_fp32= (sfr_config.input_format==0);
-                bool use_bf16= (sfr_config.input_format==1);
-
-                for(int lane=0; lane<64; lane++){
-                    sc_uint<32> valA=0, valB=0;
-
-                    // Safely cast bits from sc_bv to bool before assigning to valA
-                    for(int bit=0; bit<32; bit++){
-                        bool aBitVal = (bool)aBits[lane*32 + bit];
-                        bool bBitVal = (bool)bBits[lane*32 + bit];
-                        valA[bit]= aBitVal;
-                        valB[bit]= bBitVal;
-                    }
+    for(unsigned l=0; l<lines; l++){
+        unpack_line(wait_mrf_line(0)->data, in);
+        {
+            ops_context_scope scope(issue_ops);
+            st.normalize(in, out, bf16);
+        }
 
-                    sc_uint<32> result=0;
-                    switch(sfr_config.operation.to_uint()) {
-                        case 0: // add
-                            if(use_fp32) result= fp32_add_1c(valA,valB);
-                            else         result= bf16_add_1c(valA,valB);
-                            break;
-                        case 1: // sub
-                            if(use_fp32) result= fp32_sub_1c(valA,valB);
-                            else         result= bf16_sub_1c(valA,valB);
-                            break;
-                        case 2: // mul
-                            if(use_fp32) result= fp32_mul_1c(valA,valB);
-                            else         result= bf16_mul_1c(valA,valB);
-                            break;
-                        case 3: // max => dummy
-                            // naive: compare bits
-                            result= (valA>valB)? valA: valB;
-                            break;
-                        case 4: // sum => dummy => add
-                            if(use_fp32) result= fp32_add_1c(valA,valB);
-                            else         result= bf16_add_1c(valA,valB);
-                            break;
-                        case 5: // reciprocal => placeholder
-                            result=0;
-                            break;
-                        case 6: // inv sqrt even => placeholder
-                            result=0;
-                            break;
-                        case 7: // inv sqrt odd => placeholder
-                            result=0;
-                            break;
-                        case 8: // log => placeholder
-                            result=0;
-                            break;
-                        case 9: // exp => placeholder
-                            result=0;
-                            break;
-                        case 10:// sin => placeholder
-                            result=0;
-                            break;
-                        case 11:// cos => placeholder
-                            result=0;
-                            break;
-                        case 12:// type cast
-                        {
-                            NumFormat sF= (use_fp32? FP32 : (use_bf16? BF16 : INT8));
-                            NumFormat dF= (sfr_config.output_format==0)? FP32 :
-                                          ((sfr_config.output_format==1)? BF16 : INT8);
-                            result= typecast_single_cycle(valA, sF, dF);
-                        }
-                            break;
-                        default:
-                            result=0;
-                            break;
-                    }
+        auto out_mrf= make_payload<malu2mrf_PTR>();
+        pack_line(out, out_mrf->data);
+        out_mrf->done= (l==lines-1);
+        o_malu2mrf.write(out_mrf);
+        tick();
+    }
+}
 
-                    // store bits => outBits
-                    for(int bit=0; bit<32; bit++){
-                        outBits[lane*32 + bit] = (bool) result[bit];
-                    }
-                }
+// RMSNorm / LayerNorm over one row of row_lines() lines.
+// Pass 1 streams x on port 0 into the Welford accumulator, then one cycle
+// for the LUT rsqrt. Pass 2 streams x again on port 0 while port 1 delivers
+// gamma (and beta right after it for LayerNorm) for the same line.
+void malu_funccore::norm_row(bool rms)
+{
+    unsigned lines = sfr_config.row_lines();
+    bool     bf16  = (sfr_config.input_format==1);
+    uint32_t in[MALU_LANES], gamma[MALU_LANES], beta[MALU_LANES], out[MALU_LANES];
+
+    norm_state st;
+    st.reset();
+    for(unsigned l=0; l<lines; l++){
+        unpack_line(wait_mrf_line(0)->data, in);
+        {
+            ops_context_scope scope(issue_ops);
+            st.accumulate(in, bf16);
+        }
+        tick();
+    }
+    {
+        ops_context_scope scope(issue_ops);
+        st.finalize(rms, sfr_config.norm_eps());
+    }
+    tick();
+
+    for(unsigned l=0; l<lines; l++){
+        unpack_line(wait_mrf_line(0)->data, in);
+        unpack_line(wait_mrf_line(1)->data, gamma);
+        if(!rms) {
+            tick();   // port 1 delivers one line per cycle
+            unpack_line(wait_mrf_line(1)->data, beta);
+        }
+        {
+            ops_context_scope scope(issue_ops);
+            st.apply(in, gamma, rms ? nullptr : beta, out, bf16);
+        }
+
+        auto out_mrf= make_payload<malu2mrf_PTR>();
+        pack_line(out, out_mrf->data);
+        out_mrf->done= (l==lines-1);
+        o_malu2mrf.write(out_mrf);
+        tick();
+    }
+}
+
+// Macro-op cost summary
+void malu_funccore::end_of_simulation()
+{
+    static const char* names[EXT_NUM_MACRO] = { "softmax", "rmsnorm", "layernorm" };
+    for(int op=0; op<EXT_NUM_MACRO; op++){
+        const macro_op_stats& ms = macro_stats[op];
+        if(ms.calls==0) continue;
+        std::cout << "[MALU " << id << "] " << names[op]
+                  << ": calls=" << ms.calls
+                  << " lines=" << ms.lines
+                  << " cycles=" << ms.cycles
+                  << " unfused_cycles>=" << ms.unfused_cycles << std::endl;
+    }
+
+    if(sstats.lines > 0)
+        std::cout << "[MALU " << id << "] staging: lines=" << sstats.lines
+                  << " exposed_stall_cycles=" << sstats.stall_cycles << std::endl;
+    if(dp.rejected_lines > 0)
+        std::cout << "[MALU " << id << "] rejected BF16x2 lines (cast/compare)="
+                  << dp.rejected_lines << std::endl;
+
+    const lut_stats& ls = dp.luts.stats();
+    if(ls.hits + ls.misses > 0)
+        std::cout << "[MALU " << id << "] lut: hits=" << ls.hits
+                  << " misses=" << ls.misses
+                  << " evictions=" << ls.evictions
+                  << " tcm_beats=" << ls.beats << std::endl;
+}
+
+// One lane of the single-line ops (operation 0..15, minus the row macro-ops),
+// including the fused activation after ADD/FMA
+sc_uint<32> malu_datapath::lane_op(const decoded_sfr_t& cfg,
+                                   sc_uint<32> valA, sc_uint<32> valB, int lane,
+                                   bool use_fp32, bool use_bf16, bool& cmp_bit) const
+{
+    LaneType lane_t= use_fp32? LANE_FP32 : (use_bf16? LANE_BF16 : LANE_INT32);
+    sc_uint<32> result=0;
+    cmp_bit=false;
+
+    switch(cfg.operation.to_uint()) {
+        case 0: // add
+            if(use_fp32) result= fp32_add_1c(valA,valB);
+            else         result= bf16_add_1c(valA,valB);
+            break;
+        case 1: // sub
+            if(use_fp32) result= fp32_sub_1c(valA,valB);
+            else         result= bf16_sub_1c(valA,valB);
+            break;
+        case 2: // mul
+            if(use_fp32) result= fp32_mul_1c(valA,valB);
+            else         result= bf16_mul_1c(valA,valB);
+            break;
+        case 3: // max
+            result= lane_max_1c(valA, valB, lane_t);
+            break;
+        case 4: // sum => dummy => add
+            if(use_fp32) result= fp32_add_1c(valA,valB);
+            else         result= bf16_add_1c(valA,valB);
+            break;
+        case 5: // reciprocal
+        case 6: // inv sqrt even
+        case 7: // inv sqrt odd
+        case 8: // log
+        case 9: // exp
+        case 10:// sin
+        case 11:// cos
+            // from the active LUT, 0 if none was loaded
+            if(active_lut >= 0)
+                result= lut_eval_1c(cfg.operation.to_uint(), valA,
+                                    luts.get(active_lut), use_bf16);
+            else
+                result=0;
+            break;
+        case 12:// type cast
+        {
+            NumFormat sF= (use_fp32? FP32 : (use_bf16? BF16 : INT8));
+            NumFormat dF= (cfg.output_format==0)? FP32 :
+                          ((cfg.output_format==1)? BF16 : INT8);
+            result= typecast_single_cycle(valA, sF, dF);
+        }
+            break;
+        case 13:// activation of input 0, select in immediate[2:0]
+            if(use_fp32) result= fp32_act_1c(valA, cfg.act_func());
+            else         result= bf16_act_1c(valA, cfg.act_func());
+            break;
+        case 14:// FMA => A*B + scalar from immediate[31:16], rounded once
+            if(use_fp32) result= fp32_fma_1c(valA, valB, cfg.imm_scalar());
+            else         result= bf16_fma_1c(valA, valB, cfg.imm_scalar());
+            break;
+        case 15:// extended single-line ops, sub-op in immediate[14:8]
+            result= ext_lane_op(cfg, cfg.ext_op(), valA, valB, lane, lane_t, cmp_bit);
+            break;
+        default:
+            result=0;
+            break;
+    }
+
+    // fused activation after ADD/FMA, applied before the result leaves the lane
+    if(cfg.fused_op==1 &&
+       (cfg.operation==0 || cfg.operation==14))
+    {
+        if(use_fp32) result= fp32_act_1c(result, cfg.act_func());
+        else         result= bf16_act_1c(result, cfg.act_func());
+    }
+    return result;
+}
+
+// Extended ops that move raw 32-bit lanes instead of computing on a number
+static bool ext_is_raw(unsigned ext)
+{
+    return ext==EXT_SELECT || ext>=EXT_AND;
+}
+
+// One 64-lane pass over lines A and B.
+// input_format: 0=FP32, 1=BF16, 2=INT8, 3=BF16x2 (two BF16 per lane, element 0 in [15:0]).
+// BF16x2 MUL/FMA multiply both pairs and accumulate in FP32 (one FP32 result
+// per lane); the other element-wise ops (add/sub/max/sum, LUT ops, activation,
+// min/abs/neg) work on each half and stay packed; select and the bitwise ops
+// move the whole 32-bit lane. Type cast and compares have no BF16x2 form: the
+// line is rejected (all zeros, counted in rejected_lines).
+// output_format 1 after FP32 math rounds the result to BF16 on store; raw
+// (select/bitwise) results are stored as they are.
+void malu_datapath::execute_line(const decoded_sfr_t& cfg,
+                                 const sc_bv<2048>& aBits, const sc_bv<2048>& bBits,
+                                 sc_bv<2048>& outBits)
+{
+    cfg.apply_ops_context(ops);
+    execute_line(cfg, ops, aBits, bBits, outBits);
+}
+
+void malu_datapath::execute_line(const decoded_sfr_t& cfg, ops_context& ctx,
+                                 const sc_bv<2048>& aBits, const sc_bv<2048>& bBits,
+                                 sc_bv<2048>& outBits)
+{
+    ops_context_scope scope(ctx);
+    uint32_t a[MALU_LANES], b[MALU_LANES], out[MALU_LANES];
+    unpack_line(aBits, a);
+    unpack_line(bBits, b);
+
+    unsigned op      = cfg.operation.to_uint();
+    unsigned ext     = cfg.ext_op();
+    bool     packed  = (cfg.input_format==3);
+    bool     use_fp32= (cfg.input_format==0);
+    bool     use_bf16= (cfg.input_format==1) || packed;
+    bool     is_cmp  = (op==15) &&
+                       (ext==EXT_CMP_EQ || ext==EXT_CMP_LT || ext==EXT_CMP_LE);
+    bool     is_raw  = (op==15) && ext_is_raw(ext);
+    bool     is_dot  = packed && (op==2 || op==14);
+    bool     is_pair = packed && !is_dot && !is_raw && op!=12 && !is_cmp;
+    bool     to_bf16 = (use_fp32 || is_dot) && cfg.output_format==1 &&
+                       op!=12 && !is_cmp && !is_raw;
+
+    if(packed && (op==12 || is_cmp)) {
+        rejected_lines++;
+        advanceOpsStep();
+        outBits = 0;
+        return;
+    }
+    bool     pred    = cfg.predicated();
+    uint64_t new_mask= 0;
+
+    uint32_t a_lo[MALU_LANES], a_hi[MALU_LANES], b_lo[MALU_LANES], b_hi[MALU_LANES];
+    if(packed) {
+        split_bf16x2(a, a_lo, a_hi);
+        split_bf16x2(b, b_lo, b_hi);
+    }
+
+    for(int lane=0; lane<MALU_LANES; lane++){
+        sc_uint<32> result;
+        bool cmp_bit=false;
+        setOpsLane(lane);
+
+        if(is_dot) {
+            // a0*b0 + a1*b1 (+ scalar for FMA), products exact in FP32
+            sc_uint<32> acc= (op==14)? cfg.imm_scalar() : sc_uint<32>(0);
+            result= bf16_dot2_fp32_1c(a_lo[lane], a_hi[lane], b_lo[lane], b_hi[lane], acc);
+            if(cfg.fused_op==1 && op==14)
+                result= fp32_act_1c(result, cfg.act_func());
+        }
+        else if(is_pair) {
+            bool unused;
+            setOpsLane(2*lane);
+            sc_uint<32> lo= lane_op(cfg, a_lo[lane], b_lo[lane], lane, false, true, unused);
+            setOpsLane(2*lane+1);
+            sc_uint<32> hi= lane_op(cfg, a_hi[lane], b_hi[lane], lane, false, true, unused);
+            result= (hi.to_uint() & 0xFFFF0000u) | (lo.to_uint() >> 16);
+        }
+        else {
+            result= lane_op(cfg, a[lane], b[lane], lane, use_fp32, use_bf16, cmp_bit);
+        }
+        if(cmp_bit) new_mask |= (1ull << lane);
+
+        // predicated => inactive lanes keep A and never set a mask bit
+        if(pred && !((lane_mask >> lane) & 1)) {
+            result   = a[lane];
+            new_mask&= ~(1ull << lane);
+        }
+
+        if(to_bf16) {
+            setOpsLane(lane);
+            result= fp32_round_to_bf16(result);
+        }
+        out[lane]= result.to_uint();
+    }
+
+    advanceOpsStep();
+    pack_line(out, outBits);
+
+    // compares write the packed mask to the low 64 bits of the line
+    if(is_cmp) {
+        lane_mask= new_mask;
+        outBits  = 0;
+        outBits.range(63,0)= sc_uint<64>(new_mask);
+    }
+}
+
+// The pipeline thread
+// Reads instructions from i_npuc2malu and two lines from MRF into the operand
+// staging slots with the configuration and ops context they were issued with,
+// so a later SFR never changes how a staged line rounds. Does a 64-lane
+// single-cycle pass (execute_line) on the oldest slot, writes out results.
+// Each cycle first computes the oldest staged line, then stages the next one,
+// so a line staged in cycle t computes in t+1 while t+1 fetches the one after.
+// Operation 15 row macro-ops stream their own lines once the slots have
+// drained, see run_ext_op(); the other extended ops are single-line.
+void malu_funccore::pipeline_thread()
+{
+    dp.lane_mask= ~0ull;
+    stage_head  = 0;
+    stage_count = 0;
+    issue_ops   = ops_context();
+    sr_tags.clear();
+    wait();
+    while(true){
+        bool computed = false;
+
+        // 1) compute the oldest staged line
+        if(stage_count > 0) {
+            operand_slot& s = stage[stage_head];
+            bool is_lut = (s.cfg.operation>=5 && s.cfg.operation<=11);
+            if(!(is_lut && !lut_reqs.empty())) {   // table-driven op waits for its LUT
+                auto out_mrf= make_payload<malu2mrf_PTR>();
+                dp.execute_line(s.cfg, s.ops, s.a->data, s.b->data, out_mrf->data);
+                s.a = nullptr;
+                s.b = nullptr;
+                stage_head = (stage_head + 1) % MALU_STAGE_DEPTH;
+                stage_count--;
+                sstats.lines++;
+                computed = true;
 
-                auto out_mrf= std::make_shared<malu2mrf>();
-                out_mrf->data= outBits;
                 out_mrf->done=1;
                 o_malu2mrf.write(out_mrf);
 
-                auto out_npu= std::make_shared<malu2npuc>();
+                auto out_npu= make_payload<malu2npuc_PTR>();
                 out_npu->done=1;
                 o_malu2npuc.write(out_npu);
             }
         }
+
+        bool is_macro = (sfr_config.operation==15 && sfr_config.ext_op() < EXT_NUM_MACRO);
+        bool pending  = (i_npuc2malu.num_available()>0);
+        // an SFR sfr_decoder has not read yet configures the commands behind
+        // it, whichever of the two threads runs first at this edge
+        bool sfr_wait = (i_reg_map.num_available()>0);
+
+        // 2) row macro-ops bypass the staging slots
+        if(is_macro) {
+            if(pending && !sfr_wait && stage_count==0 && !computed) {
+                auto cmd_ptr = i_npuc2malu.read();
+                if(cmd_ptr->start==1) {
+                    // a tagged row starts at its tag's step, one step per output line
+                    sfr_config.apply_ops_context(issue_ops);
+                    if(!sr_tags.empty()) {
+                        issue_ops.sr_step = sr_tags.front();
+                        sr_tags.pop_front();
+                    }
+                    run_ext_op();
+                }
+                pending = false;
+            }
+        }
+        // 3) stage the next instruction's MRF lines into a free slot
+        else if(pending && !sfr_wait && stage_count < MALU_STAGE_DEPTH &&
+                i_mrf2malu[0].num_available()>0 &&
+                i_mrf2malu[1].num_available()>0)
+        {
+            auto cmd_ptr = i_npuc2malu.read();
+            if(cmd_ptr->start==1) {
+                operand_slot& s = stage[(stage_head + stage_count) % MALU_STAGE_DEPTH];
+                s.cfg = sfr_config;
+                sfr_config.apply_ops_context(issue_ops);
+                s.ops = issue_ops;
+                issue_ops.sr_step++;
+                if(!sr_tags.empty()) {
+                    s.ops.sr_step = sr_tags.front();
+                    sr_tags.pop_front();
+                }
+                s.a   = i_mrf2malu[0].read();
+                s.b   = i_mrf2malu[1].read();
+                stage_count++;
+            }
+        }
+
+        // exposed latency: nothing computed although an instruction is outstanding
+        if(!computed && (pending || stage_count > 0))
+            sstats.stall_cycles++;
         wait();
     }
 }
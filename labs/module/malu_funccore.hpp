@@ -5,23 +5,65 @@
  * Description: Declares the MALU functional core module. Contains threads:
  *              1) pipeline_thread for math ops
  *              2) sfr_decoder for reading _COMMON_REGISTERS
- *              3) lut_load_thread as a dummy for future LUT usage
+ *              3) lut_load_thread fetching LUTs from TCM into the resident tables
  **********/
 #pragma once
 #include <systemc.h>
+#include <cmath>
+#include <deque>
 #include "npucommon.hpp"
 #include "npudefine.hpp"
 #include "npu2malu.hpp"
 #include "malu2npuc.hpp"
 #include "mrf2malu.hpp"
 #include "malu2mrf.hpp"
+#include "tcm2malu.hpp"
+#include "malu2tcm.hpp"
+#include "payload_pool.hpp"
 #include "ops.hpp"
 #include "typecast_ops.hpp"
+#include "act_ops.hpp"
+#include "macro_ops.hpp"
+#include "logic_ops.hpp"
+#include "lut_cache.hpp"
 
 // new includes for the addresses + struct
 #include "common_register_addr.hpp"
 #include "common_register.hpp"
 
+// Extended ops (operation 15), selected by immediate[14:8]
+enum malu_ext_op {
+    EXT_SOFTMAX   = 0,  // row macro-op, 2 passes over port 0
+    EXT_RMSNORM   = 1,  // row macro-op, 2 passes over port 0, gamma on port 1
+    EXT_LAYERNORM = 2,  // row macro-op, 2 passes over port 0, gamma+beta on port 1
+    EXT_NUM_MACRO = 3,
+
+    // single-line ops on A (port 0) and B (port 1), same path as op 0..14
+    EXT_CMP_EQ    = 3,  // mask = A == B
+    EXT_CMP_LT    = 4,  // mask = A <  B
+    EXT_CMP_LE    = 5,  // mask = A <= B
+    EXT_SELECT    = 6,  // mask ? A : B
+    EXT_MIN       = 7,
+    EXT_ABS       = 8,  // |A|
+    EXT_NEG       = 9,  // -A
+    EXT_AND       = 10, // raw 32-bit lanes from here on
+    EXT_OR        = 11,
+    EXT_XOR       = 12,
+    EXT_SHL       = 13, // A << shift
+    EXT_SHR       = 14, // A >> shift, logical
+    EXT_SRA       = 15  // A >> shift, arithmetic
+};
+
+// Per macro-op cost, next to a lower bound for the same row done with
+// unfused single-line MALU instructions (one instruction per cycle,
+// cross-lane reductions as log2(64) steps, MRF round-trips not counted)
+struct macro_op_stats {
+    uint64_t calls          = 0;
+    uint64_t lines          = 0;
+    uint64_t cycles         = 0;
+    uint64_t unfused_cycles = 0;
+};
+
 // A local struct storing the simplified fields we need
 struct decoded_sfr_t {
     // from load_store
@@ -42,16 +84,102 @@ struct decoded_sfr_t {
     sc_uint<32> immediate_value;
     // from MODE_MATH
     sc_uint<4>  operation;
-    sc_uint<3>  input_format;
+    sc_uint<3>  input_format;   // 0=FP32, 1=BF16, 2=INT8, 3=BF16x2 packed
     sc_uint<3>  output_format;
     sc_uint<2>  operand_type;
     sc_uint<1>  fused_op;
     sc_uint<3>  rounding_mode;
     sc_uint<1>  saturation_enable;
 
+    // immediate_value layout used by the MALU ops:
+    //   [2:0]   activation select (op 13, or fused_op=1 after ADD/FMA)
+    //   [7:3]   norm epsilon = 2^-k (0 => 1e-5), or shift amount for EXT_SHL/SHR/SRA
+    //   [14:8]  extended sub-op (op 15)
+    //   [15]    predicated: lanes whose mask bit is 0 pass A through unchanged
+    //           (compares under a predicate clear those lanes' mask bits)
+    //   [31:16] BF16 scalar (FMA addend), same bits as an FP32 with a short mantissa;
+    //           for the row macro-ops, the row length in MRF lines
+    ActFunc     act_func()   const { return (ActFunc)(immediate_value.to_uint() & 0x7); }
+    unsigned    ext_op()     const { return (immediate_value.to_uint() >> 8) & 0x7F; }
+    bool        predicated() const { return (immediate_value.to_uint() >> 15) & 0x1; }
+    unsigned    shift_amt()  const { return (immediate_value.to_uint() >> 3) & 0x1F; }
+    sc_uint<32> imm_scalar() const { return immediate_value.to_uint() & 0xFFFF0000u; }
+    unsigned    row_lines()  const { unsigned n = immediate_value.to_uint() >> 16; return n ? n : 1; }
+    float       norm_eps()   const {
+        unsigned k = (immediate_value.to_uint() >> 3) & 0x1F;
+        return k ? std::ldexp(1.0f, -(int)k) : 1e-5f;
+    }
+
+    // copy the MALU fields out of the SFR block
+    void load(const _COMMON_REGISTERS& regs);
+    // set an ops context (ops.cpp) from the mode fields, the current one by
+    // default. Re-applying the same SR enable/seed keeps its step running.
+    void apply_ops_context(ops_context& ctx) const;
+    void apply_ops_context() const;
+
     void printHumanReadable() const;
 };
 
+/**
+ * The 64-lane single-line datapath and the state it reads: the lane mask
+ * written by compares and the resident LUTs. No SystemC process, so the
+ * cycle-accurate core and the TLM target (malu_tlm) run the same code.
+ */
+class malu_datapath {
+public:
+    malu_datapath();
+
+    // lane mask all ones, no LUT loaded, default ops context
+    void reset();
+
+    // One 64-lane pass over lines A and B (cfg and ctx are the configuration
+    // and the ops context the line was issued with). ctx is current for the
+    // pass and its SR step advances by one.
+    void execute_line(const decoded_sfr_t& cfg, ops_context& ctx,
+                      const sc_bv<2048>& aBits, const sc_bv<2048>& bBits,
+                      sc_bv<2048>& outBits);
+    // Same on this datapath's own context, cfg applied to it first
+    void execute_line(const decoded_sfr_t& cfg,
+                      const sc_bv<2048>& aBits, const sc_bv<2048>& bBits,
+                      sc_bv<2048>& outBits);
+
+    lut_cache      luts;
+    int            active_lut;     // slot used by ops 5..11, -1 => none loaded
+    uint64_t       lane_mask;      // bit per lane, written by compares, read by select/predication
+    uint64_t       rejected_lines; // BF16x2 lines with no packed form (cast, compares)
+    ops_context    ops;            // rounding context of this instance
+
+private:
+    sc_uint<32> lane_op(const decoded_sfr_t& cfg,
+                        sc_uint<32> valA, sc_uint<32> valB, int lane,
+                        bool use_fp32, bool use_bf16, bool& cmp_bit) const;
+
+    // single-line extended ops (compare/select/bitwise), one lane
+    sc_uint<32> ext_lane_op(const decoded_sfr_t& cfg, unsigned op,
+                            sc_uint<32> a, sc_uint<32> b, int lane,
+                            LaneType t, bool& cmp_bit) const;
+};
+
+// Line <-> lane helpers, one 32-bit range per lane
+void unpack_line(const sc_bv<2048>& bits, uint32_t (&lanes)[MALU_LANES]);
+void pack_line(const uint32_t (&lanes)[MALU_LANES], sc_bv<2048>& bits);
+
+// Two-deep operand staging in front of the single-line datapath: the MRF
+// lines of instruction N+1 are taken into a free slot while N computes.
+static const int MALU_STAGE_DEPTH = 2;
+
+struct operand_slot {
+    decoded_sfr_t cfg;   // configuration the instruction was issued with
+    ops_context   ops;   // its rounding context and SR step
+    mrf2malu_PTR  a;
+    mrf2malu_PTR  b;
+};
+
+struct stage_stats {
+    uint64_t lines        = 0;   // single-line instructions computed
+    uint64_t stall_cycles = 0;   // datapath idle with an instruction outstanding
+};
+
 class malu_funccore: public sc_core::sc_module {
 public:
     SC_HAS_PROCESS(malu_funccore);
@@ -65,10 +193,22 @@ public:
     sc_vector< sc_fifo_in<mrf2malu_PTR> > i_mrf2malu;
     sc_fifo_out<malu2mrf_PTR>  o_malu2mrf;
 
+    // LUT loads: read request to TCM, data back as beats of four 512-bit lines
+    sc_fifo_out<malu2tcm_PTR>  o_malu2tcm;
+    sc_vector< sc_fifo_in<tcm2malu_PTR> > i_tcm2malu;
+
     // Now we read a pointer to _COMMON_REGISTERS from i_reg_map
     sc_fifo_in< sfr_PTR > i_reg_map;
 
     void set_Id(int set_id);
+    // SR step of the next command (of the first output line of a row
+    // macro-op), for a dispatcher that spreads one command stream over
+    // several cores; untagged commands take the core's own count
+    void tag_sr_step(uint32_t step) { sr_tags.push_back(step); }
+    const macro_op_stats& get_macro_stats(malu_ext_op op) const { return macro_stats[op]; }
+    uint64_t get_lane_mask() const { return dp.lane_mask; }
+    const lut_stats& get_lut_stats() const { return dp.luts.stats(); }
+    const stage_stats& get_stage_stats() const { return sstats; }
 
 private:
     int id;
@@ -78,4 +218,37 @@ private:
     void pipeline_thread();
     void sfr_decoder();
     void lut_load_thread();
+
+    // single-line ops, lane mask and resident LUTs
+    malu_datapath  dp;
+
+    // row macro-ops, run from pipeline_thread
+    void run_ext_op();
+    void softmax_row();
+    void norm_row(bool rms);
+    mrf2malu_PTR wait_mrf_line(int port);
+    void tick();
+
+    macro_op_stats macro_stats[EXT_NUM_MACRO];
+    uint64_t       macro_cycles;   // cycles of the macro-op in flight
+
+    // operand staging, ring of MALU_STAGE_DEPTH slots
+    operand_slot   stage[MALU_STAGE_DEPTH];
+    int            stage_head;     // oldest staged instruction
+    int            stage_count;
+    stage_stats    sstats;
+    ops_context    issue_ops;      // sfr_config's context, SR step of the next issue
+    std::deque<uint32_t> sr_tags;  // steps from tag_sr_step(), one per command
+
+    // LUT loads into dp.luts. sfr_decoder queues a request when
+    // load_lut_enable is set, lut_load_thread serves them in order; ops 5..11
+    // stall while any is queued. A request that arrives during a TCM transfer
+    // waits its turn, so the last SFR's table is the one left active.
+    struct lut_request {
+        uint32_t base;
+        unsigned size;
+    };
+    std::deque<lut_request> lut_reqs;
+
+    void end_of_simulation();
 };
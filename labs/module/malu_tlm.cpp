@@ -0,0 +1,270 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: malu_tlm.cpp
+ * Description: Implements the loosely-timed MALU target. No SystemC process:
+ *              everything runs inside the initiator's b_transport call.
+ *              The annotated cycles follow the cycle-accurate pipeline:
+ *                SFR write          1 (sfr_decoder)
+ *                LUT miss           1 request + 1 per beat of 64 entries
+ *                n single lines     n + 1 (staged in t, computed in t+1)
+ *                softmax row of L   2L
+ *                RMSNorm row of L   2L + 1
+ *                LayerNorm row of L 3L + 1 (gamma and beta share port 1)
+ **********/
+#include "malu_tlm.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+malu_tlm::malu_tlm(sc_core::sc_module_name name, int id,
+                   const sc_core::sc_time& clk_period)
+  : sc_module(name)
+  , socket("socket")
+  , id(id)
+  , period(clk_period)
+  , lut_pending(false)
+{
+    socket.register_b_transport(this, &malu_tlm::b_transport);
+    socket.register_transport_dbg(this, &malu_tlm::transport_dbg);
+    dp.reset();
+}
+
+// Plane p, line l of an EXEC buffer of n lines per plane
+static const unsigned char* plane_line(const unsigned char* planes,
+                                       unsigned n, unsigned p, unsigned l)
+{
+    return planes + ((size_t)p*n + l) * MALU_TLM_LINE_BYTES;
+}
+
+static void load_lanes(const unsigned char* src, uint32_t (&lanes)[MALU_LANES])
+{
+    std::memcpy(lanes, src, MALU_TLM_LINE_BYTES);
+}
+
+void malu_tlm::b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay)
+{
+    uint64_t addr   = trans.get_address();
+    uint64_t cycles = 0;
+    tlm::tlm_response_status rs;
+
+    stats.transactions++;
+    if(trans.get_byte_enable_ptr() != nullptr) {
+        rs = tlm::TLM_BYTE_ENABLE_ERROR_RESPONSE;
+    }
+    else if(trans.get_streaming_width() < trans.get_data_length()) {
+        rs = tlm::TLM_BURST_ERROR_RESPONSE;
+    }
+    else if(addr >= MALU_TLM_RESULT) {
+        rs = (trans.get_command() == tlm::TLM_READ_COMMAND)
+           ? read_result(trans) : tlm::TLM_COMMAND_ERROR_RESPONSE;
+    }
+    else if(trans.get_command() != tlm::TLM_WRITE_COMMAND) {
+        rs = tlm::TLM_COMMAND_ERROR_RESPONSE;
+    }
+    else if(addr == MALU_TLM_SFR)  rs = write_sfr(trans, cycles);
+    else if(addr == MALU_TLM_LUT)  rs = write_lut(trans, cycles);
+    else if(addr == MALU_TLM_EXEC) rs = exec(trans, cycles);
+    else                           rs = tlm::TLM_ADDRESS_ERROR_RESPONSE;
+
+    if(rs != tlm::TLM_OK_RESPONSE)
+        stats.errors++;
+    stats.cycles += cycles;
+    delay += cycles * period;
+    trans.set_dmi_allowed(false);
+    trans.set_response_status(rs);
+}
+
+// Result reads without timing, for debuggers and checkers
+unsigned malu_tlm::transport_dbg(tlm::tlm_generic_payload& trans)
+{
+    if(trans.get_command() != tlm::TLM_READ_COMMAND ||
+       trans.get_address() < MALU_TLM_RESULT)
+        return 0;
+    return read_result(trans) == tlm::TLM_OK_RESPONSE ? trans.get_data_length() : 0;
+}
+
+// Same decode as sfr_decoder, into this target's own ops context: the SR step
+// restarts only when the SFR changes the SR enable or seed, and otherwise
+// runs on across EXEC batches. A LUT request hits or misses here, like in
+// lut_load_thread; a miss waits for the table on MALU_TLM_LUT.
+tlm::tlm_response_status malu_tlm::write_sfr(tlm::tlm_generic_payload& trans, uint64_t& cycles)
+{
+    if(trans.get_data_length() != sizeof(_COMMON_REGISTERS))
+        return tlm::TLM_BURST_ERROR_RESPONSE;
+
+    cfg.load(*reinterpret_cast<const _COMMON_REGISTERS*>(trans.get_data_ptr()));
+    cfg.apply_ops_context(dp.ops);
+    cycles = 1;
+
+    if(cfg.load_lut_enable==1) {
+        int slot = dp.luts.find(cfg.lut_base_addr.to_uint(), cfg.lut_size.to_uint());
+        lut_pending   = (slot < 0);
+        dp.active_lut = slot;
+    }
+    return tlm::TLM_OK_RESPONSE;
+}
+
+tlm::tlm_response_status malu_tlm::write_lut(tlm::tlm_generic_payload& trans, uint64_t& cycles)
+{
+    if(!lut_pending)
+        return tlm::TLM_OK_RESPONSE;   // resident, nothing to fetch
+
+    uint32_t base  = cfg.lut_base_addr.to_uint();
+    unsigned size  = cfg.lut_size.to_uint();
+    unsigned n     = lut_cache::entries(size);
+    unsigned beats = lut_cache::beats(n);
+    if(trans.get_data_length() != n*4)
+        return tlm::TLM_BURST_ERROR_RESPONSE;
+
+    uint32_t entries[LUT_MAX_ENTRIES] = {};
+    std::memcpy(entries, trans.get_data_ptr(), n*4);
+
+    int slot = dp.luts.allocate(base, size);
+    for(unsigned b=0; b<beats; b++){
+        for(int l=0; l<LUT_LINES_PER_BEAT; l++){
+            sc_bv<512> line = 0;
+            for(int e=0; e<LUT_ENTRIES_PER_LINE; e++){
+                unsigned idx = b*LUT_ENTRIES_PER_BEAT + l*LUT_ENTRIES_PER_LINE + e;
+                if(idx < n)
+                    line.range(e*32+31, e*32) = entries[idx];
+            }
+            dp.luts.fill(slot, b, l, line);
+        }
+    }
+    dp.luts.commit(slot);
+    dp.active_lut = slot;
+    lut_pending   = false;
+    cycles        = 1 + beats;
+    return tlm::TLM_OK_RESPONSE;
+}
+
+tlm::tlm_response_status malu_tlm::exec(tlm::tlm_generic_payload& trans, uint64_t& cycles)
+{
+    bool     macro  = (cfg.operation==15 && cfg.ext_op() < EXT_NUM_MACRO);
+    unsigned op     = cfg.ext_op();
+    unsigned planes = !macro                ? 2
+                    : (op==EXT_SOFTMAX)     ? 1
+                    : (op==EXT_RMSNORM)     ? 2 : 3;
+    unsigned len    = trans.get_data_length();
+    if(len == 0 || len % (planes*MALU_TLM_LINE_BYTES) != 0)
+        return tlm::TLM_BURST_ERROR_RESPONSE;
+
+    unsigned n = len / (planes*MALU_TLM_LINE_BYTES);
+    if(macro && n % cfg.row_lines() != 0)
+        return tlm::TLM_BURST_ERROR_RESPONSE;
+    if((cfg.operation>=5 && cfg.operation<=11) && lut_pending)
+        return tlm::TLM_GENERIC_ERROR_RESPONSE;   // table never written
+
+    // the macro-ops round with this target's context too
+    ops_context_scope scope(dp.ops);
+    results.resize(n);
+
+    const unsigned char* data = trans.get_data_ptr();
+    if(!macro)                    cycles = run_lines(data, n);
+    else if(op==EXT_SOFTMAX)      cycles = run_softmax(data, n);
+    else                          cycles = run_norm(data, n, op==EXT_RMSNORM);
+
+    stats.batches++;
+    stats.lines += n;
+    return tlm::TLM_OK_RESPONSE;
+}
+
+tlm::tlm_response_status malu_tlm::read_result(tlm::tlm_generic_payload& trans)
+{
+    uint64_t off = trans.get_address() - MALU_TLM_RESULT;
+    unsigned len = trans.get_data_length();
+    if(off + len > results.size() * (uint64_t)MALU_TLM_LINE_BYTES)
+        return tlm::TLM_ADDRESS_ERROR_RESPONSE;
+
+    unsigned char* dst = trans.get_data_ptr();
+    uint32_t lanes[MALU_LANES];
+    while(len > 0) {
+        unsigned line = off / MALU_TLM_LINE_BYTES;
+        unsigned in   = off % MALU_TLM_LINE_BYTES;
+        unsigned cnt  = std::min(len, MALU_TLM_LINE_BYTES - in);
+        unpack_line(results[line], lanes);
+        std::memcpy(dst, reinterpret_cast<const unsigned char*>(lanes) + in, cnt);
+        dst += cnt;
+        off += cnt;
+        len -= cnt;
+    }
+    return tlm::TLM_OK_RESPONSE;
+}
+
+// Single-line ops: A from plane 0, B from plane 1
+uint64_t malu_tlm::run_lines(const unsigned char* planes, unsigned n)
+{
+    uint32_t lanes[MALU_LANES];
+    sc_bv<2048> a, b;
+    for(unsigned l=0; l<n; l++){
+        load_lanes(plane_line(planes, n, 0, l), lanes);
+        pack_line(lanes, a);
+        load_lanes(plane_line(planes, n, 1, l), lanes);
+        pack_line(lanes, b);
+        dp.execute_line(cfg, a, b, results[l]);
+    }
+    return n + 1;
+}
+
+// Softmax over each row of row_lines() lines of plane 0
+uint64_t malu_tlm::run_softmax(const unsigned char* planes, unsigned n)
+{
+    unsigned row  = cfg.row_lines();
+    bool     bf16 = (cfg.input_format==1);
+    uint32_t in[MALU_LANES], out[MALU_LANES];
+
+    for(unsigned r=0; r<n; r+=row){
+        softmax_state st;
+        st.reset();
+        for(unsigned l=r; l<r+row; l++){
+            load_lanes(plane_line(planes, n, 0, l), in);
+            st.accumulate(in, bf16);
+        }
+        for(unsigned l=r; l<r+row; l++){
+            load_lanes(plane_line(planes, n, 0, l), in);
+            st.normalize(in, out, bf16);
+            pack_line(out, results[l]);
+        }
+    }
+    return 2ull*n;
+}
+
+// RMSNorm / LayerNorm over each row of plane 0, gamma (and beta) per line
+uint64_t malu_tlm::run_norm(const unsigned char* planes, unsigned n, bool rms)
+{
+    unsigned row  = cfg.row_lines();
+    bool     bf16 = (cfg.input_format==1);
+    uint32_t in[MALU_LANES], gamma[MALU_LANES], beta[MALU_LANES], out[MALU_LANES];
+
+    for(unsigned r=0; r<n; r+=row){
+        norm_state st;
+        st.reset();
+        for(unsigned l=r; l<r+row; l++){
+            load_lanes(plane_line(planes, n, 0, l), in);
+            st.accumulate(in, bf16);
+        }
+        st.finalize(rms, cfg.norm_eps());
+        for(unsigned l=r; l<r+row; l++){
+            load_lanes(plane_line(planes, n, 0, l), in);
+            load_lanes(plane_line(planes, n, 1, l), gamma);
+            if(!rms)
+                load_lanes(plane_line(planes, n, 2, l), beta);
+            st.apply(in, gamma, rms ? nullptr : beta, out, bf16);
+            pack_line(out, results[l]);
+        }
+    }
+    uint64_t nrows = n / row;
+    return rms ? 2ull*n + nrows : 3ull*n + nrows;
+}
+
+void malu_tlm::end_of_simulation()
+{
+    if(stats.transactions == 0)
+        return;
+    std::cout << "[MALU TLM " << id << "] transactions=" << stats.transactions
+              << " batches=" << stats.batches
+              << " lines=" << stats.lines
+              << " cycles=" << stats.cycles
+              << " errors=" << stats.errors << std::endl;
+}
@@ -0,0 +1,84 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: malu_tlm.hpp
+ * Description: Loosely-timed TLM-2.0 target for the MALU. One b_transport
+ *              runs a whole batch of lines on malu_datapath, the code the
+ *              cycle-accurate malu runs, and adds the cycles that pipeline
+ *              would have taken to the delay without calling wait(). The
+ *              initiator keeps local time with a tlm_quantumkeeper, so a
+ *              batch costs no context switch.
+ *
+ *              Address map (byte addresses):
+ *                MALU_TLM_SFR     write  one _COMMON_REGISTERS, data_ptr
+ *                                        points at the struct
+ *                MALU_TLM_LUT     write  FP32 entries of the table the last
+ *                                        SFR asked for (lut_base_addr,
+ *                                        lut_size); stands in for the TCM fetch
+ *                                        and is ignored if that table is resident
+ *                MALU_TLM_EXEC    write  operand planes of n lines each:
+ *                                        A (x), then B (gamma), then beta;
+ *                                        2 planes for single-line ops,
+ *                                        1 for softmax, 2 for RMSNorm,
+ *                                        3 for LayerNorm
+ *                MALU_TLM_RESULT  read   result lines of the last EXEC,
+ *                                        from byte offset addr-MALU_TLM_RESULT
+ *              A line is 64 lanes of 32 bits, lane i in bytes 4i..4i+3.
+ **********/
+#pragma once
+#include <systemc>
+#include <tlm>
+#include <tlm_utils/simple_target_socket.h>
+#include <vector>
+#include "malu_funccore.hpp"
+
+static const uint64_t MALU_TLM_SFR    = 0x00000;
+static const uint64_t MALU_TLM_LUT    = 0x01000;
+static const uint64_t MALU_TLM_EXEC   = 0x02000;
+static const uint64_t MALU_TLM_RESULT = 0x10000;
+
+static const unsigned MALU_TLM_LINE_BYTES = MALU_LANES * 4;
+
+struct malu_tlm_stats {
+    uint64_t transactions = 0;
+    uint64_t batches      = 0;   // EXEC writes
+    uint64_t lines        = 0;   // output lines computed
+    uint64_t cycles       = 0;   // annotated, in MALU clocks
+    uint64_t errors       = 0;   // transactions answered with an error
+};
+
+class malu_tlm: public sc_core::sc_module {
+public:
+    tlm_utils::simple_target_socket<malu_tlm> socket;
+
+    malu_tlm(sc_core::sc_module_name name, int id,
+             const sc_core::sc_time& clk_period = sc_core::sc_time(10, sc_core::SC_NS));
+
+    const malu_tlm_stats& get_stats() const { return stats; }
+    uint64_t get_lane_mask() const { return dp.lane_mask; }
+    const lut_stats& get_lut_stats() const { return dp.luts.stats(); }
+
+private:
+    void     b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay);
+    unsigned transport_dbg(tlm::tlm_generic_payload& trans);
+
+    // one handler per region, each returns the MALU cycles it took
+    tlm::tlm_response_status write_sfr(tlm::tlm_generic_payload& trans, uint64_t& cycles);
+    tlm::tlm_response_status write_lut(tlm::tlm_generic_payload& trans, uint64_t& cycles);
+    tlm::tlm_response_status exec(tlm::tlm_generic_payload& trans, uint64_t& cycles);
+    tlm::tlm_response_status read_result(tlm::tlm_generic_payload& trans);
+
+    uint64_t run_lines(const unsigned char* planes, unsigned n);
+    uint64_t run_softmax(const unsigned char* planes, unsigned n);
+    uint64_t run_norm(const unsigned char* planes, unsigned n, bool rms);
+
+    int              id;
+    sc_core::sc_time period;
+    decoded_sfr_t    cfg;
+    malu_datapath    dp;
+    bool             lut_pending;    // last SFR asked for a table that is not resident
+    std::vector< sc_bv<2048> > results;
+    malu_tlm_stats   stats;
+
+    void end_of_simulation();
+};
@@ -2,11 +2,11 @@
  * Author: Abcd at abcd
  * Project: Project name
  * File: ops.cpp
- * Description: Implements single‐cycle FP32 and BF16 arithmetic operations 
- *              (Add, Sub, Mul). It restores the hidden 1 from normalized numbers,
- *              aligns significands correctly, and then “drops” the implicit bit 
- *              (rather than doing an extra shift) to produce the correct 23‐bit fraction.
- *              Debug mode prints internal values when DEBUG_MODE is enabled.
+ * Description: Implements single-cycle FP32 and BF16 arithmetic operations
+ *              (Add, Sub, Mul) on one shared round/pack path: the exact result
+ *              is rounded once, with guard and sticky bits, as IEEE 754 does.
+ *              Debug mode prints every FP32 result; build with
+ *              -DOPS_DEBUG_MODE=1 to enable it.
  **********/
 
  #include "ops.hpp"
@@ -16,23 +16,89 @@
  //---------------------------------------------------------------------
  // Debug mode flag
  //---------------------------------------------------------------------
- static const bool DEBUG_MODE = true;
+ #ifndef OPS_DEBUG_MODE
+ #define OPS_DEBUG_MODE 0
+ #endif
+ static const bool DEBUG_MODE = (OPS_DEBUG_MODE != 0);
  
  //---------------------------------------------------------------------
- // Global context for math operations control
+ // Current context for math operations control: each OS thread starts on
+ // its own default, ops_context_scope switches it
  //---------------------------------------------------------------------
- static struct {
-     bool enable_subnorm;
-     bool enable_trunc;
-     bool enable_clamp;
-     bool enable_except;
- } g_ops;
- 
+ static thread_local ops_context  g_default_ops;
+ static thread_local ops_context* g_ops = &g_default_ops;
+
+ ops_context& currentOpsContext() {
+     return *g_ops;
+ }
+
+ ops_context_scope::ops_context_scope(ops_context& ctx) : prev_(g_ops) {
+     g_ops = &ctx;
+ }
+
+ ops_context_scope::~ops_context_scope() {
+     g_ops = prev_;
+ }
+
  void setOpsContext(bool subnorm, bool trunc, bool clamp, bool except) {
-     g_ops.enable_subnorm = subnorm;
-     g_ops.enable_trunc   = trunc;
-     g_ops.enable_clamp   = clamp;
-     g_ops.enable_except  = except;
+     g_ops->enable_subnorm = subnorm;
+     g_ops->enable_trunc   = trunc;
+     g_ops->enable_clamp   = clamp;
+     g_ops->enable_except  = except;
+ }
+ 
+ // ---------------------- STOCHASTIC ROUNDING ----------------------
+ 
+ // lowbias32 integer hash: full avalanche, no carried state
+ static inline uint32_t sr_hash(uint32_t x) {
+     x ^= x >> 16;
+     x *= 0x7feb352dU;
+     x ^= x >> 15;
+     x *= 0x846ca68bU;
+     x ^= x >> 16;
+     return x;
+ }
+ 
+ void setOpsStochastic(bool enable, uint32_t seed) {
+     g_ops->enable_stochastic = enable;
+     g_ops->sr_key  = sr_hash(seed ^ 0x9E3779B9U);
+     g_ops->sr_step = 0;
+     g_ops->sr_lane = 0;
+ }
+ 
+ void updateOpsStochastic(bool enable, uint32_t seed) {
+     uint32_t key = sr_hash(seed ^ 0x9E3779B9U);
+     if(enable == g_ops->enable_stochastic && key == g_ops->sr_key)
+         return;
+     setOpsStochastic(enable, seed);
+ }
+
+ void setOpsLane(uint32_t lane) {
+     g_ops->sr_lane = lane;
+ }
+ 
+ void advanceOpsStep() {
+     g_ops->sr_step++;
+ }
+ 
+ // splitmix64 finalizer: a bijection on 64 bits
+ static inline uint64_t sr_mix64(uint64_t x) {
+     x ^= x >> 30;
+     x *= 0xBF58476D1CE4E5B9ULL;
+     x ^= x >> 27;
+     x *= 0x94D049BB133111EBULL;
+     x ^= x >> 31;
+     return x;
+ }
+
+ uint32_t opsStochasticBits() {
+     if(!g_ops->enable_stochastic)
+         return 0;
+     // step and lane each keep their own 32 bits, so no lane index (BF16x2
+     // pairs use 0..127) can alias another step; the key is folded in before
+     // the bijective mix
+     uint64_t ctr = ((uint64_t)g_ops->sr_step << 32) | g_ops->sr_lane;
+     return (uint32_t)(sr_mix64(ctr ^ ((uint64_t)g_ops->sr_key * 0x9E3779B97F4A7C15ULL)) >> 32);
  }
  
  // ---------------------- FP32 HELPER FUNCTIONS ----------------------
@@ -44,256 +110,256 @@
      m = val.range(22,0);
  }
  
- // encode_fp32: combines sign, exponent, and mantissa into a 32‐bit value.
- static sc_uint<32> encode_fp32(sc_uint<1> s, sc_uint<8> e, sc_uint<23> m) {
-     sc_uint<32> out = 0;
-     out[31] = s;
-     out.range(30,23) = e;
-     out.range(22,0) = m;
-     return out;
+ // ---------------------- SHARED ROUND / PACK ----------------------
+ //
+ // Add, sub and mul of both formats share one datapath. A format is its
+ // fraction width MB (FP32 23, BF16 7); a BF16 lane is shifted down by 16
+ // on the way in and back up on the way out. Operands are unpacked to
+ // (sign, biased exponent, significand with the hidden bit at MB), the
+ // exact result is formed in a 64-bit working significand with the hidden
+ // bit at FP_W, and rounded once:
+ //  - to nearest even, or toward zero with enableTrunc
+ //  - subnormals: gradual underflow with enableSubnorm, otherwise subnormal
+ //    operands read as zero and results below the smallest normal flush to zero
+ //  - overflow: Inf, or the largest finite value with enableClamp
+ //    (and always when truncating, as round-toward-zero does)
+ //  - NaN/Inf operands follow IEEE 754, NaN results are the quiet NaN
+ //
+ // fp_parts, FP_W and the helpers below are declared in ops.hpp for the
+ // units that split this datapath into pipeline stages.
+
+ uint32_t fp_pack(uint32_t s, uint32_t e, uint32_t f, int MB) {
+     return (s << (MB + 8)) | (e << MB) | f;
  }
- 
- static bool is_fp32_inf(sc_uint<8> e, sc_uint<23> m) {
-     return (e == 255 && m == 0);
+
+ uint32_t fp_qnan(int MB) {
+     return fp_pack(0, 255, 1u << (MB - 1), MB);
  }
- static bool is_fp32_nan(sc_uint<8> e, sc_uint<23> m) {
-     return (e == 255 && m != 0);
+
+ fp_parts fp_unpack(uint32_t v, int MB) {
+     fp_parts p;
+     uint32_t f = v & ((1u << MB) - 1);
+     p.sign = (v >> (MB + 8)) & 1;
+     p.exp  = (v >> MB) & 0xFF;
+     p.nan  = (p.exp == 255 && f != 0);
+     p.inf  = (p.exp == 255 && f == 0);
+     if(p.exp == 0) {
+         p.exp = 1;                                   // 0.f * 2^(1-bias)
+         p.sig = g_ops->enable_subnorm ? f : 0;
+     } else {
+         p.sig = (uint64_t)f | (1ull << MB);
+     }
+     return p;
  }
- static bool is_fp32_subnormal(sc_uint<8> e, sc_uint<23> m) {
-     return (e == 0 && m != 0);
+
+ // Right shift keeping a sticky bit for everything shifted out
+ uint64_t shr_sticky(uint64_t v, int n) {
+     if(n <= 0)  return v;
+     if(n >= 64) return v != 0;
+     return (v >> n) | ((v & ((1ull << n) - 1)) != 0);
  }
- 
- static void clamp_exponent_fp32(sc_uint<8>& e, sc_uint<23>& m) {
-     if(e > 254) {
-         e = 254;
-         m = (1 << 23) - 1;
+
+ // Round and pack sig * 2^(exp - 127 - FP_W), sig != 0
+ uint32_t fp_round_pack(uint32_t sign, int exp, uint64_t sig, int MB) {
+     int msb = 63 - __builtin_clzll(sig);
+     if(msb > FP_W) { sig = shr_sticky(sig, msb - FP_W); exp += msb - FP_W; }
+     else           { sig <<= (FP_W - msb);              exp -= FP_W - msb; }
+
+     if(exp <= 0) {
+         if(!g_ops->enable_subnorm)
+             return fp_pack(sign, 0, 0, MB);
+         sig = shr_sticky(sig, 1 - exp);            // subnormal: 0.f * 2^(1-bias)
+         exp = 0;
      }
+
+     const int G    = FP_W - MB;
+     uint64_t  rem  = sig & ((1ull << G) - 1);
+     uint64_t  half = 1ull << (G - 1);
+     sig >>= G;
+     if(!g_ops->enable_trunc && (rem > half || (rem == half && (sig & 1))))
+         sig++;
+
+     if(exp == 0) {
+         if(sig >> MB) exp = 1;                      // rounded up to the smallest normal
+     } else if(sig >> (MB + 1)) {
+         sig >>= 1;                                  // 1.11..1 rounded up to 10.0
+         exp++;
+     }
+     if(exp >= 255) {
+         if(g_ops->enable_clamp || g_ops->enable_trunc)
+             return fp_pack(sign, 254, (1u << MB) - 1, MB);
+         return fp_pack(sign, 255, 0, MB);
+     }
+     return fp_pack(sign, exp, (uint32_t)sig & ((1u << MB) - 1), MB);
  }
- 
- /**
-  * finalize_round_fp32:
-  * Given a 25-bit accumulator (sum) which is known to be in the range
-  * [1<<23, 1<<24) (i.e., the implicit 1 is in position 23), the result’s
-  * stored fraction is simply sum – (1<<23). (A more sophisticated routine
-  * could use guard, round, and sticky bits, but here we assume ideal inputs.)
-  */
- static sc_uint<23> finalize_round_fp32(sc_uint<25> sum) {
-     // For our purposes, simply subtract the implicit 1.
-     return sum - (1 << 23);
+
+ static uint32_t fp_add(uint32_t a, uint32_t b, int MB) {
+     fp_parts x = fp_unpack(a, MB);
+     fp_parts y = fp_unpack(b, MB);
+
+     if(x.nan || y.nan)
+         return fp_qnan(MB);
+     if(x.inf || y.inf) {
+         if(x.inf && y.inf && x.sign != y.sign)
+             return fp_qnan(MB);                     // Inf - Inf
+         return fp_pack(x.inf ? x.sign : y.sign, 255, 0, MB);
+     }
+     if(x.sig == 0 && y.sig == 0)
+         return fp_pack(x.sign & y.sign, 0, 0, MB);  // -0 only for -0 + -0
+
+     // x gets the larger magnitude
+     if(x.exp < y.exp || (x.exp == y.exp && x.sig < y.sig)) {
+         fp_parts t = x; x = y; y = t;
+     }
+     uint64_t bx = x.sig << (FP_W - MB);
+     uint64_t by = shr_sticky(y.sig << (FP_W - MB), x.exp - y.exp);
+     uint64_t sum;
+     if(x.sign == y.sign) {
+         sum = bx + by;
+     } else {
+         sum = bx - by;
+         if(sum == 0)
+             return fp_pack(0, 0, 0, MB);            // exact cancellation => +0
+     }
+     return fp_round_pack(x.sign, x.exp, sum, MB);
  }
- 
+
+ static uint32_t fp_mul(uint32_t a, uint32_t b, int MB) {
+     fp_parts x = fp_unpack(a, MB);
+     fp_parts y = fp_unpack(b, MB);
+     uint32_t sign = x.sign ^ y.sign;
+
+     if(x.nan || y.nan)
+         return fp_qnan(MB);
+     if(x.inf || y.inf) {
+         if((x.inf && y.sig == 0 && !y.inf) || (y.inf && x.sig == 0 && !x.inf))
+             return fp_qnan(MB);                     // Inf * 0
+         return fp_pack(sign, 255, 0, MB);
+     }
+     if(x.sig == 0 || y.sig == 0)
+         return fp_pack(sign, 0, 0, MB);
+
+     // product has its hidden bit at 2*MB (or 2*MB+1)
+     uint64_t prod = x.sig * y.sig;
+     return fp_round_pack(sign, x.exp + y.exp - 127 - 2*MB + FP_W, prod, MB);
+ }
+
+ // a*b + c rounded once. The exact product (up to 2*MB+2 bits) and c are
+ // both moved to their msb at FP_W, so aligning the smaller one only
+ // drops bits far below the rounding point into the sticky bit.
+ static uint32_t fp_fma(uint32_t a, uint32_t b, uint32_t c, int MB) {
+     fp_parts x = fp_unpack(a, MB);
+     fp_parts y = fp_unpack(b, MB);
+     fp_parts z = fp_unpack(c, MB);
+     uint32_t sign = x.sign ^ y.sign;
+
+     if(x.nan || y.nan || z.nan)
+         return fp_qnan(MB);
+     if((x.inf && y.sig == 0 && !y.inf) || (y.inf && x.sig == 0 && !x.inf))
+         return fp_qnan(MB);                         // Inf * 0
+     if(x.inf || y.inf || z.inf) {
+         bool pinf = x.inf || y.inf;
+         if(pinf && z.inf && sign != z.sign)
+             return fp_qnan(MB);                     // Inf - Inf
+         return fp_pack(pinf ? sign : z.sign, 255, 0, MB);
+     }
+     if(x.sig == 0 || y.sig == 0) {
+         if(z.sig == 0)
+             return fp_pack(sign & z.sign, 0, 0, MB); // -0 only for -0 + -0
+         return fp_round_pack(z.sign, z.exp - MB + FP_W, z.sig, MB);
+     }
+
+     // both as sig * 2^(exp - 127 - FP_W)
+     uint64_t ps = x.sig * y.sig;
+     int      pe = x.exp + y.exp - 127 - 2*MB + FP_W;
+     if(z.sig == 0)
+         return fp_round_pack(sign, pe, ps, MB);
+     int pm = 63 - __builtin_clzll(ps);
+     int zm = 63 - __builtin_clzll(z.sig);
+     uint64_t bp = ps << (FP_W - pm);
+     uint64_t bz = z.sig << (FP_W - zm);
+     pe -= FP_W - pm;
+     int      ze = z.exp - MB + zm;
+
+     // bp gets the larger magnitude, and its sign is the result's
+     bool same = (sign == z.sign);
+     if(pe < ze || (pe == ze && bp < bz)) {
+         uint64_t tb = bp; bp = bz; bz = tb;
+         int      te = pe; pe = ze; ze = te;
+         sign = z.sign;
+     }
+     bz = shr_sticky(bz, pe - ze);
+     uint64_t sum;
+     if(same) {
+         sum = bp + bz;
+     } else {
+         sum = bp - bz;
+         if(sum == 0)
+             return fp_pack(0, 0, 0, MB);            // exact cancellation => +0
+     }
+     return fp_round_pack(sign, pe, sum, MB);
+ }
+
  // ---------------------- FP32 ADD ----------------------
  sc_uint<32> fp32_add_1c(sc_uint<32> a, sc_uint<32> b)
  {
-     sc_uint<1> sA, sB;
-     sc_uint<8> eA, eB;
-     sc_uint<23> mA, mB;
-     decode_fp32(a, sA, eA, mA);
-     decode_fp32(b, sB, eB, mB);
- 
-     if(g_ops.enable_except) {
-         if(is_fp32_nan(eA, mA) || is_fp32_nan(eB, mB))
-             return encode_fp32(0,255,1);
-         if(is_fp32_inf(eA, mA)) return a;
-         if(is_fp32_inf(eB, mB)) return b;
-     }
- 
-     if(g_ops.enable_subnorm) {
-         if(is_fp32_subnormal(eA, mA))
-             eA = 1;
-         if(is_fp32_subnormal(eB, mB))
-             eB = 1;
-     }
- 
-     // If the signs differ, subtraction must be done.
-     if(sA != sB)
-         return fp32_sub_1c(a, b);
- 
-     sc_uint<8> eMax = (eA > eB) ? eA : eB;
-     sc_uint<8> eMin = (eA > eB) ? eB : eA;
- 
-     // Restore hidden bit: each normalized number is 1.mantissa
-     sc_uint<24> bigM = (1 << 23) | ((eA > eB) ? mA : mB);
-     sc_uint<24> smlM = (1 << 23) | ((eA > eB) ? mB : mA);
- 
-     sc_uint<8> diff = eMax - eMin;
-     // Right shift the smaller significand
-     sc_uint<24> alignedSml = smlM >> diff;
- 
-     // Add the two 24-bit significands in a 25-bit accumulator.
-     sc_uint<25> sumVal = (sc_uint<25>)bigM + (sc_uint<25>)alignedSml;
-     
-     // If a carry-out occurred, our accumulator is in [1<<24, 2<<23)
-     // Our algorithm in the caller already normalizes the result if needed.
-     // For our ideal inputs, no extra shift is needed.
-     
-     // Now, the stored fraction for the final result is:
-     sc_uint<23> finalMant = finalize_round_fp32(sumVal);
-     if(g_ops.enable_clamp)
-         clamp_exponent_fp32(eMax, finalMant);
-     
-     sc_uint<32> result = encode_fp32(sA, eMax, finalMant);
-     
+     sc_uint<32> result = fp_add(a.to_uint(), b.to_uint(), 23);
+
      if(DEBUG_MODE) {
-         std::cout << "[FP32 ADD] a=0x" << std::hex << a 
-                   << ", b=0x" << b 
-                   << ", sumVal=0x" << sumVal.to_uint()
-                   << ", finalMant=0x" << finalMant 
-                   << ", result=0x" << result 
+         std::cout << "[FP32 ADD] a=0x" << std::hex << a
+                   << ", b=0x" << b
+                   << ", result=0x" << result
                    << std::dec << std::endl;
      }
-     
      return result;
  }
- 
+
  // ---------------------- FP32 SUB ----------------------
- /*
-  * fp32_sub_1c: Subtraction is performed by comparing the magnitudes.
-  * We decode both numbers, determine which is larger,
-  * align the smaller to the larger, subtract, then normalize the result.
-  */
+ // a - b is a + (-b), rounded once
  sc_uint<32> fp32_sub_1c(sc_uint<32> a, sc_uint<32> b)
  {
-     // First, decode both numbers.
-     sc_uint<1> sA, sB;
-     sc_uint<8> eA, eB;
-     sc_uint<23> mA, mB;
-     decode_fp32(a, sA, eA, mA);
-     decode_fp32(b, sB, eB, mB);
- 
-     // If the sign bits differ, use addition.
-     if(sA != sB) {
-         sc_uint<32> bNeg = b;
-         bNeg[31] = ~b[31];
-         return fp32_add_1c(a, bNeg);
-     }
- 
-     // Determine the operand with the larger magnitude.
-     bool aGreater;
-     if(eA > eB)
-         aGreater = true;
-     else if(eA < eB)
-         aGreater = false;
-     else
-         aGreater = (mA >= mB);
-     
-     sc_uint<1> resultSign = aGreater ? sA : sB;
-     // Restore implicit 1:
-     sc_uint<24> manA = (1 << 23) | mA;
-     sc_uint<24> manB = (1 << 23) | mB;
-     
-     sc_uint<8> expLarger, expSmaller;
-     sc_uint<24> manLarger, manSmaller;
-     if(aGreater) {
-         expLarger = eA;
-         expSmaller = eB;
-         manLarger = manA;
-         manSmaller = manB;
-     } else {
-         expLarger = eB;
-         expSmaller = eA;
-         manLarger = manB;
-         manSmaller = manA;
-     }
-     
-     // Align the smaller significand.
-     sc_uint<8> diff = expLarger - expSmaller;
-     sc_uint<24> alignedSmaller = manSmaller >> diff;
-     
-     // Subtract the smaller from the larger.
-     int diffMant = (int)manLarger - (int)alignedSmaller;
-     if(diffMant < 0) diffMant = 0;  // ensure non-negative
-     sc_uint<24> diffVal = diffMant;
-     
-     // Normalize: shift left until the implicit 1 is in bit 23.
-     sc_uint<8> resultExp = expLarger;
-     while(resultExp > 0 && diffVal[23] == 0) {
-         diffVal <<= 1;
-         resultExp--;
-     }
-     
-     // In FP subtraction, no extra rounding (for now) is used.
-     // The stored fraction is diffVal minus the hidden bit.
-     sc_uint<23> finalMant = diffVal - (1 << 23);
-     if(g_ops.enable_clamp)
-         clamp_exponent_fp32(resultExp, finalMant);
-     
-     sc_uint<32> result = encode_fp32(resultSign, resultExp, finalMant);
-     
+     sc_uint<32> result = fp_add(a.to_uint(), b.to_uint() ^ 0x80000000u, 23);
+
      if(DEBUG_MODE) {
-         std::cout << "[FP32 SUB] a=0x" << std::hex << a 
-                   << ", b=0x" << b 
-                   << ", result=0x" << result 
+         std::cout << "[FP32 SUB] a=0x" << std::hex << a
+                   << ", b=0x" << b
+                   << ", result=0x" << result
                    << std::dec << std::endl;
      }
-     
      return result;
  }
- 
+
  // ---------------------- FP32 MUL ----------------------
  sc_uint<32> fp32_mul_1c(sc_uint<32> a, sc_uint<32> b)
  {
-     sc_uint<1> sA, sB;
-     sc_uint<8> eA, eB;
-     sc_uint<23> mA, mB;
-     decode_fp32(a, sA, eA, mA);
-     decode_fp32(b, sB, eB, mB);
-     sc_uint<1> outSign = sA ^ sB;
-     
-     if(g_ops.enable_except) {
-         if(is_fp32_nan(eA, mA) || is_fp32_nan(eB, mB))
-             return encode_fp32(0, 255, 1);
-         if(is_fp32_inf(eA, mA) || is_fp32_inf(eB, mB))
-             return encode_fp32(outSign, 255, 0);
-     }
-     if(g_ops.enable_subnorm) {
-         if(is_fp32_subnormal(eA, mA))
-             eA = 1;
-         if(is_fp32_subnormal(eB, mB))
-             eB = 1;
-     }
-     
-     int eSum = (int)eA + (int)eB - 127;
-     if(eSum < 1) eSum = 1;
-     else if(eSum > 254) {
-         if(g_ops.enable_clamp)
-             return encode_fp32(outSign, 254, (1 << 23) - 1);
-         else
-             return encode_fp32(outSign, 255, 0);
-     }
-     
-     sc_uint<24> bigA = (1 << 23) | mA;
-     sc_uint<24> bigB = (1 << 23) | mB;
-     uint64_t prod = (uint64_t)bigA * (uint64_t)bigB;
-     if ((prod >> 47) & 1) {
-         prod >>= 1;
-         eSum++;
-     }
-     sc_uint<24> mid = (prod >> 23) & 0xFFFFFF;
-     sc_uint<23> finalMant = finalize_round_fp32(mid);
-     sc_uint<8> outE = eSum;
-     if(g_ops.enable_clamp && outE > 254) {
-         outE = 254;
-         finalMant = (1 << 23) - 1;
+     sc_uint<32> result = fp_mul(a.to_uint(), b.to_uint(), 23);
+
+     if(DEBUG_MODE) {
+         std::cout << "[FP32 MUL] a=0x" << std::hex << a
+                   << ", b=0x" << b
+                   << ", result=0x" << result << std::dec << std::endl;
      }
-     
-     sc_uint<32> result = encode_fp32(outSign, outE, finalMant);
+     return result;
+ }
+
+ // ---------------------- FP32 FMA ----------------------
+ // a*b + c with one rounding
+ sc_uint<32> fp32_fma_1c(sc_uint<32> a, sc_uint<32> b, sc_uint<32> c)
+ {
+     sc_uint<32> result = fp_fma(a.to_uint(), b.to_uint(), c.to_uint(), 23);
+
      if(DEBUG_MODE) {
-         std::cout << "[FP32 MUL] a=0x" << std::hex << a 
-                   << ", b=0x" << b 
+         std::cout << "[FP32 FMA] a=0x" << std::hex << a
+                   << ", b=0x" << b
+                   << ", c=0x" << c
                    << ", result=0x" << result << std::dec << std::endl;
      }
      return result;
  }
- 
+
  // ---------------------- BF16 HELPER FUNCTIONS ----------------------
- 
+
  // For BF16, the number is stored with 1 sign bit, 8 exponent bits, and the top 7 bits of the fraction.
- static void decode_bf16(sc_uint<32> val, sc_uint<1>& s, sc_uint<8>& e, sc_uint<7>& m) {
-     s = val[31];
-     e = val.range(30,23);
-     m = val.range(22,16);
- }
  static sc_uint<32> encode_bf16(sc_uint<1> s, sc_uint<8> e, sc_uint<7> m) {
      sc_uint<32> out = 0;
      out[31] = s;
@@ -301,174 +367,68 @@
      out.range(22,16) = m;
      return out;
  }
- static bool is_bf16_inf(sc_uint<8> e, sc_uint<7> m) {
-     return (e == 255 && m == 0);
- }
- static bool is_bf16_nan(sc_uint<8> e, sc_uint<7> m) {
-     return (e == 255 && m != 0);
- }
- static bool is_bf16_subnormal(sc_uint<8> e, sc_uint<7> m) {
-     return (e == 0 && m != 0);
- }
- static void clamp_exponent_bf16(sc_uint<8>& e, sc_uint<7>& m) {
-     if(e > 254) {
-         e = 254;
-         m = (1 << 7) - 1;
-     }
- }
- static sc_uint<7> finalize_round_bf16(sc_uint<8> sum) {
-     if(g_ops.enable_trunc) {
-         return sum.range(6,0);
-     } else {
-         bool roundBit = sum[0].to_bool();
-         sum >>= 1;
-         if(roundBit)
-             sum += 1;
-         return sum.range(6,0);
-     }
- }
- 
- // ---------------------- BF16 ADD ----------------------
+
+ // ---------------------- BF16 ADD / SUB / MUL / FMA ----------------------
+ // Operands in the upper 16 bits of the lane, the lower 16 bits are ignored
  sc_uint<32> bf16_add_1c(sc_uint<32> a, sc_uint<32> b)
  {
-     sc_uint<1> sA, sB;
-     sc_uint<8> eA, eB;
-     sc_uint<7> mA, mB;
-     decode_bf16(a, sA, eA, mA);
-     decode_bf16(b, sB, eB, mB);
- 
-     if(g_ops.enable_except) {
-         if(is_bf16_nan(eA, mA) || is_bf16_nan(eB, mB))
-             return encode_bf16(0, 255, 1);
-         if(is_bf16_inf(eA, mA)) return a;
-         if(is_bf16_inf(eB, mB)) return b;
-     }
-     if(g_ops.enable_subnorm) {
-         if(is_bf16_subnormal(eA, mA)) eA = 1;
-         if(is_bf16_subnormal(eB, mB)) eB = 1;
-     }
-     if(sA != sB)
-         return bf16_sub_1c(a, b);
- 
-     sc_uint<8> eMax = (eA > eB) ? eA : eB;
-     sc_uint<8> diff = (eA > eB) ? (eA - eB) : (eB - eA);
- 
-     // Restore the implicit bit for BF16 by OR-ing with (1 << 7) to get an 8-bit significand.
-     sc_uint<8> bigM = (1 << 7) | ((eA > eB) ? mA : mA);
-     sc_uint<8> smlM = (1 << 7) | ((eA > eB) ? mB : mB);
- 
-     sc_uint<8> alignedSmaller = smlM >> diff;
-     sc_uint<8> sumVal = bigM + alignedSmaller;
-     if(sumVal[7] == 1) {
-         sumVal >>= 1;
-         eMax++;
-     }
-     sc_uint<7> finalMant = finalize_round_bf16(sumVal);
-     if(g_ops.enable_clamp)
-         clamp_exponent_bf16(eMax, finalMant);
-     return encode_bf16(sA, eMax, finalMant);
+     return fp_add(a.to_uint() >> 16, b.to_uint() >> 16, 7) << 16;
  }
- 
- // ---------------------- BF16 SUB ----------------------
+
  sc_uint<32> bf16_sub_1c(sc_uint<32> a, sc_uint<32> b)
  {
-     sc_uint<1> sA, sB;
-     sc_uint<8> eA, eB;
-     sc_uint<7> mA, mB;
-     decode_bf16(a, sA, eA, mA);
-     decode_bf16(b, sB, eB, mB);
- 
-     if(g_ops.enable_except) {
-         if(is_bf16_nan(eA, mA) || is_bf16_nan(eB, mB))
-             return encode_bf16(0, 255, 1);
-         if(is_bf16_inf(eA, mA) && is_bf16_inf(eB, mB))
-             return encode_bf16(0,255,1);
-         if(is_bf16_inf(eA, mA)) return a;
-         if(is_bf16_inf(eB, mB)) return encode_bf16(~sB,255,0);
-     }
-     if(g_ops.enable_subnorm) {
-         if(is_bf16_subnormal(eA, mA)) eA = 1;
-         if(is_bf16_subnormal(eB, mB)) eB = 1;
-     }
-     if(sA != sB) {
-         sc_uint<32> bNeg = b;
-         bNeg[31] = ~sB;
-         return bf16_add_1c(a, bNeg);
-     } else {
-         sc_uint<8> eMax = (eA > eB) ? eA : eB;
-         sc_uint<8> diff = (eA > eB) ? (eA - eB) : (eB - eA);
-         sc_uint<8> bigM = (1 << 7) | ((eA > eB) ? mA : mA);
-         sc_uint<8> smlM = (1 << 7) | ((eA > eB) ? mB : mB);
-         sc_uint<1> outSign = (eA > eB) ? sA : sB;
-         sc_uint<8> alignedSmaller = smlM >> diff;
- 
-         int diffMant = (int)bigM - (int)alignedSmaller;
-         if(diffMant < 0) {
-             outSign = ~outSign;
-             diffMant = -diffMant;
-         }
-         sc_uint<8> mag = diffMant;
-         while(mag[7] == 0 && mag != 0 && eMax > 0) {
-             mag <<= 1;
-             eMax--;
-         }
-         sc_uint<7> finalMant = finalize_round_bf16(mag);
-         if(g_ops.enable_clamp)
-             clamp_exponent_bf16(eMax, finalMant);
-         return encode_bf16(outSign, eMax, finalMant);
-     }
+     return fp_add(a.to_uint() >> 16, (b.to_uint() >> 16) ^ 0x8000u, 7) << 16;
  }
- 
- // ---------------------- BF16 MUL ----------------------
+
  sc_uint<32> bf16_mul_1c(sc_uint<32> a, sc_uint<32> b)
  {
-     sc_uint<1> sA, sB;
-     sc_uint<8> eA, eB;
-     sc_uint<7> mA, mB;
-     decode_bf16(a, sA, eA, mA);
-     decode_bf16(b, sB, eB, mB);
-     sc_uint<1> outSign = sA ^ sB;
- 
-     if(g_ops.enable_except) {
-         if(is_bf16_nan(eA, mA) || is_bf16_nan(eB, mB))
-             return encode_bf16(0,255,1);
-         bool infA = is_bf16_inf(eA, mA);
-         bool infB = is_bf16_inf(eB, mB);
-         if(infA || infB) {
-             if((infA && eB != 0) || (infB && eA != 0))
-                 return encode_bf16(outSign,255,0);
-             else
-                 return encode_bf16(0,255,1);
-         }
-     }
-     if(g_ops.enable_subnorm) {
-         if(is_bf16_subnormal(eA, mA)) eA = 1;
-         if(is_bf16_subnormal(eB, mB)) eB = 1;
-     }
-     int eSum = (int)eA + (int)eB - 127;
-     if(eSum < 1) eSum = 1;
-     else if(eSum > 254) {
-         if(g_ops.enable_clamp)
-             return encode_bf16(outSign,254,(1<<7)-1);
-         else
-             return encode_bf16(outSign,255,0);
-     }
-     sc_uint<8> bigA = (1 << 7) | mA;
-     sc_uint<8> bigB = (1 << 7) | mB;
-     unsigned int prod = (unsigned int)bigA * (unsigned int)bigB;
-     if((prod >> 15) & 1) {
-         prod >>= 1;
-         eSum++;
+     return fp_mul(a.to_uint() >> 16, b.to_uint() >> 16, 7) << 16;
+ }
+
+ sc_uint<32> bf16_fma_1c(sc_uint<32> a, sc_uint<32> b, sc_uint<32> c)
+ {
+     return fp_fma(a.to_uint() >> 16, b.to_uint() >> 16, c.to_uint() >> 16, 7) << 16;
+ }
+
+
+ // ---------------------- FP32 -> BF16 NARROWING ----------------------
+ sc_uint<32> fp32_round_to_bf16(sc_uint<32> a)
+ {
+     sc_uint<1> s;
+     sc_uint<8> e;
+     sc_uint<23> m;
+     decode_fp32(a, s, e, m);
+ 
+     // NaN stays a (quiet) NaN, Inf stays Inf
+     if(e == 255)
+         return encode_bf16(s, 255, (m != 0) ? sc_uint<7>(m.range(22,16) | 0x40) : sc_uint<7>(0));
+
+     // without gradual underflow a subnormal reads as zero, as in the kernels
+     if(e == 0 && !g_ops->enable_subnorm)
+         return encode_bf16(s, 0, 0);
+ 
+     uint32_t bits = a.to_uint();
+     if(g_ops->enable_stochastic) {
+         // round up with probability (dropped bits) / 2^16
+         bits += opsStochasticBits() & 0xFFFF;
      }
-     sc_uint<8> mid = (prod >> 7) & 0xFF;
-     sc_uint<7> finalMant = finalize_round_bf16(mid);
-     sc_uint<8> outE = eSum;
-     if(g_ops.enable_clamp && outE > 254) {
-         outE = 254;
-         finalMant = (1 << 7) - 1;
-     } else if(outE >= 255) {
-         return encode_bf16(outSign,255,0);
+     else if(!g_ops->enable_trunc) {
+         // round to nearest, ties to even on bit 16
+         bits += 0x7FFF + ((bits >> 16) & 1);
      }
-     return encode_bf16(outSign, outE, finalMant);
+     sc_uint<32> out = bits & 0xFFFF0000u;
+     if(g_ops->enable_clamp && out.range(30,23) == 255)
+         return encode_bf16(s, 254, (1 << 7) - 1);
+     return out;
+ }
+
+
+ // ---------------------- MIXED BF16 x BF16 -> FP32 ----------------------
+ sc_uint<32> bf16_dot2_fp32_1c(sc_uint<32> a0, sc_uint<32> a1,
+                               sc_uint<32> b0, sc_uint<32> b1,
+                               sc_uint<32> acc)
+ {
+     sc_uint<32> p0 = fp32_mul_1c(a0.to_uint() & 0xFFFF0000u, b0.to_uint() & 0xFFFF0000u);
+     sc_uint<32> p1 = fp32_mul_1c(a1.to_uint() & 0xFFFF0000u, b1.to_uint() & 0xFFFF0000u);
+     return fp32_add_1c(fp32_add_1c(acc, p0), p1);
  }
- 
\ No newline at end of file
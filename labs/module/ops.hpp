@@ -2,38 +2,145 @@
  * Author: Abcd at abcd
  * Project: Project name
  * File: ops.hpp
- * Description: Declares single-cycle FP32 and BF16 operations (add, sub, mul).
- *              The function prototypes remain unchanged. A global context
- *              (set via setOpsContext) is used internally for subnorm/trunc/clamp/except.
+ * Description: Declares single-cycle FP32 and BF16 operations (add, sub, mul, fma).
+ *              The function prototypes remain unchanged. The current
+ *              ops_context (set via setOpsContext) is used internally for
+ *              subnorm/trunc/clamp/except and stochastic rounding.
  **********/
 #pragma once
 #include <systemc.h>
 
 /**
- * Set the global context from outside (SFR or pipeline).
- * - enableSubnorm: whether subnormal numbers get normalized
- * - enableTrunc:   if true, we truncate (instead of round half-up)
- * - enableClamp:   if true, clamp exponent or integer range on overflow
- * - enableExcept:  if true, treat NaN/Inf more carefully
+ * Rounding context read by the kernels; the setOps* functions below write
+ * the current one. Each OS thread starts on its own default context. A
+ * model that keeps several (one per MALU, one per staged line) makes the
+ * right one current with ops_context_scope around the computation, so an
+ * SFR decoded for one never changes the rounding or SR stream of another.
+ */
+struct ops_context {
+    bool     enable_subnorm    = false;
+    bool     enable_trunc      = false;
+    bool     enable_clamp      = false;
+    bool     enable_except     = false;
+    bool     enable_stochastic = false;
+    uint32_t sr_key  = 0;   // hashed seed
+    uint32_t sr_step = 0;   // instruction / output line counter
+    uint32_t sr_lane = 0;
+};
+
+ops_context& currentOpsContext();
+
+/**
+ * Makes ctx current until the end of the scope, then restores the previous
+ * one. Do not keep a scope open across wait(): another process would run
+ * with this context current.
+ */
+class ops_context_scope {
+public:
+    explicit ops_context_scope(ops_context& ctx);
+    ~ops_context_scope();
+    ops_context_scope(const ops_context_scope&) = delete;
+    ops_context_scope& operator=(const ops_context_scope&) = delete;
+private:
+    ops_context* prev_;
+};
+
+/**
+ * Set the current context from outside (SFR or pipeline).
+ * - enableSubnorm: gradual underflow; if false, subnormal operands read as
+ *                  zero and results below the smallest normal flush to zero
+ * - enableTrunc:   round toward zero (instead of to nearest even)
+ * - enableClamp:   overflow gives the largest finite value instead of Inf
+ * - enableExcept:  NaN/Inf operands are expected; add/sub/mul always follow
+ *                  IEEE 754 for them, without it their results are unspecified
  */
 void setOpsContext(bool enableSubnorm,
                    bool enableTrunc,
                    bool enableClamp,
                    bool enableExcept);
 
+/**
+ * Stochastic rounding for the narrowing paths (FP32->BF16, FP32->INT8).
+ * The random bits are a counter-based hash of (seed, step, lane): no state is
+ * carried from lane to lane, so one seed always reproduces the same results.
+ * - setOpsStochastic: enable + seed (from the SFR), restarts the step counter
+ * - updateOpsStochastic: same, but keeps the step counter running when enable
+ *                     and seed are unchanged (re-applying one SFR per line)
+ * - setOpsLane:       lane index used by the next narrowing
+ * - advanceOpsStep:   next instruction / output line
+ */
+void setOpsStochastic(bool enable, uint32_t seed);
+void updateOpsStochastic(bool enable, uint32_t seed);
+void setOpsLane(uint32_t lane);
+void advanceOpsStep();
+
+/**
+ * Random word for (seed, step, lane) of the current lane,
+ * or 0 when stochastic rounding is off (plain truncation).
+ */
+uint32_t opsStochasticBits();
+
 /**
  * Single-cycle FP32 operations, using the global context:
  *   fp32_add_1c(a,b), fp32_sub_1c(a,b), fp32_mul_1c(a,b)
+ *   fp32_fma_1c(a,b,c) = a*b + c, rounded once
  */
 sc_uint<32> fp32_add_1c(sc_uint<32> a, sc_uint<32> b);
 sc_uint<32> fp32_sub_1c(sc_uint<32> a, sc_uint<32> b);
 sc_uint<32> fp32_mul_1c(sc_uint<32> a, sc_uint<32> b);
+sc_uint<32> fp32_fma_1c(sc_uint<32> a, sc_uint<32> b, sc_uint<32> c);
 
 /**
  * Single-cycle BF16 operations, using the global context:
  *   bf16_add_1c(a,b), bf16_sub_1c(a,b), bf16_mul_1c(a,b)
+ *   bf16_fma_1c(a,b,c) = a*b + c, rounded once
  */
 sc_uint<32> bf16_add_1c(sc_uint<32> a, sc_uint<32> b);
 sc_uint<32> bf16_sub_1c(sc_uint<32> a, sc_uint<32> b);
 sc_uint<32> bf16_mul_1c(sc_uint<32> a, sc_uint<32> b);
+sc_uint<32> bf16_fma_1c(sc_uint<32> a, sc_uint<32> b, sc_uint<32> c);
+
+/**
+ * The add/sub/mul datapath shared by the kernels above, for units that
+ * split it into pipeline stages (fp32_add_pipe). MB is the fraction width
+ * (FP32 23, BF16 7); the working significand has its hidden bit at FP_W.
+ * All of them read the current context, like the kernels.
+ *   fp_unpack(v,MB)                 sign, biased exponent, significand
+ *   shr_sticky(v,n)                 v >> n, ORing what is shifted out into bit 0
+ *   fp_round_pack(sign,exp,sig,MB)  round sig * 2^(exp-127-FP_W), sig != 0
+ *   fp_pack(s,e,f,MB), fp_qnan(MB)  raw fields, the quiet NaN
+ */
+static const int FP_W = 61;
+
+struct fp_parts {
+    uint32_t sign;
+    int      exp;     // biased exponent, 1 for subnormals
+    uint64_t sig;     // hidden bit at MB; 0 for zero (or a flushed subnormal)
+    bool     nan;
+    bool     inf;
+};
+
+fp_parts fp_unpack(uint32_t v, int MB);
+uint64_t shr_sticky(uint64_t v, int n);
+uint32_t fp_round_pack(uint32_t sign, int exp, uint64_t sig, int MB);
+uint32_t fp_pack(uint32_t s, uint32_t e, uint32_t f, int MB);
+uint32_t fp_qnan(int MB);
+
+/**
+ * Narrow an FP32 value to BF16 (result in the upper 16 bits of the lane).
+ * Rounds stochastically if enabled, else truncates if enableTrunc is set,
+ * otherwise rounds to nearest even. Without enableSubnorm a subnormal
+ * input narrows to a zero of its sign.
+ */
+sc_uint<32> fp32_round_to_bf16(sc_uint<32> a);
+
+/**
+ * Mixed precision: BF16 x BF16 products accumulated in FP32.
+ * Operands are BF16 in the upper 16 bits of the lane, acc and result FP32.
+ * The products are exact in FP32, only the two adds round.
+ *   bf16_dot2_fp32_1c(a0,a1,b0,b1,acc) = acc + a0*b0 + a1*b1
+ */
+sc_uint<32> bf16_dot2_fp32_1c(sc_uint<32> a0, sc_uint<32> a1,
+                              sc_uint<32> b0, sc_uint<32> b1,
+                              sc_uint<32> acc);
 
@@ -0,0 +1,229 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: payload_pool.hpp
+ * Description: Recycled payload objects for the NPU interface FIFOs.
+ *              Every payload type T has one pool of constructed objects; a
+ *              released object goes back to the pool and is handed out again,
+ *              so its sc_bv storage is never freed or reallocated. A reused
+ *              object is cleared on acquire with T::reset(), which writes the
+ *              fields in place (payloads without one are assigned T()), so a
+ *              producer never sees the previous transfer's fields.
+ *
+ *              make_payload<X_PTR>() works for both pointer flavours, so call
+ *              sites do not change when a *_PTR typedef is switched:
+ *              - pool_ptr<T>: intrusive, non-atomic reference count kept next
+ *                to the object (the simulation kernel runs on one OS thread)
+ *              - std::shared_ptr<T>: pooled object, control block from a
+ *                pooled allocator, no heap allocation once warm
+ **********/
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <typeinfo>
+#include <vector>
+
+struct payload_pool_stats {
+    uint64_t allocated  = 0;   // objects created on the heap
+    uint64_t acquired   = 0;   // hand-outs, reused or new
+    uint64_t live       = 0;   // currently handed out
+    uint64_t high_water = 0;   // max live
+};
+
+// Registry, so one call can report every pool in use
+class payload_pool_base {
+public:
+    virtual ~payload_pool_base() {}
+    virtual const char* name() const = 0;
+    const payload_pool_stats& stats() const { return st; }
+
+    static std::vector<payload_pool_base*>& registry() {
+        static std::vector<payload_pool_base*> r;
+        return r;
+    }
+    static void report(std::ostream& os) {
+        for(payload_pool_base* p : registry()) {
+            const payload_pool_stats& s = p->stats();
+            os << "[payload_pool] " << p->name()
+               << ": allocated=" << s.allocated
+               << " acquired="   << s.acquired
+               << " live="       << s.live
+               << " high_water=" << s.high_water << "\n";
+        }
+    }
+
+protected:
+    payload_pool_stats st;
+};
+
+// Clear a reused payload: in place if T has reset(), else assign a new T
+template<class T>
+inline auto payload_reset(T& v, int) -> decltype(v.reset(), void()) { v.reset(); }
+template<class T>
+inline void payload_reset(T& v, long) { v = T(); }
+
+template<class T>
+class payload_pool : public payload_pool_base {
+public:
+    struct node {
+        T        value;
+        uint32_t refs = 0;
+    };
+
+    static payload_pool& instance() {
+        static payload_pool* p = new payload_pool();   // outlives every payload
+        return *p;
+    }
+
+    node* acquire() {
+        node* n;
+        if(free_.empty()) {
+            n = new node();
+            st.allocated++;
+        } else {
+            n = free_.back();
+            free_.pop_back();
+            payload_reset(n->value, 0);
+        }
+        st.acquired++;
+        if(++st.live > st.high_water) st.high_water = st.live;
+        return n;
+    }
+
+    void release(node* n) {
+        st.live--;
+        free_.push_back(n);
+    }
+
+    const char* name() const override { return typeid(T).name(); }
+
+private:
+    payload_pool() {
+        free_.reserve(64);
+        registry().push_back(this);
+    }
+    std::vector<node*> free_;
+};
+
+/**
+ * Intrusive reference-counted handle to a pooled payload.
+ * Same use as a shared_ptr: ->, *, bool test, compare, copy.
+ */
+template<class T>
+class pool_ptr {
+public:
+    typedef T element_type;
+    typedef typename payload_pool<T>::node node;
+
+    pool_ptr() : n_(nullptr) {}
+    pool_ptr(std::nullptr_t) : n_(nullptr) {}
+    pool_ptr(const pool_ptr& o) : n_(o.n_) { if(n_) n_->refs++; }
+    pool_ptr(pool_ptr&& o) noexcept : n_(o.n_) { o.n_ = nullptr; }
+    ~pool_ptr() { drop(); }
+
+    pool_ptr& operator=(const pool_ptr& o) {
+        if(o.n_) o.n_->refs++;
+        drop();
+        n_ = o.n_;
+        return *this;
+    }
+    pool_ptr& operator=(pool_ptr&& o) noexcept {
+        if(this != &o) { drop(); n_ = o.n_; o.n_ = nullptr; }
+        return *this;
+    }
+    pool_ptr& operator=(std::nullptr_t) { drop(); return *this; }
+
+    static pool_ptr make() {
+        pool_ptr p;
+        p.n_ = payload_pool<T>::instance().acquire();
+        p.n_->refs = 1;
+        return p;
+    }
+
+    T*   get() const         { return n_ ? &n_->value : nullptr; }
+    T&   operator*() const   { return n_->value; }
+    T*   operator->() const  { return &n_->value; }
+    explicit operator bool() const { return n_ != nullptr; }
+    uint32_t use_count() const { return n_ ? n_->refs : 0; }
+
+    bool operator==(const pool_ptr& o) const { return n_ == o.n_; }
+    bool operator!=(const pool_ptr& o) const { return n_ != o.n_; }
+    bool operator==(std::nullptr_t) const { return n_ == nullptr; }
+    bool operator!=(std::nullptr_t) const { return n_ != nullptr; }
+
+private:
+    void drop() {
+        if(n_ && --n_->refs == 0)
+            payload_pool<T>::instance().release(n_);
+        n_ = nullptr;
+    }
+    node* n_;
+};
+
+// sc_fifo<T> needs operator<< for its print()/dump()
+template<class T>
+inline std::ostream& operator<<(std::ostream& os, const pool_ptr<T>& p)
+{
+    return os << static_cast<const void*>(p.get());
+}
+
+/**
+ * Allocator for shared_ptr control blocks: a free list per rebound type,
+ * blocks are kept for reuse instead of being returned to the heap.
+ */
+template<class U>
+struct pool_block_allocator {
+    typedef U value_type;
+
+    pool_block_allocator() {}
+    template<class V> pool_block_allocator(const pool_block_allocator<V>&) {}
+
+    U* allocate(size_t n) {
+        if(n == 1 && !free_list().empty()) {
+            U* p = free_list().back();
+            free_list().pop_back();
+            return p;
+        }
+        return static_cast<U*>(::operator new(n * sizeof(U)));
+    }
+    void deallocate(U* p, size_t n) {
+        if(n == 1) free_list().push_back(p);
+        else       ::operator delete(p);
+    }
+
+    template<class V> bool operator==(const pool_block_allocator<V>&) const { return true; }
+    template<class V> bool operator!=(const pool_block_allocator<V>&) const { return false; }
+
+private:
+    static std::vector<U*>& free_list() {
+        static std::vector<U*>* l = new std::vector<U*>();
+        return *l;
+    }
+};
+
+template<class PTR> struct payload_traits;
+
+template<class T>
+struct payload_traits< pool_ptr<T> > {
+    static pool_ptr<T> make() { return pool_ptr<T>::make(); }
+};
+
+template<class T>
+struct payload_traits< std::shared_ptr<T> > {
+    static std::shared_ptr<T> make() {
+        typedef typename payload_pool<T>::node node;
+        node* n = payload_pool<T>::instance().acquire();
+        return std::shared_ptr<T>(&n->value,
+                                  [n](T*) { payload_pool<T>::instance().release(n); },
+                                  pool_block_allocator<char>());
+    }
+};
+
+/**
+ * A recycled payload for the pointer type of a FIFO:
+ *   auto out_mrf = make_payload<malu2mrf_PTR>();
+ */
+template<class PTR>
+inline PTR make_payload() { return payload_traits<PTR>::make(); }
@@ -0,0 +1,27 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: tcm2malu.hpp
+ * Description: TCM -> MALU payload. A LUT load arrives as beats on the four
+ *              i_tcm2malu fifos, each carrying one 512-bit TCM line
+ *              (16 FP32 entries), so one beat moves 64 entries.
+ **********/
+#pragma once
+#include <systemc.h>
+#include "payload_pool.hpp"
+
+struct tcm2malu {
+    sc_bv<512> data;
+    bool       last = false;   // last beat of the requested block
+
+    void reset() { data = 0; last = false; }
+};
+
+typedef pool_ptr<tcm2malu> tcm2malu_PTR;
+
+inline std::ostream& operator<<(std::ostream& os, const tcm2malu_PTR& p)
+{
+    if(p) os << "tcm2malu{last=" << p->last << "}";
+    else  os << "tcm2malu{null}";
+    return os;
+}
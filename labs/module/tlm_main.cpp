@@ -0,0 +1,173 @@
+/**********
+ * Author: Abcd at abcd
+ * Project: Project name
+ * File: tlm_main.cpp
+ * Description: Loosely-timed testbench for malu_tlm. An initiator with a
+ *              tlm_quantumkeeper streams FP32 MUL lines in batches, reads the
+ *              results back and checks them, then reports the simulated MALU
+ *              cycles next to the host time it took. A second stream rounds to
+ *              BF16 stochastically and must match one uninterrupted
+ *              malu_datapath pass bit for bit, whatever the batch size.
+ *              Usage: tlm_main [num_lines=65536] [batch=256] [quantum_ns=1000]
+ **********/
+
+ #include <systemc>
+ #include <tlm>
+ #include <tlm_utils/simple_initiator_socket.h>
+ #include <tlm_utils/tlm_quantumkeeper.h>
+ #include <algorithm>
+ #include <chrono>
+ #include <cstdlib>
+ #include <cstring>
+ #include <vector>
+ #include "malu_tlm.hpp"
+
+ SC_MODULE(tlm_tb) {
+     tlm_utils::simple_initiator_socket<tlm_tb> socket;
+
+     int      num_lines;
+     int      batch;
+     int      errors;
+     tlm_utils::tlm_quantumkeeper qk;
+
+     SC_HAS_PROCESS(tlm_tb);
+     tlm_tb(sc_module_name name, int lines, int batch)
+       : sc_module(name), socket("socket"),
+         num_lines(lines), batch(batch), errors(0)
+     {
+         SC_THREAD(run);
+     }
+
+     bool transport(tlm::tlm_command cmd, uint64_t addr, void* data, unsigned len) {
+         tlm::tlm_generic_payload trans;
+         sc_time delay = qk.get_local_time();
+         trans.set_command(cmd);
+         trans.set_address(addr);
+         trans.set_data_ptr(reinterpret_cast<unsigned char*>(data));
+         trans.set_data_length(len);
+         trans.set_streaming_width(len);
+         trans.set_byte_enable_ptr(nullptr);
+         trans.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+         socket->b_transport(trans, delay);
+         qk.set(delay);
+         if(qk.need_sync())
+             qk.sync();
+         return trans.is_response_ok();
+     }
+
+     // FP32 MUL: lane l of line i is (float)(i+1) * (l+1), times 0.5f
+     void run() {
+         qk.reset();
+
+         _COMMON_REGISTERS regs;
+         regs.reg_parsed_mode_math.operation = 2;
+         if(!transport(tlm::TLM_WRITE_COMMAND, MALU_TLM_SFR, &regs, sizeof(regs)))
+             errors++;
+
+         std::vector<float> planes(2 * batch * MALU_LANES), res(batch * MALU_LANES);
+         for(int base = 0; base < num_lines; base += batch) {
+             int n = std::min(batch, num_lines - base);
+             for(int i = 0; i < n; ++i)
+                 for(int l = 0; l < MALU_LANES; ++l) {
+                     planes[i*MALU_LANES + l]           = (float)(base + i + 1) * (l + 1);
+                     planes[(n + i)*MALU_LANES + l]     = 0.5f;
+                 }
+             if(!transport(tlm::TLM_WRITE_COMMAND, MALU_TLM_EXEC, planes.data(),
+                           2 * n * MALU_TLM_LINE_BYTES) ||
+                !transport(tlm::TLM_READ_COMMAND, MALU_TLM_RESULT, res.data(),
+                           n * MALU_TLM_LINE_BYTES)) {
+                 errors++;
+                 continue;
+             }
+             for(int i = 0; i < n; ++i)
+                 for(int l = 0; l < MALU_LANES; ++l) {
+                     float expect = (float)(base + i + 1) * (l + 1) * 0.5f;
+                     if(res[i*MALU_LANES + l] != expect) {
+                         if(errors == 0)
+                             std::cout << "[TB] line " << base + i << " lane " << l << ": got "
+                                       << res[i*MALU_LANES + l] << " expected " << expect << std::endl;
+                         errors++;
+                     }
+                 }
+         }
+         sr_stream();
+         qk.sync();
+     }
+
+     // FP32 MUL rounded to BF16 with stochastic rounding: the SR step must run
+     // on across EXEC batches, so batching cannot change the bits
+     void sr_stream() {
+         _COMMON_REGISTERS regs;
+         regs.reg_parsed_mode_math.operation     = 2;
+         regs.reg_parsed_mode_math.output_format = 1;
+         regs.reg_parsed_mode_math.rounding_mode = 2;
+         regs.reg_parsed_option_math_scalar.scalar_index_output  = 0x21;
+         regs.reg_parsed_option_math_scalar.scalar_index_input_1 = 0x43;
+         if(!transport(tlm::TLM_WRITE_COMMAND, MALU_TLM_SFR, &regs, sizeof(regs)))
+             errors++;
+
+         decoded_sfr_t cfg;
+         cfg.load(regs);
+         malu_datapath ref;
+
+         int total = std::min(num_lines, 4 * batch);
+         std::vector<uint32_t> planes(2 * batch * MALU_LANES), res(batch * MALU_LANES);
+         uint32_t a[MALU_LANES], b[MALU_LANES], want[MALU_LANES];
+         sc_bv<2048> abits, bbits, obits;
+         for(int base = 0; base < total; base += batch) {
+             int n = std::min(batch, total - base);
+             for(int i = 0; i < n; ++i)
+                 for(int l = 0; l < MALU_LANES; ++l) {
+                     uint32_t h = (uint32_t)((base + i) * MALU_LANES + l) * 2654435761u;
+                     planes[i*MALU_LANES + l]       = 0x3F800000u | (h >> 9);
+                     planes[(n + i)*MALU_LANES + l] = 0x3FC00000u | (h & 0x3FFFFFu);
+                 }
+             if(!transport(tlm::TLM_WRITE_COMMAND, MALU_TLM_EXEC, planes.data(),
+                           2 * n * MALU_TLM_LINE_BYTES) ||
+                !transport(tlm::TLM_READ_COMMAND, MALU_TLM_RESULT, res.data(),
+                           n * MALU_TLM_LINE_BYTES)) {
+                 errors++;
+                 continue;
+             }
+             for(int i = 0; i < n; ++i) {
+                 std::memcpy(a, &planes[i*MALU_LANES], sizeof(a));
+                 std::memcpy(b, &planes[(n + i)*MALU_LANES], sizeof(b));
+                 pack_line(a, abits);
+                 pack_line(b, bbits);
+                 ref.execute_line(cfg, abits, bbits, obits);
+                 unpack_line(obits, want);
+                 if(std::memcmp(want, &res[i*MALU_LANES], sizeof(want)) != 0) {
+                     if(errors == 0)
+                         std::cout << "[TB] SR line " << base + i
+                                   << " differs from one uninterrupted stream" << std::endl;
+                     errors++;
+                 }
+             }
+         }
+     }
+ };
+
+ int sc_main(int argc, char* argv[])
+ {
+     int num_lines  = (argc > 1) ? std::atoi(argv[1]) : 65536;
+     int batch      = (argc > 2) ? std::atoi(argv[2]) : 256;
+     int quantum_ns = (argc > 3) ? std::atoi(argv[3]) : 1000;
+     if (batch < 1) batch = 1;
+
+     tlm_utils::tlm_quantumkeeper::set_global_quantum(sc_time(quantum_ns, SC_NS));
+
+     malu_tlm dut("dut_malu_tlm", 0);
+     tlm_tb   tb("tb", num_lines, batch);
+     tb.socket.bind(dut.socket);
+
+     auto t0 = std::chrono::steady_clock::now();
+     sc_start();
+     double host_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+     std::cout << "[TB] " << num_lines << " lines in batches of " << batch << ": "
+               << dut.get_stats().cycles << " MALU cycles, sim time " << sc_time_stamp()
+               << ", host " << host_s << " s => "
+               << (host_s > 0 ? num_lines / host_s : 0.0) << " lines/s, "
+               << tb.errors << " errors" << std::endl;
+     return tb.errors ? 1 : 0;
+ }
@@ -4,6 +4,7 @@
  * File: typecast_ops.cpp
  * Description: Implements the single-cycle typecast operation, referencing the same
  *              global context from ops if needed. Supports partial FP32<->BF16<->INT8.
+ *              FP32->BF16 and FP32->INT8 honor the stochastic rounding mode.
  **********/
 #include "typecast_ops.hpp"
 #include "ops.hpp"
@@ -37,16 +38,6 @@ static void decode_bf16_local(sc_uint<32> val,
     e= val.range(30,23);
     m= val.range(22,16);
 }
-static sc_uint<32> encode_bf16_local(sc_uint<1> s,
-                                     sc_uint<8> e,
-                                     sc_uint<7> m)
-{
-    sc_uint<32> out=0;
-    out[31]=s;
-    out.range(30,23)=e;
-    out.range(22,16)=m;
-    return out;
-}
 
 /**
  * typecast_single_cycle:
@@ -58,10 +49,7 @@ sc_uint<32> typecast_single_cycle(sc_uint<32> input,
                                   NumFormat dstFmt)
 {
     if(srcFmt==FP32 && dstFmt==BF16) {
-        sc_uint<1> s; sc_uint<8> e; sc_uint<23> m;
-        decode_fp32_local(input,s,e,m);
-        sc_uint<7> outM = m.range(22,16);
-        return encode_bf16_local(s,e,outM);
+        return fp32_round_to_bf16(input);
     } 
     else if(srcFmt==BF16 && dstFmt==FP32) {
         sc_uint<1> s; sc_uint<8> e; sc_uint<7> mm;
@@ -72,12 +60,24 @@ sc_uint<32> typecast_single_cycle(sc_uint<32> input,
     else if(srcFmt==FP32 && dstFmt==INT8) {
         sc_uint<1> s; sc_uint<8> e; sc_uint<23> m;
         decode_fp32_local(input,s,e,m);
+        // NaN => 0; |x| >= 256 (incl. Inf) saturates below
+        if(e==255 && m!=0)
+            return 0;
         int exponent = (int)e - 127;
         int value = (1<<23) | m;
-        if(exponent>23)
-            value <<= (exponent-23);
-        else if(exponent<23)
-            value >>= (23-exponent);
+        if(exponent>=8)
+            value = 256;
+        else if(exponent<23) {
+            int shift = 23-exponent;
+            if(shift>=32)
+                value = 0;
+            else {
+                // stochastic rounding adds random bits below the integer LSB
+                // before they are dropped (0 when truncating)
+                unsigned dropped = opsStochasticBits() & ((1u<<shift)-1);
+                value = (int)(((unsigned)value + dropped) >> shift);
+            }
+        }
         int intVal = (s? -value: value);
         // clamp
         if(intVal>127) intVal=127;
@@ -0,0 +1,201 @@
+/*********************
+* Author : ABC at abc
+* File   : multi_ru_main.cpp
+* Multi-RU top: NUM_RU ru_funccore instances, each with its own MMU stream
+* and sinks. Runs rounds with 1, 2, 4 ... NUM_RU RUs active (reset between
+* rounds) and reports lines/cycle, host lines/s and whether every active RU
+* wrote the same address sequence (they get identical streams, so shared
+* state would show up as a mismatch).
+* Usage: multi_ru_main [num_ru=8] [rows=64] [cols=64] [cfg.json]
+* With cfg.json (tb_config format) the C-matrix size, base and strides come
+* from the register map and drive the programmable address generator.
+*********************/
+#include "ru_funccore.hpp"
+#include "mmu2ru.hpp"
+#include "ru2tcm_be.hpp"
+#include "ru2mlsu.hpp"
+#include "tb_config.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/* ── one RU's MMU stream and TCM/MLSU sinks ────────────────────────────
+ * Element (r,c) of the C tile is 4 packets on port r&0xF, done on the 4th.
+ * Each clock: one packet per port if the FIFO has room, drain all outputs. */
+SC_MODULE(ru_stream){
+    sc_in<bool> clk;
+    sc_vector< sc_fifo_out<mmu2ru_PTR> > o_mmu2ru;
+    sc_vector< sc_fifo_in <ru2tcm_be_PTR> > i_ru2tcm;
+    sc_vector< sc_fifo_in <ru2mlsu_PTR> >i_ru2mlsu;
+
+    bool     active{false};
+    uint64_t per_port{0}, sent[RU_NUM_PORTS]{};
+    uint64_t expect{0}, lines{0}, dones{0};
+    uint64_t hash{0};
+    sc_time  t_end;
+
+    SC_HAS_PROCESS(ru_stream);
+    explicit ru_stream(sc_module_name n)
+    : sc_module(n), o_mmu2ru("o_mmu2ru",RU_NUM_PORTS),
+      i_ru2tcm("i_ru2tcm",RU_NUM_LINES), i_ru2mlsu("i_ru2mlsu",RU_NUM_LINES)
+    { SC_CTHREAD(run, clk.pos()); }
+
+    /* rows must be a multiple of 16, so every port gets whole elements */
+    void start(uint32_t rows,uint32_t cols){
+        per_port=(uint64_t)(rows/RU_NUM_PORTS)*cols*4;
+        for(auto& s:sent) s=0;
+        expect=(uint64_t)rows*cols; lines=0; dones=0;
+        hash=1469598103934665603ull;
+        active=true;
+    }
+    bool busy() const { return active; }
+
+    void run(){
+        while(true){
+            wait();
+            if(!active) continue;
+            for(int p=0;p<RU_NUM_PORTS;++p){
+                if(sent[p]==per_port || !o_mmu2ru[p].num_free()) continue;
+                auto pkt=make_payload<mmu2ru_PTR>();
+                for(int b=0;b<16;++b) pkt->C_data[b]=(uint8_t)(sent[p]*16+b);
+                pkt->done=((sent[p]&3)==3);
+                o_mmu2ru[p].write(pkt);
+                sent[p]++;
+            }
+            for(int l=0;l<RU_NUM_LINES;++l){
+                while(i_ru2tcm[l].num_available()){
+                    auto o=i_ru2tcm[l].read();
+                    hash=(hash^o->address.to_uint())*1099511628211ull;
+                    lines++; dones+=o->done==1;
+                }
+                while(i_ru2mlsu[l].num_available()){ dones+=i_ru2mlsu[l].read()->done==1; lines++; }
+            }
+            /* one done per element; partial lines may add to the line count */
+            if(dones>=expect){ active=false; t_end=sc_time_stamp(); }
+        }
+    }
+};
+
+/* ── top: RUs, streams, and the round controller ──────────────────────*/
+SC_MODULE(multi_ru_top){
+    sc_in<bool> clk;
+    sc_signal<bool> rst;
+
+    int      num_ru;
+    uint32_t rows, cols;
+    sc_time  period;
+    std::vector<ru_stream*>   src;
+    std::vector<ru_funccore*> dut;
+    std::vector<sc_fifo<npuc2mmu_PTR>*> f_cmd;
+    std::vector<sc_fifo<mmu2npuc_PTR>*> f_rsp;
+    std::vector<sc_fifo<sfr_PTR>*>      f_sfr;
+    std::vector<sc_fifo<mmu2ru_PTR>*>   f_in;
+    std::vector<sc_fifo<ru2tcm_be_PTR>*>   f_tcm;
+    std::vector<sc_fifo<ru2mlsu_PTR>*>  f_mlsu;
+    int errors{0};
+
+    SC_HAS_PROCESS(multi_ru_top);
+    multi_ru_top(sc_module_name n,int num,uint32_t m,uint32_t c,sc_time clk_period,
+                 const ru_addr_cfg& acfg)
+    : sc_module(n), num_ru(num), rows(m), cols(c), period(clk_period)
+    {
+        for(int i=0;i<num_ru;++i){
+            std::string s=std::to_string(i);
+            auto* d=new ru_funccore(("ru"+s).c_str());
+            auto* t=new ru_stream(("stream"+s).c_str());
+            d->set_Id(i);
+            d->set_addr_cfg(acfg);
+            d->clk(clk); d->reset(rst); t->clk(clk);
+            f_cmd.push_back(new sc_fifo<npuc2mmu_PTR>(("cmd"+s).c_str(),2));
+            f_rsp.push_back(new sc_fifo<mmu2npuc_PTR>(("rsp"+s).c_str(),2));
+            f_sfr.push_back(new sc_fifo<sfr_PTR>     (("sfr"+s).c_str(),2));
+            d->i_npuc2mmu(*f_cmd.back());
+            d->i_mmu2npuc(*f_rsp.back());
+            d->i_reg_map (*f_sfr.back());
+            for(int p=0;p<RU_NUM_PORTS;++p){
+                f_in.push_back(new sc_fifo<mmu2ru_PTR>(("in"+s+"_"+std::to_string(p)).c_str(),4));
+                d->i_mmu2ru[p](*f_in.back()); t->o_mmu2ru[p](*f_in.back());
+            }
+            for(int l=0;l<RU_NUM_LINES;++l){
+                f_tcm.push_back (new sc_fifo<ru2tcm_be_PTR> (("tcm"+s+"_"+std::to_string(l)).c_str(),4));
+                f_mlsu.push_back(new sc_fifo<ru2mlsu_PTR>(("mlsu"+s+"_"+std::to_string(l)).c_str(),4));
+                d->o_ru2tcm[l](*f_tcm.back());   t->i_ru2tcm[l](*f_tcm.back());
+                d->o_ru2mlsu[l](*f_mlsu.back()); t->i_ru2mlsu[l](*f_mlsu.back());
+            }
+            dut.push_back(d); src.push_back(t);
+        }
+        SC_CTHREAD(control, clk.pos());
+    }
+
+    void control(){
+        std::vector<int> rounds;
+        for(int n=1;n<num_ru;n*=2) rounds.push_back(n);
+        rounds.push_back(num_ru);
+
+        double base=0;
+        for(int n:rounds){
+            rst=true;  wait(2);
+            rst=false; wait();
+
+            sc_time t0=sc_time_stamp();
+            auto    h0=std::chrono::steady_clock::now();
+            for(int i=0;i<n;++i) src[i]->start(rows,cols);
+            bool any=true;
+            while(any){
+                wait();
+                any=false;
+                for(int i=0;i<n;++i) any|=src[i]->busy();
+            }
+            double host=std::chrono::duration<double>(std::chrono::steady_clock::now()-h0).count();
+
+            sc_time  t_end=SC_ZERO_TIME;
+            uint64_t total=0;
+            bool     same=true;
+            for(int i=0;i<n;++i){
+                if(src[i]->t_end>t_end) t_end=src[i]->t_end;
+                total+=src[i]->lines;
+                same&=(src[i]->hash==src[0]->hash && src[i]->lines==src[0]->lines);
+            }
+            if(!same) errors++;
+            double cyc=(t_end-t0)/period;
+            double lpc=total/cyc;
+            if(n==1) base=lpc;
+            std::cout<<"[MULTI-RU] n="<<n<<" lines="<<total<<" cycles="<<cyc
+                     <<" lines/cycle="<<lpc<<" scaling="<<(base>0?lpc/base:0)
+                     <<" host_lines/s="<<(host>0?total/host:0)
+                     <<(same?"":"  ADDRESS MISMATCH")<<std::endl;
+        }
+        for(auto* d:dut){
+            const ru_stats& s=d->get_stats();
+            std::cout<<"[MULTI-RU] "<<d->name()<<" last round: packets="<<s.packets
+                     <<" lines="<<s.lines_out<<" cycles="<<s.cycles<<std::endl;
+        }
+        payload_pool_base::report(std::cout);
+        sc_stop();
+    }
+};
+
+int sc_main(int argc,char* argv[]){
+    int      num_ru=(argc>1)?std::atoi(argv[1]):8;
+    uint32_t rows  =(argc>2)?std::atoi(argv[2]):64;
+    uint32_t cols  =(argc>3)?std::atoi(argv[3]):64;
+    if(num_ru<1) num_ru=1;
+
+    ru_addr_cfg acfg;                       /* legacy mapping */
+    if(argc>4){
+        char* cargv[]={argv[0],argv[4]};
+        common_register_map regs;
+        tb_config::instance().load(2,cargv);
+        tb_config::instance().get_cfg_registers(regs);
+        acfg=ru_addr_cfg::from_regs(regs);
+        rows=acfg.rows; cols=acfg.cols;
+    }
+    rows=(rows+RU_NUM_PORTS-1)/RU_NUM_PORTS*RU_NUM_PORTS;
+
+    sc_clock clk("clk",10,SC_NS);
+    multi_ru_top top("top",num_ru,rows,cols,clk.period(),acfg);
+    top.clk(clk);
+    sc_start();
+    return top.errors?1:0;
+}
@@ -58,12 +58,12 @@ void ru::main_thread()
             }
             if(++fill_count[line]==4){
                 if(fused){
-                    auto o = std::make_shared<ru2mlsu>();
+                    auto o = make_payload<ru2mlsu_PTR>();
                     o->data = aggregator[line];
                     o->done = pkt->done;
                     o_ru2mlsu[line].write(o);
                 } else {
-                    auto o = std::make_shared<ru2tcm>();
+                    auto o = make_payload<ru2tcm_be_PTR>();
                     o->data    = aggregator[line];
                     o->address = addr16;
                     o->done    = pkt->done;
@@ -3,8 +3,9 @@
 #include <memory>
 #include "npudefine.hpp"
 #include "mmu2ru.hpp"
-#include "ru2tcm.hpp"
+#include "ru2tcm_be.hpp"
 #include "ru2mlsu.hpp"
+#include "payload_pool.hpp"
 
 using npuc2mmu_PTR = std::shared_ptr<npuc2mmu>;
 using mmu2npuc_PTR = std::shared_ptr<mmu2npuc>;
@@ -19,7 +20,7 @@ public:
     sc_fifo_in<npuc2mmu_PTR>      i_npuc2mu;
     sc_fifo_in<mmu2npuc_PTR>      i_mmu2npuc;
     sc_vector< sc_fifo_in<mmu2ru_PTR> >  i_mmu2ru;
-    sc_vector< sc_fifo_out<ru2tcm_PTR> > o_ru2tcm;
+    sc_vector< sc_fifo_out<ru2tcm_be_PTR> > o_ru2tcm;
     sc_vector< sc_fifo_out<ru2mlsu_PTR> >o_ru2mlsu;
     sc_fifo_in<sfr_PTR>           i_reg_map;
 
@@ -0,0 +1,40 @@
+/*********************
+* Author : ABC at abc
+* File   : ru2tcm_be.hpp
+* RU -> TCM write with byte enables. The NPU common ru2tcm (data, address,
+* done) has no byte enable field, so this payload extends it rather than
+* redefining it: byte_en has one bit per data byte and the TCM writes only
+* enabled bytes, so a partially combined line does not overwrite its missing
+* chunks. A TCM that only takes ru2tcm_PTR gets full lines through
+* to_ru2tcm().
+*********************/
+#pragma once
+#include "systemc.h"
+#include "ru2tcm.hpp"
+#include "payload_pool.hpp"
+
+struct ru2tcm_be : ru2tcm {
+    sc_bv<64> byte_en;
+
+    void reset() { data = 0; address = 0; done = 0; byte_en = 0; }
+};
+
+typedef pool_ptr<ru2tcm_be> ru2tcm_be_PTR;
+
+// Common payload for the same line; only valid for a full line
+inline ru2tcm_PTR to_ru2tcm(const ru2tcm_be_PTR& p)
+{
+    auto o = make_payload<ru2tcm_PTR>();
+    o->data    = p->data;
+    o->address = p->address;
+    o->done    = p->done;
+    return o;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const ru2tcm_be_PTR& p)
+{
+    if(p) os << "ru2tcm_be{address=0x" << std::hex << p->address.to_uint() << std::dec
+             << " done=" << p->done.to_uint() << "}";
+    else  os << "ru2tcm_be{null}";
+    return os;
+}
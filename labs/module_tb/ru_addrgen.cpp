@@ -0,0 +1,72 @@
+/*********************
+* Author : ABC at abc
+* File   : ru_addrgen.cpp
+*********************/
+#include "ru_addrgen.hpp"
+
+ru_addr_cfg ru_addr_cfg::from_regs(const common_register_map& r)
+{
+    ru_addr_cfg c;
+    c.legacy     = false;
+    c.rows       = r.option_tensor_size_size_m*8;
+    c.cols       = r.option_tensor_size_size_n*32;
+    c.base       = r.addr_tensor_matrix_c_base_matrix_c_base_addr;
+    c.row_stride = r.addr_tensor_matrix_c_stride_matrix_c_row_stride;
+    c.col_stride = r.addr_tensor_matrix_c_stride_matrix_c_col_stride;
+    return c;
+}
+
+void ru_addrgen::configure(const ru_addr_cfg& cfg,bool tables)
+{
+    cfg_=cfg;
+    if(cfg_.bank_bytes==0 || (cfg_.bank_bytes&(cfg_.bank_bytes-1))) cfg_.bank_bytes=64;
+
+    /* tile-major: 64-byte elements, row-major inside a tile, tiles
+       row-major over the matrix */
+    if(cfg_.layout==RU_LAYOUT_BLOCKED && cfg_.tile_rows && cfg_.tile_cols){
+        uint32_t tiles_per_row=(cfg_.cols+cfg_.tile_cols-1)/cfg_.tile_cols;
+        cfg_.col_stride      = 64;
+        cfg_.row_stride      = cfg_.tile_cols*64;
+        cfg_.tile_col_stride = cfg_.tile_rows*cfg_.tile_cols*64;
+        cfg_.tile_row_stride = tiles_per_row*cfg_.tile_col_stride;
+    }
+    if(tables) build();
+    else for(auto& t:tab_) t.clear();
+}
+
+uint16_t ru_addrgen::map(uint32_t r,uint32_t c) const
+{
+    const ru_addr_cfg& g=cfg_;
+    uint32_t tr = g.tile_rows ? g.tile_rows : 0xFFFFFFFFu;
+    uint32_t tc = g.tile_cols ? g.tile_cols : 0xFFFFFFFFu;
+    uint32_t a  = g.base
+                + (r/tr)*g.tile_row_stride + (c/tc)*g.tile_col_stride
+                + (r%tr)*g.row_stride      + (c%tc)*g.col_stride;
+
+    uint32_t gran = a / g.bank_bytes;
+    uint32_t set  = gran / RU_NUM_BANKS;
+    uint32_t bank = gran % RU_NUM_BANKS;
+    switch(g.swizzle){
+        case RU_SWZ_XOR: bank ^= set % RU_NUM_BANKS;                 break;
+        case RU_SWZ_ROT: bank  = (bank + set) % RU_NUM_BANKS;        break;
+        default:                                                     break;
+    }
+    uint32_t off = (set*g.bank_bytes + a%g.bank_bytes) & 0x7FF;
+    return (uint16_t)((bank<<11)|off);
+}
+
+void ru_addrgen::build()
+{
+    for(auto& t:tab_) t.clear();
+    if(cfg_.legacy || cfg_.cols==0 || transposed()) return;   /* at_t() computes its own */
+
+    for(int p=0;p<RU_NUM_PORTS;++p){
+        uint32_t prow = cfg_.rows>(uint32_t)p
+                      ? (cfg_.rows-p+RU_NUM_PORTS-1)/RU_NUM_PORTS : 0;   // rows on port p
+        std::vector<uint16_t>& t=tab_[p];
+        t.reserve((size_t)prow*cfg_.cols);
+        for(uint32_t i=0;i<prow;++i)
+            for(uint32_t c=0;c<cfg_.cols;++c)
+                t.push_back(map(p+RU_NUM_PORTS*i,c));
+    }
+}
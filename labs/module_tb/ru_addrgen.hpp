@@ -0,0 +1,107 @@
+/*********************
+* Author : ABC at abc
+* File   : ru_addrgen.hpp
+* Programmable TCM address generator for the RU.
+*
+* Element (r,c) of C goes to byte address
+*     base + (r/tile_rows)*tile_row_stride + (c/tile_cols)*tile_col_stride
+*          + (r%tile_rows)*row_stride      + (c%tile_cols)*col_stride
+* (tile_rows/tile_cols = 0: one tile, plain 2-D strides), which is split
+* over the 32 TCM banks in bank_bytes granules:
+*     granule = addr / bank_bytes
+*     bank    = swizzle(granule % 32, granule / 32)
+*     offset  = (granule / 32) * bank_bytes + addr % bank_bytes   (11 bits)
+*     addr16  = bank<<11 | offset,  as in make_addr16
+*
+* Port p of the MMU carries rows p, p+16, p+32 ...; the k-th element on a
+* port is row p+16*(k/cols), column k%cols. The addresses of all ports are
+* computed once per job (build()) and read back per packet (at()).
+* legacy=1 keeps the fixed make_addr16 mapping (64-column rollover).
+*
+* layout selects how C lands in the TCM:
+*   RU_LAYOUT_ROW         the strides above as given
+*   RU_LAYOUT_BLOCKED     tile-major: tiles of tile_rows x tile_cols elements
+*                         stored one after another, row-major inside and
+*                         between tiles; strides derived in configure()
+*   RU_LAYOUT_TRANSPOSED  C^T. An element is 64 int8 columns of one row, so
+*                         C^T element (r',c') holds column r' of C for rows
+*                         64c'..64c'+63. The RU transposes 16x16 byte blocks
+*                         (one packet from each port) and places the 16-byte
+*                         pieces with at_t(); rows/cols are those of C,
+*                         base/strides/swizzle those of C^T.
+*********************/
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "sfr/unique_registers.h"
+
+constexpr int RU_NUM_PORTS = 16;   // MMU output ports
+constexpr int RU_NUM_BANKS = 32;   // TCM banks
+
+enum ru_swizzle {
+    RU_SWZ_NONE = 0,    // bank = granule % 32
+    RU_SWZ_XOR  = 1,    // bank ^= (granule/32) % 32, rows of a column spread over banks
+    RU_SWZ_ROT  = 2     // bank  = (bank + granule/32) % 32
+};
+
+enum ru_layout {
+    RU_LAYOUT_ROW        = 0,
+    RU_LAYOUT_BLOCKED    = 1,
+    RU_LAYOUT_TRANSPOSED = 2
+};
+
+struct ru_addr_cfg {
+    bool       legacy{true};
+    ru_layout  layout{RU_LAYOUT_ROW};
+    uint32_t   rows{0}, cols{0};              // job size in elements
+    uint32_t   base{0};
+    uint32_t   row_stride{0}, col_stride{0};  // bytes
+    uint32_t   tile_rows{0}, tile_cols{0};    // 0 => no tiling
+    uint32_t   tile_row_stride{0}, tile_col_stride{0};
+    uint32_t   bank_bytes{64};                // power of two
+    ru_swizzle swizzle{RU_SWZ_NONE};
+
+    /* C-matrix base/strides and M x N from the register map, as tb_config
+       loads them (M in units of 8 rows, N in units of 32 columns) */
+    static ru_addr_cfg from_regs(const common_register_map& r);
+};
+
+inline uint16_t make_addr16(uint32_t r,uint32_t c)
+{
+    uint16_t bank   = ((r & 0xF) << 1) | (c >> 1);        // 0‑31
+    uint16_t offset = (r>>4)*64 + ((c&1)?32:0);           // 0‑224
+    return (bank<<11)|offset;                             // 5+11 bits
+}
+
+class ru_addrgen {
+public:
+    /* and build(); tables=false keeps map()/at_t() only, O(1) memory for
+       checkers that regenerate addresses */
+    void     configure(const ru_addr_cfg& cfg,bool tables=true);
+    void     build();
+    const ru_addr_cfg& cfg() const { return cfg_; }
+
+    /* address of the k-th element on port p */
+    uint16_t at(int port,uint64_t k) const {
+        if(cfg_.legacy) return make_addr16((uint32_t)(k/64),(uint32_t)(k%64));
+        const std::vector<uint16_t>& t=tab_[port];
+        return t.empty()?0:t[k%t.size()];   /* next job repeats the layout */
+    }
+
+    uint16_t map(uint32_t r,uint32_t c) const;   // one element, no table
+
+    bool     transposed() const { return !cfg_.legacy && cfg_.layout==RU_LAYOUT_TRANSPOSED; }
+    /* transposed: lane j of chunk k of the idx-th element of every port is
+       C^T row 64*(idx%cols)+16k+j; the element's row group g=idx/cols is
+       C^T element column g/4, chunk g%4 */
+    uint16_t at_t(uint64_t idx,unsigned k,unsigned j) const {
+        uint64_t g=cfg_.cols ? idx/cfg_.cols : 0;
+        uint32_t c=cfg_.cols ? (uint32_t)(idx%cfg_.cols) : 0;
+        return map(64*c+16*k+j,(uint32_t)(g/4));
+    }
+
+private:
+    ru_addr_cfg cfg_;
+    std::vector<uint16_t> tab_[RU_NUM_PORTS];
+};
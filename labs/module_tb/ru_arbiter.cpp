@@ -0,0 +1,72 @@
+/*********************
+* Author : ABC at abc
+* File   : ru_arbiter.cpp
+*********************/
+#include "ru_arbiter.hpp"
+
+void ru_arbiter::configure(const ru_arb_cfg& cfg)
+{
+    cfg_=cfg;
+    if(cfg_.max_pkts==0)  cfg_.max_pkts=1;
+    if(cfg_.max_pkts>RU_NUM_PORTS) cfg_.max_pkts=RU_NUM_PORTS;   /* one per port at most */
+    if(cfg_.max_lines==0) cfg_.max_lines=1;
+    lim_=0;
+    for(auto& w:cfg_.weight){ if(w==0) w=1; lim_+=w; }
+    lim_*=(int32_t)cfg_.max_pkts;
+    reset();
+}
+
+static inline int32_t clamp_bal(int32_t b,int32_t lim){ return b>lim ? lim : b<-lim ? -lim : b; }
+
+void ru_arbiter::reset()
+{
+    next_=0;
+    for(int p=0;p<RU_NUM_PORTS;++p){ bal_[p]=0; st_[p]=ru_port_stats{}; }
+}
+
+int ru_arbiter::order(uint32_t ready,int (&out)[RU_NUM_PORTS])
+{
+    int n=0;
+    if(cfg_.policy==RU_ARB_FIXED){
+        for(int p=0;p<RU_NUM_PORTS;++p) if(ready>>p&1) out[n++]=p;
+        return n;
+    }
+
+    /* RR from next_ */
+    for(int i=0;i<RU_NUM_PORTS;++i){
+        int p=(next_+i)%RU_NUM_PORTS;
+        if(ready>>p&1) out[n++]=p;
+    }
+
+    /* weighted: every ready port earns weight*max_pkts, each packet taken
+       costs the sum of the ready weights (update()); highest balance first,
+       RR order between equals */
+    if(cfg_.policy==RU_ARB_WEIGHTED){
+        for(int i=0;i<n;++i)
+            bal_[out[i]]=clamp_bal(bal_[out[i]]+(int32_t)cfg_.weight[out[i]]*cfg_.max_pkts,lim_);
+        for(int i=1;i<n;++i)
+            for(int j=i;j>0 && bal_[out[j]]>bal_[out[j-1]];--j){
+                int t=out[j]; out[j]=out[j-1]; out[j-1]=t;
+            }
+    }
+    return n;
+}
+
+void ru_arbiter::update(uint32_t ready,uint32_t taken,uint32_t held)
+{
+    int32_t w=0;
+    for(int p=0;p<RU_NUM_PORTS;++p) if(ready>>p&1) w+=cfg_.weight[p];
+
+    int last=-1;
+    for(int i=0;i<RU_NUM_PORTS;++i){
+        int p=(next_+i)%RU_NUM_PORTS;
+        if(taken>>p&1){
+            st_[p].granted++;
+            bal_[p]=clamp_bal(bal_[p]-w,lim_);
+            last=p;
+        }
+        else if(held>>p&1)  st_[p].backpressure++;
+        else if(ready>>p&1) st_[p].stalled++;
+    }
+    if(cfg_.policy!=RU_ARB_FIXED && last>=0) next_=(last+1)%RU_NUM_PORTS;
+}
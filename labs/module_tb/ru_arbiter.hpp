@@ -0,0 +1,62 @@
+/*********************
+* Author : ABC at abc
+* File   : ru_arbiter.hpp
+* Arbiter over the 16 MMU input ports of the RU.
+*
+* Each cycle the RU asks for the ready ports in priority order (order()),
+* takes packets from them until max_pkts are taken, and reports which
+* ports it took (update()) so the policy can move on:
+*   RU_ARB_FIXED     port 0 first, every cycle (the old main_thread loop)
+*   RU_ARB_RR        round robin, starts after the last port taken
+*   RU_ARB_WEIGHTED  smooth weighted round robin: under load port p gets
+*                    weight[p]/sum(weight) of the packets taken; a port's
+*                    balance is held within +-sum(weight)*max_pkts, so one
+*                    backpressured or lone ready port cannot bank credit
+*                    (or debt) for longer than a round
+* The RU also emits at most max_lines output lines per cycle. Lines that
+* cannot go out stay in the write-combining buffer; a port whose line has
+* no free way keeps its packet and counts as backpressured.
+*********************/
+#pragma once
+#include <cstdint>
+#include "ru_addrgen.hpp"
+
+enum ru_arb_policy {
+    RU_ARB_FIXED    = 0,
+    RU_ARB_RR       = 1,
+    RU_ARB_WEIGHTED = 2
+};
+
+struct ru_arb_cfg {
+    ru_arb_policy policy{RU_ARB_FIXED};
+    unsigned      max_pkts{RU_NUM_PORTS};   // packets taken per cycle
+    unsigned      max_lines{4};             // output lines per cycle
+    uint8_t       weight[RU_NUM_PORTS]{1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1};
+};
+
+struct ru_port_stats {
+    uint64_t granted      = 0;   // packets taken
+    uint64_t stalled      = 0;   // cycles with a packet, not taken (arbitration)
+    uint64_t backpressure = 0;   // cycles with a packet, held by the output side
+};
+
+class ru_arbiter {
+public:
+    void configure(const ru_arb_cfg& cfg);
+    void reset();
+    const ru_arb_cfg& cfg() const { return cfg_; }
+
+    /* ready ports (bit p) in priority order; returns how many */
+    int  order(uint32_t ready,int (&out)[RU_NUM_PORTS]);
+    /* end of cycle: taken = ports served, held = ports backpressured */
+    void update(uint32_t ready,uint32_t taken,uint32_t held);
+
+    const ru_port_stats& stats(int p) const { return st_[p]; }
+
+private:
+    ru_arb_cfg    cfg_;
+    int           next_{0};                  // RR start port
+    int32_t       bal_[RU_NUM_PORTS]{};   // weighted: earned minus spent
+    int32_t       lim_{RU_NUM_PORTS*RU_NUM_PORTS};   // |bal_| bound, one round of credit
+    ru_port_stats st_[RU_NUM_PORTS];
+};
@@ -0,0 +1,293 @@
+/*********************
+* Author : ABC at abc
+* File   : ru_bench_main.cpp
+* RU arbitration bench.
+*  1) ru_arbiter alone: round robin and weighted shares with every port
+*     ready, and a port released after a long backpressure, which must not
+*     take more than a round's worth of packets.
+*  2) one ru_funccore with an MMU stream that keeps every port full, under
+*     RR and weighted policies and packet budgets: the granted counts are
+*     sampled while all ports still have data and compared with the weights.
+*  3) the same stream with TCM banks busy for several cycles per write, in
+*     order and with reorder: conflicts only appear with busy_cycles > 1,
+*     every write is counted on a bank, and reorder waits less and finishes
+*     no later than in-order.
+* Prints one line per case and exits nonzero on any failed check.
+* Usage: ru_bench_main [rows=64] [cols=8]
+*********************/
+#include "ru_funccore.hpp"
+#include "mmu2ru.hpp"
+#include "ru2tcm_be.hpp"
+#include "ru2mlsu.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+static int errors=0;
+
+static void check(bool ok,const std::string& what)
+{
+    if(!ok){ errors++; std::cerr<<"[RU-BENCH] FAIL "<<what<<"\n"; }
+}
+
+/* ── 1) arbiter alone ──────────────────────────────────────────────────*/
+/* every port ready for n cycles, the first max_pkts in order are taken */
+static void run_arb(ru_arbiter& a,uint64_t n,uint32_t held=0)
+{
+    for(uint64_t c=0;c<n;++c){
+        int order[RU_NUM_PORTS];
+        int k=a.order(0xFFFF,order);
+        uint32_t taken=0;
+        unsigned pkts=0;
+        for(int i=0;i<k && pkts<a.cfg().max_pkts;++i){
+            if(held>>order[i]&1) continue;
+            taken|=1u<<order[i]; pkts++;
+        }
+        a.update(0xFFFF,taken,held);
+    }
+}
+
+static void arb_shares(const char* name,const ru_arb_cfg& cfg,uint64_t rounds)
+{
+    ru_arbiter a;
+    a.configure(cfg);
+    unsigned wsum=0;
+    for(int p=0;p<RU_NUM_PORTS;++p) wsum+=a.cfg().weight[p];
+    bool     rr=(cfg.policy==RU_ARB_RR);
+    uint64_t cycles=rounds*(rr?RU_NUM_PORTS:wsum);   /* whole rounds of packets */
+    run_arb(a,cycles);
+
+    uint64_t worst=0;
+    for(int p=0;p<RU_NUM_PORTS;++p){
+        uint64_t want=rounds*a.cfg().max_pkts*(rr?1:a.cfg().weight[p]);
+        uint64_t got =a.stats(p).granted;
+        uint64_t d   =got>want?got-want:want-got;
+        if(d>worst) worst=d;
+    }
+    std::cout<<"[RU-BENCH] arbiter "<<name<<": max_pkts="<<a.cfg().max_pkts
+             <<" cycles="<<cycles<<" worst share error="<<worst<<" packets\n";
+    check(worst<=a.cfg().max_pkts,std::string("arbiter ")+name+" shares");
+}
+
+/* port 0 held for a long time, then released: with all weights equal it
+   should get about 1/16 of the packets, not all of them until its credit
+   from the held cycles runs out */
+static void arb_release()
+{
+    ru_arb_cfg cfg;
+    cfg.policy=RU_ARB_WEIGHTED; cfg.max_pkts=1;
+    ru_arbiter a;
+    a.configure(cfg);
+    run_arb(a,100000,1u);
+    uint64_t g0=a.stats(0).granted;
+    run_arb(a,64);
+    uint64_t burst=a.stats(0).granted-g0;
+    std::cout<<"[RU-BENCH] arbiter release after 100000 held cycles: port 0 took "
+             <<burst<<" of the next 64 packets\n";
+    check(burst<=8,"arbiter release burst");
+}
+
+/* ── 2) RU under load ──────────────────────────────────────────────────*/
+/* MMU side: element (r,c) is 4 packets on port r&0xF, done on the 4th; one
+   packet per port per cycle whenever its FIFO has room. Output side: every
+   line drained each cycle. snap[] holds the granted counts of the cycle
+   the first port sent its last packet. */
+SC_MODULE(ru_bench_src){
+    sc_in<bool> clk;
+    sc_vector< sc_fifo_out<mmu2ru_PTR> > o_mmu2ru;
+    sc_vector< sc_fifo_in <ru2tcm_be_PTR> > i_ru2tcm;
+    sc_vector< sc_fifo_in <ru2mlsu_PTR> >i_ru2mlsu;
+
+    ru_funccore* dut{nullptr};
+    bool     active{false}, snapped{false};
+    uint64_t per_port{0}, sent[RU_NUM_PORTS]{};
+    uint64_t expect{0}, dones{0}, cycles{0};
+    uint64_t snap[RU_NUM_PORTS]{};
+
+    SC_HAS_PROCESS(ru_bench_src);
+    explicit ru_bench_src(sc_module_name n)
+    : sc_module(n), o_mmu2ru("o_mmu2ru",RU_NUM_PORTS),
+      i_ru2tcm("i_ru2tcm",RU_NUM_LINES), i_ru2mlsu("i_ru2mlsu",RU_NUM_LINES)
+    { SC_CTHREAD(run, clk.pos()); }
+
+    void start(uint32_t rows,uint32_t cols){
+        per_port=(uint64_t)(rows/RU_NUM_PORTS)*cols*4;
+        for(auto& s:sent) s=0;
+        expect=(uint64_t)rows*cols; dones=0; cycles=0;
+        snapped=false; active=true;
+    }
+
+    void run(){
+        while(true){
+            wait();
+            if(!active) continue;
+            cycles++;
+            for(int p=0;p<RU_NUM_PORTS;++p){
+                if(sent[p]==per_port || !o_mmu2ru[p].num_free()) continue;
+                auto pkt=make_payload<mmu2ru_PTR>();
+                for(int b=0;b<16;++b) pkt->C_data[b]=(uint8_t)(sent[p]*16+b);
+                pkt->done=((sent[p]&3)==3);
+                o_mmu2ru[p].write(pkt);
+                sent[p]++;
+            }
+            if(!snapped){
+                bool out=false;
+                for(int p=0;p<RU_NUM_PORTS;++p) out|=(sent[p]==per_port);
+                if(out){
+                    for(int p=0;p<RU_NUM_PORTS;++p) snap[p]=dut->get_port_stats(p).granted;
+                    snapped=true;
+                }
+            }
+            for(int l=0;l<RU_NUM_LINES;++l){
+                while(i_ru2tcm[l].num_available())  dones+=i_ru2tcm[l].read()->done==1;
+                while(i_ru2mlsu[l].num_available()) dones+=i_ru2mlsu[l].read()->done==1;
+            }
+            if(dones>=expect) active=false;
+        }
+    }
+};
+
+/* C is row-major with each row padded by row_pad elements: 2 puts the 16
+   ports on different banks, spread over the four lines; with 8 columns,
+   28 makes rows 36 granules apart, so ports p and p+8 share a bank and
+   each line holds two banks */
+struct ru_bench_case {
+    const char* name;
+    ru_arb_cfg  arb;
+    ru_bank_cfg bank;
+    uint32_t    row_pad;
+};
+
+struct ru_bench_result {
+    uint64_t cycles{0}, conflicts{0};
+};
+
+SC_MODULE(ru_bench_top){
+    sc_in<bool> clk;
+    sc_signal<bool> rst;
+
+    ru_funccore  dut;
+    ru_bench_src src;
+    sc_fifo<npuc2mmu_PTR> f_cmd;
+    sc_fifo<mmu2npuc_PTR> f_rsp;
+    sc_fifo<sfr_PTR>      f_sfr;
+    sc_vector< sc_fifo<mmu2ru_PTR> >  f_in;
+    sc_vector< sc_fifo<ru2tcm_be_PTR> >  f_tcm;
+    sc_vector< sc_fifo<ru2mlsu_PTR> > f_mlsu;
+
+    uint32_t rows, cols;
+    std::vector<ru_bench_case>   cases;
+    std::vector<ru_bench_result> results;
+
+    SC_HAS_PROCESS(ru_bench_top);
+    ru_bench_top(sc_module_name n,uint32_t m,uint32_t c)
+    : sc_module(n), dut("dut"), src("src"), f_cmd("cmd",2), f_rsp("rsp",2), f_sfr("sfr",2),
+      f_in("in",RU_NUM_PORTS,[](const char* nm,size_t){ return new sc_fifo<mmu2ru_PTR>(nm,4); }),
+      f_tcm("tcm",RU_NUM_LINES,[](const char* nm,size_t){ return new sc_fifo<ru2tcm_be_PTR>(nm,4); }),
+      f_mlsu("mlsu",RU_NUM_LINES,[](const char* nm,size_t){ return new sc_fifo<ru2mlsu_PTR>(nm,4); }),
+      rows(m), cols(c)
+    {
+        dut.clk(clk); dut.reset(rst); src.clk(clk);
+        dut.i_npuc2mmu(f_cmd); dut.i_mmu2npuc(f_rsp); dut.i_reg_map(f_sfr);
+        for(int p=0;p<RU_NUM_PORTS;++p){ dut.i_mmu2ru[p](f_in[p]); src.o_mmu2ru[p](f_in[p]); }
+        for(int l=0;l<RU_NUM_LINES;++l){
+            dut.o_ru2tcm[l](f_tcm[l]);   src.i_ru2tcm[l](f_tcm[l]);
+            dut.o_ru2mlsu[l](f_mlsu[l]); src.i_ru2mlsu[l](f_mlsu[l]);
+        }
+        src.dut=&dut;
+        SC_CTHREAD(control, clk.pos());
+    }
+
+    void control(){
+        for(const ru_bench_case& c:cases){
+            ru_addr_cfg a;
+            a.legacy=false; a.rows=rows; a.cols=cols;
+            a.row_stride=64*(cols+c.row_pad); a.col_stride=64;
+            dut.set_addr_cfg(a);
+            dut.set_arb_cfg(c.arb);
+            dut.set_bank_cfg(c.bank);
+            rst=true;  wait(2);
+            rst=false; wait();
+            src.start(rows,cols);
+            while(src.active && src.cycles<1000000) wait();
+            check(!src.active,std::string(c.name)+" finished");
+            report(c);
+        }
+        payload_pool_base::report(std::cout);
+        sc_stop();
+    }
+
+    /* shares of the packets granted before the first port sent its last */
+    void report(const ru_bench_case& c){
+        const ru_stats& s=dut.get_stats();
+        uint64_t total=0;
+        unsigned wsum=0;
+        for(int p=0;p<RU_NUM_PORTS;++p){ total+=src.snap[p]; wsum+=c.arb.weight[p]; }
+        double worst=0;
+        for(int p=0;p<RU_NUM_PORTS && total;++p){
+            double want=(c.arb.policy==RU_ARB_WEIGHTED) ? (double)c.arb.weight[p]/wsum
+                                                        : 1.0/RU_NUM_PORTS;
+            double got =(double)src.snap[p]/total;
+            double err =(got-want)/want;
+            if(err<0) err=-err;
+            if(err>worst) worst=err;
+        }
+        const ru_bank_stats& b=dut.get_bank_stats();
+        uint64_t writes=0, conflicts=0;
+        for(int k=0;k<RU_NUM_BANKS;++k){ writes+=b.writes[k]; conflicts+=b.conflicts[k]; }
+        std::cout<<"[RU-BENCH] "<<c.name<<": cycles="<<s.cycles<<" packets="<<s.packets
+                 <<" lines="<<s.lines_out<<" max share error="<<(int)(worst*100+0.5)<<"%"
+                 <<" bank writes="<<writes<<" conflicts="<<conflicts<<"\n";
+        /* shares follow the policy only while the packet budget is what
+           limits the ports, not the output side */
+        if(c.arb.policy!=RU_ARB_FIXED && c.arb.max_pkts<RU_NUM_PORTS)
+            check(worst<=0.05,std::string(c.name)+" shares");
+        check(writes==s.lines_out,std::string(c.name)+" bank writes");
+        check((c.bank.busy_cycles<=1)==(conflicts==0),std::string(c.name)+" conflicts");
+        results.push_back({s.cycles,conflicts});
+    }
+};
+
+int sc_main(int argc,char* argv[]){
+    uint32_t rows=(argc>1)?std::atoi(argv[1]):64;
+    uint32_t cols=(argc>2)?std::atoi(argv[2]):8;
+    rows=(rows+RU_NUM_PORTS-1)/RU_NUM_PORTS*RU_NUM_PORTS;
+
+    ru_arb_cfg rr;
+    rr.policy=RU_ARB_RR; rr.max_pkts=4;
+    ru_arb_cfg wt;
+    wt.policy=RU_ARB_WEIGHTED; wt.max_pkts=4;
+    for(int p=0;p<RU_NUM_PORTS;++p) wt.weight[p]=1+p%4;
+
+    arb_shares("rr",rr,1000);
+    arb_shares("weighted",wt,1000);
+    wt.max_pkts=1;
+    arb_shares("weighted",wt,1000);
+    wt.max_pkts=4;
+    arb_release();
+
+    sc_clock clk("clk",10,SC_NS);
+    ru_bench_top top("top",rows,cols);
+    top.clk(clk);
+    top.cases.push_back({"rr 4 pkts/cycle",rr,ru_bank_cfg{},2});
+    top.cases.push_back({"weighted 4 pkts/cycle",wt,ru_bank_cfg{},2});
+    wt.max_pkts=2; wt.max_lines=1;
+    top.cases.push_back({"weighted 2 pkts, 1 line/cycle",wt,ru_bank_cfg{},2});
+    ru_arb_cfg full;
+    full.policy=RU_ARB_RR;
+    top.cases.push_back({"rr 16 pkts, shared banks",full,ru_bank_cfg{},28});
+    ru_bank_cfg busy;
+    busy.busy_cycles=4; busy.reorder=true;
+    top.cases.push_back({"rr 16 pkts, shared banks busy 4, reorder",full,busy,28});
+    busy.reorder=false;
+    top.cases.push_back({"rr 16 pkts, shared banks busy 4, in order",full,busy,28});
+    sc_start();
+
+    const ru_bench_result& ro=top.results[4];
+    const ru_bench_result& io=top.results[5];
+    check(ro.conflicts<io.conflicts,"reorder conflicts");
+    check(ro.cycles<=io.cycles,"reorder cycles");
+
+    std::cout<<"[RU-BENCH] "<<(errors?"FAIL":"PASS")<<" errors="<<errors<<"\n";
+    return errors?1:0;
+}
@@ -0,0 +1,21 @@
+/*********************
+* Author : ABC at abc
+* File   : ru_epilogue.cpp
+*********************/
+#include "ru_epilogue.hpp"
+
+void ru_epilogue(const ru_epi_cfg& cfg,uint8_t (&lane)[RU_PKT_BYTES])
+{
+    const unsigned sh  = cfg.shift & 31;
+    const int64_t  rnd = sh ? (int64_t)1<<(sh-1) : 0;
+    const int64_t  lo  = cfg.relu ? 0 : -128;
+
+    int64_t y[RU_PKT_BYTES];
+    for(int b=0;b<RU_PKT_BYTES;++b)
+        y[b]=((int64_t)(int8_t)lane[b]+cfg.bias[b])*cfg.scale;
+    for(int b=0;b<RU_PKT_BYTES;++b){
+        int64_t v=(y[b]+rnd)>>sh;
+        v = v<lo ? lo : v>127 ? 127 : v;
+        lane[b]=(uint8_t)(int8_t)v;
+    }
+}
@@ -0,0 +1,27 @@
+/*********************
+* Author : ABC at abc
+* File   : ru_epilogue.hpp
+* Requantize/activation stage on the RU fused (ru2mlsu) path.
+*
+* Applied to each mmu2ru packet as it enters the line, lane b = byte b:
+*     acc = (int8)C_data[b] + bias[b]                       (int32)
+*     y   = (acc * scale + 2^(shift-1)) >> shift            (round half up)
+*     y   = relu ? max(y,0) : y,  saturated to int8
+* The 16 lanes are independent fixed-size loops, so the host compiler
+* vectorizes them. enable=0 forwards the raw bytes as before.
+*********************/
+#pragma once
+#include <cstdint>
+
+constexpr int RU_PKT_BYTES = 16;   // int8 lanes per mmu2ru packet
+
+struct ru_epi_cfg {
+    bool     enable{false};
+    bool     relu{false};
+    int32_t  scale{1};                   // fixed-point multiplier
+    uint8_t  shift{0};                   // right shift after scale, 0..31
+    int32_t  bias[RU_PKT_BYTES]{};       // per lane
+};
+
+/* requantize 16 lanes in place */
+void ru_epilogue(const ru_epi_cfg& cfg,uint8_t (&lane)[RU_PKT_BYTES]);
@@ -3,51 +3,256 @@
 * File   : ru_funccore.cpp
 *********************/
 #include "ru_funccore.hpp"
+#include "mmu2ru.hpp"
+#include "ru2tcm_be.hpp"
+#include "ru2mlsu.hpp"
 #include <cstring>
-
-constexpr int  NUM_PORTS = 16;
-constexpr int  NUM_LINES = 4;
+#include <iostream>
 
 /* ── helpers ────────────────────────────────────────────────────────────*/
-inline uint16_t make_addr16(uint32_t r,uint32_t c)
+inline unsigned line_of(uint16_t addr16){ return (addr16>>11)>>3; } // bank>>3
+
+/* 16×8b MMU packet → 16 bytes, through the epilogue when one is given */
+inline void get_lanes(uint8_t (&dst)[RU_PKT_BYTES],const mmu2ru& in,const ru_epi_cfg* epi)
 {
-    uint16_t bank   = ((r & 0xF) << 1) | (c >> 1);        // 0‑31
-    uint16_t offset = (r>>4)*64 + ((c&1)?32:0);           // 0‑224
-    return (bank<<11)|offset;                             // 5+11 bits
+    for(int b=0;b<RU_PKT_BYTES;++b) dst[b]=(uint8_t)in.C_data[b];
+    if(epi) ru_epilogue(*epi,dst);
 }
-inline unsigned line_of(uint16_t addr16){ return (addr16>>11)>>3; } // bank>>3
 
-/* ── constructor ───────────────────────────────────────────────────────*/
-#include "ru_funccore.hpp"
-#include "mmu2ru.hpp"
-#include "ru2tcm.hpp"
-#include "ru2mlsu.hpp"
+/* 16×8b MMU packet → chunk k (bytes 16k..16k+15) */
+inline void put_chunk(ru_line_buf& l,unsigned k,const mmu2ru& in,const ru_epi_cfg* epi)
+{
+    get_lanes(*reinterpret_cast<uint8_t(*)[RU_PKT_BYTES]>(l.bytes+16*k),in,epi);
+}
 
+/* line → sc_bv<512>, 16 word writes; only at the ru2tcm/ru2mlsu boundary */
+inline void to_bv(const ru_line_buf& l,sc_bv<512>& out)
+{
+    for(int w=0;w<16;++w){
+        const uint8_t* p=l.bytes+4*w;
+        uint32_t v= p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24);
+        out.range(32*w+31,32*w)=v;
+    }
+}
+
+/* ── constructor ───────────────────────────────────────────────────────*/
 ru_funccore::ru_funccore(sc_core::sc_module_name name)
 : sc_module(name), clk("clk"), reset("reset"),
   i_npuc2mmu("i_npuc2mmu"), i_mmu2npuc("i_mmu2npuc"),
-  i_mmu2ru ("i_mmu2ru",16), o_ru2tcm("o_ru2tcm",4),
-  o_ru2mlsu("o_ru2mlsu",4), i_reg_map("i_reg_map")
+  i_mmu2ru ("i_mmu2ru",RU_NUM_PORTS), o_ru2tcm("o_ru2tcm",RU_NUM_LINES),
+  o_ru2mlsu("o_ru2mlsu",RU_NUM_LINES), i_reg_map("i_reg_map")
 {
     SC_CTHREAD(main_thread, clk.pos());
     reset_signal_is(reset,true);
 }
 void ru_funccore::set_Id(int v){ id=v; }
 
-/* ── internal per‑port counter state ───────────────────────────────────*/
-struct state { uint32_t row=0,col=0; };
-state st[NUM_PORTS];
+void ru_funccore::set_arb_cfg(const ru_arb_cfg& c){ arb.configure(c); }
+
+void ru_funccore::set_addr_cfg(const ru_addr_cfg& c)
+{
+    agen.configure(c);
+    for(auto& s:st) s=port_state{};
+    for(auto& t:tbuf) t.valid=false;
+}
+
+/* ── state ─────────────────────────────────────────────────────────────*/
+void ru_funccore::reset_state()
+{
+    fused=false;
+    for(auto& s:st) s=port_state{};
+    for(auto& l:wcb) for(auto& e:l) e.valid=false;
+    for(auto& t:tbuf) t.valid=false;
+    stats=ru_stats{};
+    bstats=ru_bank_stats{};
+    for(auto& b:busy_until) b=0;
+    arb.reset();
+}
+
+/* ── write combining ───────────────────────────────────────────────────*/
+/* entry that takes chunk k of addr16: an open one for the same address,
+   else a free way; with no free way the oldest entry is flushed early and
+   the packet waits (nullptr) */
+ru_wcb_entry* ru_funccore::wcb_open(unsigned line,uint16_t addr16,unsigned k)
+{
+    ru_wcb_entry* ways=wcb[line];
+    ru_wcb_entry* free_way=nullptr;
+    for(int w=0;w<RU_WCB_WAYS;++w){
+        ru_wcb_entry& e=ways[w];
+        if(!e.valid){ if(!free_way) free_way=&e; continue; }
+        if(!e.flush && e.addr16==addr16 && !(e.mask>>k&1)){
+            stats.combined++;
+            return &e;
+        }
+    }
+    if(free_way){
+        ru_wcb_entry& e=*free_way;
+        e.valid=true; e.flush=false; e.done=false; e.mask=0;
+        e.addr16=addr16; e.first=stats.cycles;
+        std::memset(e.buf.bytes,0,sizeof(e.buf.bytes));   /* disabled bytes read as 0 */
+        return &e;
+    }
+
+    ru_wcb_entry* old=nullptr;
+    for(int w=0;w<RU_WCB_WAYS;++w)
+        if(!ways[w].flush && ways[w].mask!=0xF && (!old || ways[w].first<old->first))
+            old=&ways[w];
+    if(old){ old->flush=true; stats.evictions++; }
+    return nullptr;
+}
+
+/* full, flagged or timed out */
+bool ru_funccore::wcb_ready(const ru_wcb_entry& e) const
+{
+    bool timed_out = flush_timeout && stats.cycles-e.last>=flush_timeout;
+    return e.valid && (e.mask==0xF || e.flush || timed_out);
+}
+
+/* a done line waits for the ready entries without done that hold data of
+   the elements it closes and were last written no later than it: earlier
+   pieces of the same line, or when transposed (an element spans 64 C^T
+   lines) every such entry */
+bool ru_funccore::done_waits(const ru_wcb_entry& d) const
+{
+    bool any=agen.transposed();
+    for(auto& l:wcb) for(auto& c:l)
+        if(&c!=&d && !c.done && c.last<=d.last && (any || c.addr16==d.addr16)
+           && wcb_ready(c)) return true;
+    return false;
+}
+
+/* write out the oldest entry of the line that is ready, if the line
+   budget, FIFO and bank allow it. When the oldest one waits on a busy
+   bank, reorder lets the oldest eligible entry whose bank is free go
+   instead; in order, the line and every later one wait. */
+bool ru_funccore::wcb_drain(unsigned line,unsigned& lines,bool& in_order_stop)
+{
+    ru_wcb_entry* head=nullptr;   /* oldest eligible entry */
+    ru_wcb_entry* e=nullptr;      /* oldest eligible entry on a free bank */
+    for(int w=0;w<RU_WCB_WAYS;++w){
+        ru_wcb_entry& c=wcb[line][w];
+        if(!wcb_ready(c) || (c.done && done_waits(c))) continue;
+        if(!head || c.first<head->first) head=&c;
+        bool free_bank = fused || busy_until[c.addr16>>11]<=stats.cycles;
+        if(free_bank && (!e || c.first<e->first)) e=&c;
+    }
+    if(!head) return false;
+
+    if(e!=head){
+        bstats.conflicts[head->addr16>>11]++;
+        if(!bcfg.reorder){ in_order_stop=true; return false; }
+    }
+    bool room = fused ? o_ru2mlsu[line].num_free()>0
+                      : o_ru2tcm[line].num_free()>0;
+    if(!e || lines==arb.cfg().max_lines || !room || in_order_stop) return false;
+    unsigned bank=e->addr16>>11;
+
+    if(e->mask!=0xF){
+        stats.partial_flushes++;
+        if(!e->flush) stats.timeouts++;
+    }
+    if(fused){
+        /* ru2mlsu has no byte enables: missing chunks go out as zeros */
+        ru2mlsu_PTR o = make_payload<ru2mlsu_PTR>();
+        to_bv(e->buf,o->data);
+        o->done = e->done;
+        o_ru2mlsu[line].write(o);
+    }else{
+        ru2tcm_be_PTR o = make_payload<ru2tcm_be_PTR>();
+        to_bv(e->buf,o->data);
+        o->address = e->addr16;
+        o->done    = e->done;
+        for(int k=0;k<4;++k)
+            o->byte_en.range(16*k+15,16*k) = (e->mask>>k&1) ? 0xFFFFu : 0u;
+        o_ru2tcm[line].write(o);
+        busy_until[bank]=stats.cycles+bcfg.busy_cycles;
+        bstats.writes[bank]++;
+    }
+    stats.lines_out++; lines++;
+    for(int k=0;k<4;++k) if(e->mask>>k&1) stats.bytes_out+=16;
+    e->valid=false;
+    return true;
+}
+
+/* ── transpose ─────────────────────────────────────────────────────────*/
+/* buffer collecting packet seq of the job (seq = element*4 + chunk), a
+   free one if no port has reached seq yet; nullptr when all are in use */
+ru_tbuf* ru_funccore::tbuf_open(uint64_t seq)
+{
+    const ru_addr_cfg& g=agen.cfg();
+    uint64_t groups=(g.rows+RU_NUM_PORTS-1)/RU_NUM_PORTS;
+    uint64_t total =groups*g.cols*4;
+    if(total==0) return nullptr;
+    seq%=total;   /* the next job repeats the layout */
+
+    ru_tbuf* free_buf=nullptr;
+    for(auto& t:tbuf){
+        if(t.valid && t.seq==seq) return &t;
+        if(!t.valid && !free_buf) free_buf=&t;
+    }
+    if(!free_buf) return nullptr;
+
+    ru_tbuf& t=*free_buf;
+    uint64_t row0=(seq/4/g.cols)*RU_NUM_PORTS;
+    uint64_t left=g.rows-row0;
+    t.valid=true; t.seq=seq; t.got=0; t.done=0; t.out=0;
+    t.need=left>=RU_NUM_PORTS ? 0xFFFF : (uint16_t)((1u<<left)-1);
+    t.last=(seq+1==total);
+    std::memset(t.bytes,0,sizeof(t.bytes));
+    return &t;
+}
+
+/* write the columns of the oldest complete block into the write-combining
+   buffer, 16 chunks (4 lines of data) per cycle at most; a column whose
+   line has no free way waits for the next cycle. Each row whose packet
+   closed an element puts done on one of the last columns; everything open
+   is flushed first, so those lines follow all data written before them. */
+void ru_funccore::tbuf_drain()
+{
+    ru_tbuf* t=nullptr;
+    for(auto& c:tbuf)
+        if(c.valid && c.got==c.need && (!t || c.seq<t->seq)) t=&c;
+    if(!t) return;
+
+    uint64_t elem=t->seq/4;
+    unsigned k   =t->seq%4;
+    unsigned q   =(unsigned)(elem/agen.cfg().cols)%4;   /* chunk within the C^T line */
+    unsigned dones=0;
+    for(int r=0;r<RU_NUM_PORTS;++r) dones+=t->done>>r&1;
+    while(t->out<RU_PKT_BYTES){
+        unsigned j=t->out;
+        uint16_t addr16=agen.at_t(elem,k,j);
+        ru_wcb_entry* e=wcb_open(line_of(addr16),addr16,q);
+        if(!e) return;
+
+        uint8_t* dst=e->buf.bytes+16*q;
+        for(int r=0;r<RU_NUM_PORTS;++r) dst[r]=t->bytes[r][j];
+        e->mask|=1u<<q;
+        e->last=stats.cycles;
+        t->out++;
+
+        if(j>=RU_PKT_BYTES-dones){
+            for(auto& l:wcb) for(auto& w:l) if(w.valid) w.flush=true;
+            e->done=true;
+        }
+        /* end of job: write out everything still open */
+        if(t->last && t->out==RU_PKT_BYTES)
+            for(auto& l:wcb) for(auto& w:l) if(w.valid) w.flush=true;
+    }
+    t->valid=false;
+    stats.tblocks++;
+}
 
 /* ── main behaviour ────────────────────────────────────────────────────*/
 void ru_funccore::main_thread()
 {
-    bool fused=false;
-    sc_bv<512> pack[NUM_LINES];   // 4×128b aggregator
-    uint8_t    fill[NUM_LINES]={0};
+    reset_state();   /* the reset restarts the thread here */
 
     wait();
     while(true)
     {
+        stats.cycles++;
+
         /* read SFR stream (non‑blocking) */
         if(i_reg_map.num_available()){
             auto sfr=i_reg_map.read();
@@ -55,47 +260,100 @@ void ru_funccore::main_thread()
             fused=((w>>20)&1);
         }
 
-        /* service all MMU ports (one pkt each) */
-        for(int p=0;p<NUM_PORTS;++p)
+        /* service the MMU ports the arbiter picks, within the per-cycle
+           packet budget; a port waits only when its line has no free
+           write-combining way */
+        uint32_t ready=0, taken=0, held=0;
+        for(int p=0;p<RU_NUM_PORTS;++p)
+            if(i_mmu2ru[p].num_available()) ready|=1u<<p;
+
+        int order[RU_NUM_PORTS];
+        int n=arb.order(ready,order);
+        unsigned pkts=0;
+        for(int i=0;i<n && pkts<arb.cfg().max_pkts;++i)
         {
-            if(!i_mmu2ru[p].num_available()) continue;
-            mu2ru_PTR in=i_mmu2ru[p].read();
-
-            uint32_t r=st[p].row;
-            uint32_t c=st[p].col;
-            uint16_t addr16=make_addr16(r,c);
-            unsigned line=line_of(addr16);
-
-            /* pack 16×8b → 128b at offset fill*128 */
-            for(int b=0;b<16;++b)
-                pack[line].range( fill[line]*128+8*b+7,
-                                  fill[line]*128+8*b   )
-                        = in->C_data[b];
-            bool four_chunks=(++fill[line]==4);
-
-            if(four_chunks){
-                /* emit one 512‑bit packet */
-                if(fused){
-                    ru2mlsu_PTR o(new ru2mlsu);
-                    o->data = pack[line];
-                    o->done = in->done;
-                    o_ru2mlsu[line].write(o);
-                }else{
-                    ru2tcm_PTR o(new ru2tcm);
-                    o->data    = pack[line];
-                    o->address = addr16;
-                    o->done    = in->done;
-                    o_ru2tcm[line].write(o);
-                }
-                fill[line]=0; pack[line]=0;
+            int p=order[i];
+
+            /* transposed: row p of the block for this packet */
+            if(agen.transposed()){
+                ru_tbuf* t=tbuf_open(st[p].seq);
+                if(!t){ held|=1u<<p; continue; }
+                mmu2ru_PTR in=i_mmu2ru[p].read();
+                taken|=1u<<p; pkts++;
+                stats.packets++;
+                get_lanes(t->bytes[p],*in,(fused && epi.enable) ? &epi : nullptr);
+                t->got|=1u<<p;
+                if(in->done==1) t->done|=1u<<p;
+                st[p].seq++;
+                continue;
             }
 
-            /* advance indices on last flag */
+            uint16_t addr16=agen.at(p,st[p].idx);
+            unsigned k=st[p].chunk;
+            ru_wcb_entry* e=wcb_open(line_of(addr16),addr16,k);
+            if(!e){ held|=1u<<p; continue; }
+
+            mmu2ru_PTR in=i_mmu2ru[p].read();
+            taken|=1u<<p; pkts++;
+            stats.packets++;
+
+            /* 16×8b → chunk k of the entry, requantized on the fused path */
+            put_chunk(e->buf,k,*in,(fused && epi.enable) ? &epi : nullptr);
+            e->mask|=1u<<k;
+            e->last=stats.cycles;
+            st[p].chunk=(k+1)&3;
+
+            /* last flag: close the entry, advance the element */
             if(in->done==1){
-                st[p].col++;
-                if(st[p].col==64){ st[p].col=0; st[p].row++; }
+                e->flush=true; e->done=true;
+                st[p].idx++; st[p].chunk=0;
             }
         }
+        arb.update(ready,taken,held);
+        if(agen.transposed()) tbuf_drain();
+
+        /* write out at most one entry per line, within the line budget */
+        unsigned lines=0;
+        bool     in_order_stop=false;   /* !reorder: a waiting line blocks the rest */
+        for(unsigned l=0;l<RU_NUM_LINES;++l) wcb_drain(l,lines,in_order_stop);
         wait();
     }
 }
+
+void ru_funccore::end_of_simulation()
+{
+    if(stats.packets==0) return;
+    std::cout<<"[RU "<<id<<"] cycles="<<stats.cycles<<" packets="<<stats.packets
+             <<" lines="<<stats.lines_out
+             <<" fill="<<(stats.lines_out?(int)(100.0*stats.bytes_out/(64*stats.lines_out)+0.5):0)<<"%"
+             <<" combined="<<stats.combined
+             <<" partial="<<stats.partial_flushes<<" (timeout "<<stats.timeouts
+             <<") evictions="<<stats.evictions;
+    if(stats.tblocks) std::cout<<" transposed blocks="<<stats.tblocks;
+    std::cout<<"\n";
+    for(int p=0;p<RU_NUM_PORTS;++p){
+        const ru_port_stats& ps=arb.stats(p);
+        if(ps.granted==0 && ps.stalled==0 && ps.backpressure==0) continue;
+        std::cout<<"[RU "<<id<<"]   port "<<p<<": granted="<<ps.granted
+                 <<" stalled="<<ps.stalled<<" backpressure="<<ps.backpressure<<"\n";
+    }
+
+    /* per-bank utilization: busy cycles / cycles, and how many banks fall
+       in each 10% bucket */
+    uint64_t writes=0, conflicts=0, hist[10]={0};
+    for(int b=0;b<RU_NUM_BANKS;++b){ writes+=bstats.writes[b]; conflicts+=bstats.conflicts[b]; }
+    if(writes==0) return;
+    std::cout<<"[RU "<<id<<"] tcm writes="<<writes<<" bank conflicts="<<conflicts
+             <<" (busy_cycles="<<bcfg.busy_cycles<<(bcfg.reorder?", reorder":", in order")<<")\n";
+    for(int b=0;b<RU_NUM_BANKS;++b){
+        double util=(double)bstats.writes[b]*bcfg.busy_cycles/stats.cycles;
+        if(util>1) util=1;
+        hist[util<1?(int)(util*10):9]++;
+        if(bstats.writes[b]==0 && bstats.conflicts[b]==0) continue;
+        std::cout<<"[RU "<<id<<"]   bank "<<b<<": writes="<<bstats.writes[b]
+                 <<" util="<<(int)(util*100+0.5)<<"% conflicts="<<bstats.conflicts[b]<<"\n";
+    }
+    std::cout<<"[RU "<<id<<"] bank util histogram:";
+    for(int i=0;i<10;++i) std::cout<<" "<<i*10<<"-"<<i*10+10<<"%="<<hist[i];
+    std::cout<<"\n";
+}
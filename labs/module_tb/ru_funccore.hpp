@@ -1,8 +1,90 @@
 #pragma once
 #include "npucommon.hpp"
 #include "npudefine.hpp"
+#include "mmu2ru.hpp"
+#include "ru2tcm_be.hpp"
+#include "ru2mlsu.hpp"
+#include "payload_pool.hpp"
+#include "ru_addrgen.hpp"
+#include "ru_arbiter.hpp"
+#include "ru_epilogue.hpp"
+
+constexpr int RU_NUM_LINES = 4;    // 512b output lines (ru2tcm/ru2mlsu ports)
+constexpr int RU_WCB_WAYS  = 4;    // write-combining entries per output line
+
+/* 512b output line as plain bytes, byte i = bits 8i+7..8i; one cache line */
+struct alignas(64) ru_line_buf { uint8_t bytes[64]; };
+
+/* Write-combining entry: one TCM line being gathered. A port's k-th packet
+   for an address is chunk k%4 (bytes 16k..16k+15); chunks for the same
+   address merge into one entry. It is written out when all four chunks are
+   in, or partial with byte enables on done, on eviction, or after
+   flush_timeout idle cycles.
+   Done: each element the MMU closes (mmu2ru done) puts done=1 on exactly
+   one output line, and that line leaves only after the lines holding the
+   rest of the element's data, so the last done of a job follows all of
+   its data. */
+struct ru_wcb_entry {
+    bool        valid{false};
+    bool        flush{false};    // write out even if partial
+    bool        done{false};     // written out with done=1
+    uint8_t     mask{0};         // chunks written, bit k = chunk k
+    uint16_t    addr16{0};
+    uint64_t    first{0};        // cycle allocated, oldest drains first
+    uint64_t    last{0};         // cycle of the last chunk
+    ru_line_buf buf;
+};
+
+constexpr int RU_TBUFS = 4;        // transpose buffers in flight
+
+/* Transpose buffer (RU_LAYOUT_TRANSPOSED): chunk k of one element from
+   every port, port p = row p of a 16x16 byte block. Once the ports with
+   rows in range have all delivered, its 16 columns go to the
+   write-combining buffer as 16-byte chunks of C^T lines.
+   Throughput limit: a C^T line takes chunk g%4 from row groups 4m..4m+3,
+   which arrive 4*cols blocks apart, and a block needs 16 ways while the
+   buffer has RU_WCB_WAYS per line. The ways are reclaimed long before the
+   other row groups come, so transposed lines go out about 1/4 full: four
+   TCM writes per 64 bytes, 1/4 of the row layout's write bandwidth at the
+   same packet rate. Gathering 64 rows would take 4*cols buffers of 1 KB;
+   that is not modelled. ru_stats::bytes_out measures the fill. */
+struct ru_tbuf {
+    bool     valid{false};
+    bool     last{false};       // last block of the job
+    uint16_t need{0}, got{0};   // ports expected / delivered
+    uint16_t done{0};           // ports whose packet closed an element
+    uint8_t  out{0};            // next column to write out
+    uint64_t seq{0};            // element*4 + chunk within the job
+    uint8_t  bytes[RU_NUM_PORTS][RU_PKT_BYTES];
+};
+
+struct ru_stats {
+    uint64_t cycles          = 0;
+    uint64_t packets         = 0;   // mmu2ru packets taken
+    uint64_t lines_out       = 0;   // ru2tcm + ru2mlsu packets sent
+    uint64_t bytes_out       = 0;   //   enabled bytes in them, fill = bytes_out/(64*lines_out)
+    uint64_t combined        = 0;   // chunks merged into an open entry
+    uint64_t partial_flushes = 0;   // lines sent with fewer than 4 chunks
+    uint64_t timeouts        = 0;   //   of those, flushed by the timeout
+    uint64_t evictions       = 0;   // entries flushed early to free a way
+    uint64_t tblocks         = 0;   // 16x16 blocks transposed
+};
+
+/* TCM write side: a bank takes one 512b write, then stays busy for
+   busy_cycles cycles; a line for a busy bank waits in the aggregator */
+struct ru_bank_cfg {
+    unsigned busy_cycles{1};   // 1 => a write every cycle, no conflicts
+    bool     reorder{true};    // entries on free banks pass one waiting on a busy bank
+};
+
+struct ru_bank_stats {
+    uint64_t writes[RU_NUM_BANKS]{};
+    uint64_t conflicts[RU_NUM_BANKS]{};   // line-cycles spent waiting for the bank
+};
 
 // RTL‐only: main_thread is the DUT’s process.
+// All state is per instance and cleared on reset, so any number of RUs
+// can run side by side.
 class ru_funccore : public sc_core::sc_module {
 public:
     SC_HAS_PROCESS(ru_funccore);
@@ -12,13 +94,53 @@ public:
     sc_fifo_in<npuc2mmu_PTR>  i_npuc2mmu;
     sc_fifo_in<mmu2npuc_PTR>  i_mmu2npuc;
     sc_vector< sc_fifo_in<mmu2ru_PTR> >  i_mmu2ru;
-    sc_vector< sc_fifo_out<ru2tcm_PTR> > o_ru2tcm;
+    sc_vector< sc_fifo_out<ru2tcm_be_PTR> > o_ru2tcm;
     sc_vector< sc_fifo_out<ru2mlsu_PTR> >o_ru2mlsu;
     sc_fifo_in<sfr_PTR> i_reg_map;
 
     void set_Id(int);
+    /* TCM layout of the next job: tables built here, ports restart at
+       element 0; legacy make_addr16 mapping until called */
+    void set_addr_cfg(const ru_addr_cfg& c);
+    /* input arbitration and per-cycle budgets; fixed order, no limit by default */
+    void set_arb_cfg(const ru_arb_cfg& c);
+    /* TCM bank occupancy model */
+    void set_bank_cfg(const ru_bank_cfg& c){ bcfg=c; if(!bcfg.busy_cycles) bcfg.busy_cycles=1; }
+    /* requantize/ReLU on the fused path; off by default */
+    void set_epi_cfg(const ru_epi_cfg& c){ epi=c; }
+    /* idle cycles before a partial line is flushed, 0 => only on done/eviction */
+    void set_flush_timeout(unsigned cycles){ flush_timeout=cycles; }
+    const ru_stats& get_stats() const { return stats; }
+    const ru_bank_stats& get_bank_stats() const { return bstats; }
+    const ru_port_stats& get_port_stats(int p) const { return arb.stats(p); }
 
 private:
     void main_thread();
+    void reset_state();
+    void end_of_simulation();
+    ru_wcb_entry* wcb_open(unsigned line,uint16_t addr16,unsigned k);
+    bool          wcb_drain(unsigned line,unsigned& lines,bool& in_order_stop);
+    bool          wcb_ready(const ru_wcb_entry& e) const;
+    bool          done_waits(const ru_wcb_entry& d) const;
+    ru_tbuf*      tbuf_open(uint64_t seq);
+    void          tbuf_drain();
     int id{0};
+
+    /* per‑port output position (element index), advanced on each done,
+       and the next chunk of the element; transposed jobs place packets by
+       count (seq) instead */
+    struct port_state { uint64_t idx=0; uint64_t seq=0; uint8_t chunk=0; };
+
+    bool        fused{false};
+    port_state  st[RU_NUM_PORTS];
+    ru_wcb_entry wcb[RU_NUM_LINES][RU_WCB_WAYS];
+    ru_tbuf     tbuf[RU_TBUFS];
+    unsigned    flush_timeout{64};
+    ru_stats    stats;
+    ru_addrgen  agen;
+    ru_arbiter  arb;
+    ru_epi_cfg    epi;
+    ru_bank_cfg   bcfg;
+    ru_bank_stats bstats;
+    uint64_t      busy_until[RU_NUM_BANKS]{};   // first cycle the bank is free
 };
@@ -1,21 +1,100 @@
 #include "tb_ru_funccore.hpp"
 #include "tb_config.hpp"
-#include <cassert>
+#include <chrono>
+#include <cmath>
 
-/* build 16-bit bank+offset address */
+/* byte b of chunk k of the line at addr: address, chunk tag, then filler */
+static inline uint8_t pat(uint16_t addr,unsigned k,int b){
+    switch(b){
+        case 0:  return addr&0xFF;
+        case 1:  return addr>>8;
+        case 2:  return 0x80|k;     /* never 0: zero-padded MLSU chunks are absent */
+        default: return (uint8_t)(addr*0x9Du + k*0x35u + b*0x1Du);
+    }
+}
+
+/* order-independent hash of one (addr,k) chunk, summed per direction */
+static inline uint64_t mix(uint16_t addr,unsigned k){
+    uint64_t x=((uint64_t)addr<<2|k)+0x9E3779B97F4A7C15ull;
+    x=(x^(x>>30))*0xBF58476D1CE4E5B9ull;
+    x=(x^(x>>27))*0x94D049BB133111EBull;
+    return x^(x>>31);
+}
+
+/* hash of one requantized MLSU chunk, its bytes and position k */
+static inline uint64_t mix_bytes(const uint8_t* ch,unsigned k){
+    uint64_t h=1469598103934665603ull^k;
+    for(int b=0;b<16;b++) h=(h^ch[b])*1099511628211ull;
+    return mix((uint16_t)h,k)^h;
+}
+
+/* reference requantizer, lane b: round half up as floor(x/2^shift + 1/2)
+   in long double (exact for the int64 products here), ReLU, int8 clamp */
+static inline int epi_ref(const ru_epi_cfg& c,int b,uint8_t x,bool* half=nullptr){
+    int64_t     p=((int64_t)(int8_t)x+c.bias[b])*c.scale;
+    long double q=(long double)p/std::ldexp(1.0L,c.shift&31);
+    if(half) *half=(q-std::floor(q)==0.5L);
+    long double y=std::floor(q+0.5L);
+    if(c.relu && y<0) y=0;
+    return y>127 ? 127 : y<-128 ? -128 : (int)y;
+}
+
+/* every lane and input of c through ru_epilogue vs epi_ref; the sweep must
+   hit both saturation limits (only the top one under ReLU) and exact
+   halves, or it proves nothing */
+static uint64_t sweep_epilogue(const char* name,const ru_epi_cfg& c){
+    uint64_t errors=0, sat_hi=0, sat_lo=0, halves=0;
+    for(int x=0;x<256;x+=RU_PKT_BYTES) for(int s=0;s<RU_PKT_BYTES;s++){
+        uint8_t lane[RU_PKT_BYTES];
+        for(int b=0;b<RU_PKT_BYTES;b++) lane[b]=(uint8_t)(x+(b+s)%RU_PKT_BYTES);
+        uint8_t in[RU_PKT_BYTES];
+        for(int b=0;b<RU_PKT_BYTES;b++) in[b]=lane[b];
+        ru_epilogue(c,lane);
+        for(int b=0;b<RU_PKT_BYTES;b++){
+            bool half;
+            int  want=epi_ref(c,b,in[b],&half);
+            int64_t raw=((int64_t)(int8_t)in[b]+c.bias[b])*c.scale;
+            sat_hi+=(want==127 && raw>0);
+            sat_lo+=(want==(c.relu?0:-128) && raw<0);
+            halves+=half;
+            if((int8_t)lane[b]!=want && errors++<8)
+                std::cerr<<"[TB-RU] "<<name<<": lane "<<b<<" in="<<(int)(int8_t)in[b]
+                         <<" got="<<(int)(int8_t)lane[b]<<" want="<<want<<"\n";
+        }
+    }
+    if(!sat_hi || !sat_lo || !halves){
+        std::cerr<<"[TB-RU] "<<name<<": sweep misses a case (sat_hi="<<sat_hi
+                 <<" sat_lo="<<sat_lo<<" halves="<<halves<<")\n";
+        errors++;
+    }
+    std::cout<<"[TB-RU] "<<name<<" sweep: errors="<<errors<<" sat_hi="<<sat_hi
+             <<" sat_lo="<<sat_lo<<" halves="<<halves<<"\n";
+    return errors;
+}
+
+/* TCM address of element (r,c), as the DUT's ru_addrgen computes it for
+   the (r>>4)*N+c-th element on port r&0xF */
 uint16_t tb_ru_funccore::addr16(uint32_t r,uint32_t c){
-    uint16_t bank=((r&0xF)<<1)|(c>>1);
-    uint16_t off =(r>>4)*64+((c&1)?32:0);
-    return (bank<<11)|off;
+    if(!agen_.cfg().legacy) return agen_.map(r,c);
+    uint64_t k=(uint64_t)(r>>4)*agen_.cfg().cols+c;
+    return make_addr16((uint32_t)(k/64),(uint32_t)(k%64));
 }
 
-/* make one mmu2ru packet */
-mmu2ru_PTR tb_ru_funccore::make_pkt(bool last){
-    auto p = std::make_shared<mmu2ru>();
-    for(int i=0;i<16;i++) p->C_data[i]=i;
+/* make one mmu2ru packet: chunk k of the line at addr */
+mmu2ru_PTR tb_ru_funccore::make_pkt(uint16_t addr,unsigned k,bool last){
+    auto p = make_payload<mmu2ru_PTR>();
+    for(int i=0;i<16;i++) p->C_data[i]=pat(addr,k,i);
     p->done=last; return p;
 }
 
+/* transposed: lane j of chunk k of the idx-th element on port p is byte p
+   of chunk q of the C^T line at at_t(idx,k,j) */
+mmu2ru_PTR tb_ru_funccore::make_tpkt(uint64_t idx,unsigned k,unsigned q,unsigned p,bool last){
+    auto t = make_payload<mmu2ru_PTR>();
+    for(unsigned j=0;j<16;j++) t->C_data[j]=pat(agen_.at_t(idx,k,j),q,p);
+    t->done=last; return t;
+}
+
 tb_ru_funccore::tb_ru_funccore(sc_core::sc_module_name n)
 : sc_core::sc_module(n)
 , clk("clk"), reset("reset")
@@ -24,57 +103,236 @@ tb_ru_funccore::tb_ru_funccore(sc_core::sc_module_name n)
 , i_ru2mlsu("i_ru2mlsu",4), o_reg_map("o_reg_map")
 {
     SC_THREAD(handler);     sensitive << clk.pos();
-    SC_THREAD(resp_tcm);    for(int i=0;i<4;i++) sensitive<<i_ru2tcm[i].data_written_event();
-    SC_THREAD(resp_mlsu);   for(int i=0;i<4;i++) sensitive<<i_ru2mlsu[i].data_written_event();
+    SC_THREAD(resp_tcm);    /* wait on the OR of the FIFOs' written events */
+    SC_THREAD(resp_mlsu);
 }
 
 void tb_ru_funccore::handler(){
-    /* load sizes from JSON */
-    auto cfg = tb_config::instance().load("cfg_ru.json");
-    uint32_t M = cfg.size_m*8, N = cfg.size_n*32;
+    /* load sizes from the register map (tb_config) */
+    common_register_map regs;
+    tb_config::instance().get_cfg_registers(regs);
+    uint32_t M = regs.option_tensor_size_size_m*8, N = regs.option_tensor_size_size_n*32;
+    if(agen_.cfg().legacy){ ru_addr_cfg c; c.cols=N; set_addr_cfg(c); }
 
     /* phase‐1: non‐fused */
-    o_reg_map.write(std::make_shared<uint32_t>(0u));
-    run_testcase(M,N);
-
-    wait(500, SC_NS);
+    sfr_PTR sfr = make_payload<sfr_PTR>();
+    *sfr = 0u;
+    o_reg_map.write(sfr);
+    run_testcase("tcm",M,N);
 
     /* phase‐2: fused */
-    o_reg_map.write(std::make_shared<uint32_t>(1u<<20));
-    run_testcase(M,N);
+    sfr = make_payload<sfr_PTR>();
+    *sfr = 1u<<20;
+    o_reg_map.write(sfr);
+    run_testcase("mlsu",M,N);
+
+    /* phase-3: fused with the epilogue; bias spans -296..259 so both
+       limits saturate, 83/128 makes exact halves, lane 15 stays > 0 */
+    if(epi_hook_){
+        ru_epi_cfg e;
+        e.enable=true; e.scale=83; e.shift=7;
+        for(int b=0;b<RU_PKT_BYTES;b++) e.bias[b]=(b-8)*37;
+        run_epilogue("epilogue",e,M,N);
+        e.relu=true;
+        run_epilogue("epilogue+relu",e,M,N);
+        epi_hook_(ru_epi_cfg{});
+    }else
+        std::cout<<"[TB-RU] no epilogue hook: epilogue skipped\n";
 
+    /* phase-4: blocked and transposed layouts, non-fused */
+    if(layout_hook_){
+        sfr = make_payload<sfr_PTR>();
+        *sfr = 0u;
+        o_reg_map.write(sfr);
+
+        ru_addr_cfg b;
+        b.legacy=false; b.layout=RU_LAYOUT_BLOCKED;
+        b.rows=32; b.cols=16; b.tile_rows=16; b.tile_cols=4;
+        run_layout("blocked",b);
+
+        /* C^T is 64*cols rows of rows/64 elements */
+        ru_addr_cfg t;
+        t.legacy=false; t.layout=RU_LAYOUT_TRANSPOSED;
+        t.rows=64; t.cols=8; t.row_stride=64; t.col_stride=64;
+        run_layout("transposed",t);
+    }else
+        std::cout<<"[TB-RU] no layout hook: blocked/transposed skipped\n";
+
+    std::cout<<"[TB-RU] "<<(sb_.errors?"FAIL":"PASS")<<" errors="<<sb_.errors<<"\n";
+    payload_pool_base::report(std::cout);
     sc_core::sc_stop();
 }
 
-void tb_ru_funccore::run_testcase(uint32_t M,uint32_t N){
-    for(uint32_t r=0;r<M;r++)for(uint32_t c=0;c<N;c++){
-        bool last=(r==M-1&&c==N-1);
-        o_mmu2ru[r&0xF].write(make_pkt(last));
-        gold_tcm_.push(addr16(r,c));
-        gold_mlsu_++;
+/* the layout goes to both sides while the RU is idle */
+void tb_ru_funccore::run_layout(const char* name,const ru_addr_cfg& c){
+    set_addr_cfg(c);
+    layout_hook_(c);
+    run_testcase(name,c.rows,c.cols);
+}
+
+/* the epilogue goes to both sides while the RU is idle; the SFR still
+   selects the fused path */
+void tb_ru_funccore::run_epilogue(const char* name,const ru_epi_cfg& c,uint32_t M,uint32_t N){
+    sb_.errors+=sweep_epilogue(name,c);
+    epi_=c;
+    epi_hook_(c);
+    run_testcase(name,M,N);
+    epi_=ru_epi_cfg{};
+}
+
+/* stream the tile one packet per port in turn (so all 16 FIFOs fill),
+   then wait for the RU to write every chunk back; transposed tiles need
+   M a multiple of 16 */
+void tb_ru_funccore::run_testcase(const char* name,uint32_t M,uint32_t N){
+    const uint64_t tx0=sb_.tx_chunks, rx0=sb_.rx_chunks, act0=sb_.activations;
+    const sc_time  t0=sc_time_stamp();
+    const auto     h0=std::chrono::steady_clock::now();
+    const bool     tr=agen_.transposed();
+
+    sb_.exp_chunks=sb_.tx_chunks+(uint64_t)M*N*4;
+    sb_.exp_elems =sb_.tx_elems +(uint64_t)M*N;
+    for(uint32_t g=0;g*16<M;g++) for(uint32_t c=0;c<N;c++){
+        for(unsigned k=0;k<4;k++){
+            for(uint32_t p=0;p<16;p++){
+                uint32_t r=g*16+p;
+                if(r>=M) break;
+                if(tr){
+                    o_mmu2ru[p].write(make_tpkt((uint64_t)g*N+c,k,g%4,p,k==3));
+                }else{
+                    uint16_t a=addr16(r,c);
+                    o_mmu2ru[p].write(make_pkt(a,k,k==3));
+                    sb_.tx_chunks++;
+                    if(epi_.enable){
+                        uint8_t ch[16];
+                        for(int b=0;b<16;b++) ch[b]=(uint8_t)epi_ref(epi_,b,pat(a,k,b));
+                        sb_.tx_sum+=mix_bytes(ch,k);
+                    }else
+                        sb_.tx_sum+=mix(a,k);
+                }
+                if(k==3) sb_.tx_elems++;
+            }
+            /* the block's 16 columns are chunk g%4 of 16 C^T lines */
+            if(tr) for(unsigned j=0;j<16;j++){
+                sb_.tx_chunks++; sb_.tx_sum+=mix(agen_.at_t((uint64_t)g*N+c,k,j),g%4);
+            }
+        }
+    }
+
+    /* drain: give up after 10000 cycles without progress */
+    uint64_t last=sb_.rx_chunks; unsigned idle=0;
+    while((sb_.rx_chunks<sb_.tx_chunks || sb_.rx_done<sb_.tx_elems) && idle<10000){
+        wait();
+        if(sb_.rx_chunks==last) idle++; else { idle=0; last=sb_.rx_chunks; }
+    }
+
+    if(sb_.rx_chunks!=sb_.tx_chunks || sb_.rx_sum!=sb_.tx_sum){
+        std::cerr<<"[TB-RU] "<<name<<": chunks sent="<<sb_.tx_chunks<<" received="
+                 <<sb_.rx_chunks<<(sb_.rx_sum!=sb_.tx_sum?" (content mismatch)":"")<<"\n";
+        sb_.errors++;
+    }
+    if(sb_.rx_done!=sb_.tx_elems){
+        std::cerr<<"[TB-RU] "<<name<<": done flags="<<sb_.rx_done<<" expected="<<sb_.tx_elems<<"\n";
+        sb_.errors++;
+    }
+
+    double   sim =(sc_time_stamp()-t0).to_seconds();
+    double   host=std::chrono::duration<double>(std::chrono::steady_clock::now()-h0).count();
+    uint64_t pk  =sb_.tx_chunks-tx0;
+    uint64_t act =sb_.activations-act0;
+    uint64_t ch  =sb_.rx_chunks-rx0;
+    std::cout<<"[TB-RU] "<<name<<" "<<M<<"x"<<N<<": packets="<<pk<<" lines="<<sb_.rx_lines
+             <<" fill="<<(sb_.rx_lines?(int)(100.0*ch/(4*sb_.rx_lines)+0.5):0)<<"%"
+             <<" pkts/sim_s="<<(sim>0?pk/sim:0)<<" pkts/wall_s="<<(host>0?pk/host:0)
+             <<" wall="<<host<<"s activations/line="
+             <<(sb_.rx_lines?(double)act/sb_.rx_lines:0)<<"\n";
+    sb_.rx_lines=0;
+}
+
+/* one received 512b line: every present chunk must be pat(addr,k,·) */
+void tb_ru_funccore::check_line(const sc_bv<512>& data,const sc_bv<64>* byte_en,int address){
+    uint8_t bytes[64];
+    for(int w=0;w<16;w++){
+        uint32_t v=data.range(32*w+31,32*w).to_uint();
+        for(int b=0;b<4;b++) bytes[4*w+b]=(uint8_t)(v>>(8*b));
+    }
+    sb_.rx_lines++;
+
+    for(unsigned k=0;k<4;k++){
+        const uint8_t* ch=bytes+16*k;
+        bool present;
+        if(byte_en){
+            uint32_t en=byte_en->range(16*k+15,16*k).to_uint();
+            if(en!=0 && en!=0xFFFF){ sb_.errors++; continue; }   /* chunks are all or nothing */
+            present=(en!=0);
+        }else
+            present=(ch[2]!=0);
+        if(!present) continue;
+
+        uint16_t a=(address>=0) ? (uint16_t)address : (uint16_t)(ch[0]|ch[1]<<8);
+        bool ok=true;
+        for(int b=0;b<16;b++) ok&=(ch[b]==pat(a,k,b));
+        if(!ok && sb_.errors++<8)
+            std::cerr<<"[TB-RU] bad chunk "<<k<<" @0x"<<std::hex<<a<<std::dec
+                     <<" t="<<sc_time_stamp()<<"\n";
+        sb_.rx_chunks++; sb_.rx_sum+=mix(a,k);
+    }
+}
+
+/* one requantized MLSU line: every chunk that is not all zero counts */
+void tb_ru_funccore::check_epi_line(const sc_bv<512>& data){
+    uint8_t bytes[64];
+    for(int w=0;w<16;w++){
+        uint32_t v=data.range(32*w+31,32*w).to_uint();
+        for(int b=0;b<4;b++) bytes[4*w+b]=(uint8_t)(v>>(8*b));
+    }
+    sb_.rx_lines++;
+    for(unsigned k=0;k<4;k++){
+        const uint8_t* ch=bytes+16*k;
+        bool present=false;
+        for(int b=0;b<16;b++) present|=(ch[b]!=0);
+        if(!present) continue;
+        sb_.rx_chunks++; sb_.rx_sum+=mix_bytes(ch,k);
+    }
+}
+
+/* a done line: the one that completes the job must follow all its data */
+void tb_ru_funccore::check_done(){
+    if(++sb_.rx_done==sb_.exp_elems && sb_.rx_chunks!=sb_.exp_chunks){
+        std::cerr<<"[TB-RU] last done with "<<sb_.exp_chunks-sb_.rx_chunks
+                 <<" chunks still out t="<<sc_time_stamp()<<"\n";
+        sb_.errors++;
     }
 }
 
+/* The responders sleep until one of their four FIFOs is written, then
+   drain every line that has data; one activation per burst of writes. */
 void tb_ru_funccore::resp_tcm(){
+    sc_event_or_list any;
+    for(int l=0;l<4;l++) any|=i_ru2tcm[l].data_written_event();
     while(true){
-        for(int l=0;l<4;l++){
-            if(!i_ru2tcm[l].num_available()) continue;
-            auto p = i_ru2tcm[l].read();
-            assert(!gold_tcm_.empty());
-            auto exp = gold_tcm_.front(); gold_tcm_.pop();
-            assert(p->address.to_uint()==exp);
-        }
-        wait(SC_ZERO_TIME);
+        sb_.activations++;
+        for(int l=0;l<4;l++)
+            while(i_ru2tcm[l].num_available()){
+                auto p = i_ru2tcm[l].read();
+                check_line(p->data,&p->byte_en,(int)p->address.to_uint());
+                if(p->done==1) check_done();
+            }
+        wait(any);
     }
 }
 
 void tb_ru_funccore::resp_mlsu(){
+    sc_event_or_list any;
+    for(int l=0;l<4;l++) any|=i_ru2mlsu[l].data_written_event();
     while(true){
-        for(int l=0;l<4;l++){
-            if(!i_ru2mlsu[l].num_available()) continue;
-            i_ru2mlsu[l].read();
-            assert(gold_mlsu_>0); --gold_mlsu_;
-        }
-        wait(SC_ZERO_TIME);
+        sb_.activations++;
+        for(int l=0;l<4;l++)
+            while(i_ru2mlsu[l].num_available()){
+                auto p = i_ru2mlsu[l].read();
+                if(epi_.enable) check_epi_line(p->data);
+                else            check_line(p->data,nullptr,-1);
+                if(p->done==1) check_done();
+            }
+        wait(any);
     }
 }
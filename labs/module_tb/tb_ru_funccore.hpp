@@ -1,12 +1,15 @@
 #pragma once
 #include "systemc.h"
+#include <functional>
 #include <memory>
-#include <queue>
 #include "npudefine.hpp"
 #include "mmu2ru.hpp"
-#include "ru2tcm.hpp"
+#include "ru2tcm_be.hpp"
 #include "ru2mlsu.hpp"
 #include "tb_config.hpp"
+#include "payload_pool.hpp"
+#include "ru_addrgen.hpp"
+#include "ru_epilogue.hpp"
 
 using npuc2mmu_PTR = std::shared_ptr<npuc2mmu>;
 using mmu2npuc_PTR = std::shared_ptr<mmu2npuc>;
@@ -15,6 +18,31 @@ using ru2tcm_PTR   = std::shared_ptr<ru2tcm>;
 using ru2mlsu_PTR  = std::shared_ptr<ru2mlsu>;
 using sfr_PTR      = std::shared_ptr<uint32_t>;
 
+/* Streaming scoreboard: element (r,c) is 4 packets on port r&0xF, done on
+ * the 4th, and chunk k of it carries pat(addr,k,·) where addr is the TCM
+ * address the RU must write it to. Each received line is checked chunk by
+ * chunk against the pattern of its own address (TCM: p->address; MLSU: the
+ * address bytes in the chunk), and the multiset of (addr,k) chunks sent and
+ * received is compared by count and sum of hashes. Nothing is queued, so
+ * memory stays O(1) for any M x N.
+ * Transposed jobs use the same check: lane j of the packet from port p is
+ * byte p of chunk q=(r/16)%4 of the C^T line it lands in, so it carries
+ * pat(at_t(...),q,p) and each received chunk again matches its address.
+ * Every element gives one done; the done that completes a job must come
+ * after all of its chunks.
+ * With the fused epilogue on, MLSU chunks no longer carry their address:
+ * the tb requantizes each sent chunk with its own reference and compares
+ * the multisets of (k, 16 bytes) instead; lane 15 is biased so that a
+ * present chunk is never all zero. */
+struct tb_ru_score {
+    uint64_t tx_chunks{0}, rx_chunks{0};
+    uint64_t tx_sum{0},    rx_sum{0};
+    uint64_t tx_elems{0},  rx_done{0};
+    uint64_t exp_chunks{0},exp_elems{0};   // totals at the end of the running job
+    uint64_t rx_lines{0},  errors{0};
+    uint64_t activations{0};   // responder wake-ups, vs rx_lines useful ones
+};
+
 class tb_ru_funccore : public sc_core::sc_module {
 public:
     SC_HAS_PROCESS(tb_ru_funccore);
@@ -24,19 +52,37 @@ public:
     sc_fifo_out<npuc2mmu_PTR> o_npuc2mmu;
     sc_fifo_out<mmu2npuc_PTR> o_mmu2npuc;
     sc_vector< sc_fifo_out<mmu2ru_PTR> > o_mmu2ru;
-    sc_vector< sc_fifo_in <ru2tcm_PTR> > i_ru2tcm;
+    sc_vector< sc_fifo_in <ru2tcm_be_PTR> > i_ru2tcm;
     sc_vector< sc_fifo_in <ru2mlsu_PTR> >i_ru2mlsu;
     sc_fifo_out<sfr_PTR>      o_reg_map;
 
+    /* must match the DUT's set_addr_cfg(); legacy mapping by default */
+    void set_addr_cfg(const ru_addr_cfg& c){ agen_.configure(c,false); }
+    /* called with each layout the blocked/transposed cases run, so the top
+       can pass it to the DUT; those cases are skipped without it */
+    void set_layout_hook(std::function<void(const ru_addr_cfg&)> f){ layout_hook_=f; }
+    /* likewise for the fused epilogue case */
+    void set_epi_hook(std::function<void(const ru_epi_cfg&)> f){ epi_hook_=f; }
+    const tb_ru_score& score() const { return sb_; }
+
 private:
     void handler();
     void resp_tcm();
     void resp_mlsu();
 
-    void run_testcase(uint32_t M, uint32_t N);
-    mmu2ru_PTR make_pkt(bool last);
+    void run_testcase(const char* name,uint32_t M, uint32_t N);
+    void run_layout(const char* name,const ru_addr_cfg& c);
+    void run_epilogue(const char* name,const ru_epi_cfg& c,uint32_t M,uint32_t N);
+    mmu2ru_PTR make_pkt(uint16_t addr,unsigned k,bool last);
+    mmu2ru_PTR make_tpkt(uint64_t idx,unsigned k,unsigned q,unsigned p,bool last);
     uint16_t   addr16(uint32_t r,uint32_t c);
+    void       check_line(const sc_bv<512>& data,const sc_bv<64>* byte_en,int address);
+    void       check_done();
+    void       check_epi_line(const sc_bv<512>& data);
 
-    std::queue<uint16_t> gold_tcm_;
-    size_t               gold_mlsu_{0};
+    ru_addrgen  agen_;
+    tb_ru_score sb_;
+    std::function<void(const ru_addr_cfg&)> layout_hook_;
+    std::function<void(const ru_epi_cfg&)>  epi_hook_;
+    ru_epi_cfg  epi_;   // epilogue the DUT runs, enable=0 outside the epilogue case
 };